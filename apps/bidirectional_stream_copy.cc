@@ -10,7 +10,6 @@
 using namespace std;
 
 void bidirectional_stream_copy(Socket &socket) {
-    constexpr size_t max_copy_length = 65536;
     constexpr size_t buffer_size = 1048576;
 
     EventLoop _eventloop{};
@@ -30,7 +29,8 @@ void bidirectional_stream_copy(Socket &socket) {
         _input,
         Direction::In,
         [&] {
-            _outbound.write(_input.read(_outbound.remaining_capacity()));
+            const auto [buf, len] = _outbound.writable_span();
+            _outbound.commit(_input.read(buf, len));
             if (_input.eof()) {
                 _outbound.end_input();
             }
@@ -42,8 +42,7 @@ void bidirectional_stream_copy(Socket &socket) {
     _eventloop.add_rule(socket,
                         Direction::Out,
                         [&] {
-                            const size_t bytes_to_write = min(max_copy_length, _outbound.buffer_size());
-                            const size_t bytes_written = socket.write(_outbound.peek_output(bytes_to_write), false);
+                            const size_t bytes_written = socket.write(_outbound.readable_spans(), false);
                             _outbound.pop_output(bytes_written);
                             if (_outbound.eof()) {
                                 socket.shutdown(SHUT_WR);
@@ -58,7 +57,8 @@ void bidirectional_stream_copy(Socket &socket) {
         socket,
         Direction::In,
         [&] {
-            _inbound.write(socket.read(_inbound.remaining_capacity()));
+            const auto [buf, len] = _inbound.writable_span();
+            _inbound.commit(socket.read(buf, len));
             if (socket.eof()) {
                 _inbound.end_input();
             }
@@ -70,8 +70,7 @@ void bidirectional_stream_copy(Socket &socket) {
     _eventloop.add_rule(_output,
                         Direction::Out,
                         [&] {
-                            const size_t bytes_to_write = min(max_copy_length, _inbound.buffer_size());
-                            const size_t bytes_written = _output.write(_inbound.peek_output(bytes_to_write), false);
+                            const size_t bytes_written = _output.write(_inbound.readable_spans(), false);
                             _inbound.pop_output(bytes_written);
 
                             if (_inbound.eof()) {
@@ -0,0 +1,115 @@
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t total_bytes = 256 * 1024 * 1024;  // bytes summed per measurement
+
+//! Receives each measurement's result so the measured work cannot be optimized away
+static volatile uint64_t result_sink = 0;
+
+//! The byte-at-a-time loop that InternetChecksum::add used before it had kernels
+class ByteAtATimeChecksum {
+    uint32_t _sum = 0;
+    bool _parity = false;
+
+  public:
+    void add(const string_view data) {
+        for (size_t i = 0; i < data.size(); i++) {
+            uint16_t val = uint8_t(data[i]);
+            if (not _parity) {
+                val <<= 8;
+            }
+            _sum += val;
+            _parity = !_parity;
+        }
+    }
+
+    uint16_t value() const {
+        uint32_t ret = _sum;
+        while (ret > 0xffff) {
+            ret = (ret >> 16) + (ret & 0xffff);
+        }
+        return ~ret;
+    }
+};
+
+//! \returns Gbit/s achieved by calling `one_pass` over a buffer of `size` bytes until `total_bytes` are covered
+template <typename T>
+double measure(const size_t size, T &&one_pass) {
+    const size_t iterations = max(size_t(1), total_bytes / size);
+    uint64_t sink = 0;
+    const auto start = steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += one_pass();
+    }
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    result_sink = sink;
+    return iterations * size * 8.0 / double(duration);
+}
+
+int main() {
+    try {
+        const vector<pair<InternetChecksum::Kernel, string>> kernels = {{InternetChecksum::Kernel::Scalar, "scalar"},
+                                                                        {InternetChecksum::Kernel::SSE2, "sse2"},
+                                                                        {InternetChecksum::Kernel::AVX2, "avx2"}};
+
+        auto rd = get_random_generator();
+        string src(65536, 0);
+        for (auto &ch : src) {
+            ch = rd();
+        }
+        string dst(src.size(), 0);
+
+        cout << fixed << setprecision(2);
+        cout << "Internet checksum throughput in Gbit/s (add / copy_and_add)\n";
+        cout << setw(8) << "size" << setw(16) << "byte-at-a-time";
+        for (const auto &[kernel, name] : kernels) {
+            if (InternetChecksum::use_kernel(kernel)) {
+                cout << setw(20) << name;
+            }
+        }
+        cout << "\n";
+
+        for (const size_t size : {20, 40, 64, 256, 576, 1500, 4096, 16384, 65536}) {
+            const string_view data = string_view(src).substr(0, size);
+
+            cout << setw(8) << size << setw(16) << measure(size, [&] {
+                ByteAtATimeChecksum check;
+                check.add(data);
+                return check.value();
+            });
+
+            for (const auto &kernel : kernels) {
+                if (not InternetChecksum::use_kernel(kernel.first)) {
+                    continue;
+                }
+                const double sum_only = measure(size, [&] {
+                    InternetChecksum check;
+                    check.add(data);
+                    return check.value();
+                });
+                const double fused = measure(size, [&] {
+                    InternetChecksum check;
+                    check.copy_and_add(dst.data(), data);
+                    return check.value();
+                });
+                cout << setw(11) << sum_only << " / " << setw(6) << fused;
+            }
+            cout << "\n";
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
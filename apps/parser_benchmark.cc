@@ -0,0 +1,149 @@
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <pcap/pcap.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t total_packets = 4'000'000;  // packets parsed per measurement
+
+//! Holds the last measurement's combined fields, so the compiler cannot drop the parses
+static volatile uint64_t result_sink = 0;
+
+//! Field-at-a-time parse of the fixed IPv4 and TCP fields, as IPv4Header::parse and TCPHeader::parse
+//! did before they decoded from NetParser::take()
+static bool parse_field_at_a_time(const Buffer &packet, IPv4Header &ip, TCPHeader &tcp) {
+    NetParser p{packet};
+    const uint8_t first_byte = p.u8();
+    ip.ver = first_byte >> 4;
+    ip.hlen = first_byte & 0x0f;
+    ip.tos = p.u8();
+    ip.len = p.u16();
+    ip.id = p.u16();
+    const uint16_t fo_val = p.u16();
+    ip.df = static_cast<bool>(fo_val & 0x4000);
+    ip.mf = static_cast<bool>(fo_val & 0x2000);
+    ip.offset = fo_val & 0x1fff;
+    ip.ttl = p.u8();
+    ip.proto = p.u8();
+    ip.cksum = p.u16();
+    ip.src = p.u32();
+    ip.dst = p.u32();
+    p.remove_prefix(ip.hlen * 4 - IPv4Header::LENGTH);
+
+    tcp.sport = p.u16();
+    tcp.dport = p.u16();
+    tcp.seqno = WrappingInt32{p.u32()};
+    tcp.ackno = WrappingInt32{p.u32()};
+    tcp.doff = p.u8() >> 4;
+    const uint8_t fl_b = p.u8();
+    tcp.ack = static_cast<bool>(fl_b & 0b0001'0000);
+    tcp.rst = static_cast<bool>(fl_b & 0b0000'0100);
+    tcp.syn = static_cast<bool>(fl_b & 0b0000'0010);
+    tcp.fin = static_cast<bool>(fl_b & 0b0000'0001);
+    tcp.win = p.u16();
+    tcp.cksum = p.u16();
+    tcp.uptr = p.u16();
+    return not p.error();
+}
+
+//! The same fields through the bulk-load parsers
+static bool parse_bulk(const Buffer &packet, IPv4Header &ip, TCPHeader &tcp) {
+    NetParser p{packet};
+    ip.parse(p);
+    return tcp.parse(p) == ParseResult::NoError;
+}
+
+//! Full datagram and segment parse, including both checksums
+static bool parse_full(const Buffer &packet, IPv4Header &ip, TCPHeader &tcp) {
+    IPv4Datagram dgram;
+    TCPSegment seg;
+    if (dgram.parse(packet) != ParseResult::NoError or
+        seg.parse(dgram.payload().concatenate(), dgram.header().pseudo_cksum()) != ParseResult::NoError) {
+        return false;
+    }
+    ip = dgram.header();
+    tcp = seg.header();
+    return true;
+}
+
+//! \returns packets per second achieved by `parse` over the corpus
+template <typename T>
+double measure(const vector<Buffer> &packets, T &&parse) {
+    IPv4Header ip;
+    TCPHeader tcp;
+    uint64_t sink = 0;
+    size_t parsed = 0;
+    const auto start = steady_clock::now();
+    while (parsed < total_packets) {
+        for (const auto &packet : packets) {
+            sink += parse(packet, ip, tcp) ? tcp.seqno.raw_value() ^ ip.src : 0;
+        }
+        parsed += packets.size();
+    }
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    result_sink = sink;
+    return parsed * 1e9 / double(duration);
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 2) {
+            cerr << "Usage: " << argv[0] << " tests/ipv4_parser.data\n";
+            return EXIT_FAILURE;
+        }
+
+        char errbuf[PCAP_ERRBUF_SIZE];
+        pcap_t *pcap = pcap_open_offline(argv[1], static_cast<char *>(errbuf));
+        if (pcap == nullptr) {
+            cerr << "ERROR opening " << argv[1] << ": " << static_cast<char *>(errbuf) << "\n";
+            return EXIT_FAILURE;
+        }
+
+        // keep the IPv4 datagrams carrying TCP segments that parse cleanly
+        vector<Buffer> packets;
+        const uint8_t *pkt;
+        struct pcap_pkthdr hdr;
+        while ((pkt = pcap_next(pcap, &hdr)) != nullptr) {
+            if (hdr.caplen < 14 or pkt[12] != 0x08 or pkt[13] != 0x00) {
+                continue;
+            }
+            Buffer packet{string(pkt + 14, pkt + hdr.caplen)};
+            IPv4Header ip;
+            TCPHeader tcp;
+            if (parse_full(packet, ip, tcp) and ip.proto == IPv4Header::PROTO_TCP) {
+                packets.push_back(packet);
+            }
+        }
+        pcap_close(pcap);
+
+        if (packets.empty()) {
+            cerr << "ERROR no IPv4/TCP packets in " << argv[1] << "\n";
+            return EXIT_FAILURE;
+        }
+
+        cout << fixed << setprecision(2);
+        cout << "Parsed " << packets.size() << " IPv4/TCP packets from " << argv[1] << " repeatedly\n";
+        cout << "  headers, field at a time (before): " << setw(8) << measure(packets, parse_field_at_a_time) / 1e6
+             << " Mpps\n";
+        cout << "  headers, bulk loads (after):       " << setw(8) << measure(packets, parse_bulk) / 1e6
+             << " Mpps\n";
+        cout << "  full parse with checksums:         " << setw(8) << measure(packets, parse_full) / 1e6
+             << " Mpps\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
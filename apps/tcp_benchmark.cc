@@ -1,5 +1,6 @@
 #include "tcp_connection.hh"
 
+#include <array>
 #include <chrono>
 #include <cstdlib>
 #include <iomanip>
@@ -30,6 +31,7 @@ void move_segments(TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segme
 
 void main_loop(const bool reorder) {
     TCPConfig config;
+    config.send_storage = ByteStream::Storage::Chunked;
     TCPConnection x{config}, y{config};
 
     string string_to_send(len, 'x');
@@ -47,12 +49,18 @@ void main_loop(const bool reorder) {
     string_received.reserve(len);
 
     const auto first_time = high_resolution_clock::now();
+    array<BufferPool::Stats, BufferPool::BLOCK_SIZES.size()> first_stats;
+    for (size_t i = 0; i < first_stats.size(); ++i) {
+        first_stats[i] = BufferPool::local(i).stats();
+    }
 
     auto loop = [&] {
         // write input into x
         while (bytes_to_send.size() and x.remaining_outbound_capacity()) {
             const auto want = min(x.remaining_outbound_capacity(), bytes_to_send.size());
-            const auto written = x.write(string(bytes_to_send.str().substr(0, want)));
+            Buffer chunk = bytes_to_send;
+            chunk.remove_suffix(chunk.size() - want);
+            const auto written = x.write(move(chunk));
             if (want != written) {
                 throw runtime_error("want = " + to_string(want) + ", written = " + to_string(written));
             }
@@ -97,6 +105,12 @@ void main_loop(const bool reorder) {
     cout << fixed << setprecision(2);
     cout << "CPU-limited throughput" << (reorder ? " with reordering: " : "                : ") << gigabits_per_second
          << " Gbit/s\n";
+    for (size_t i = 0; i < first_stats.size(); ++i) {
+        const auto &stats = BufferPool::local(i).stats();
+        cout << "  " << setw(2) << BufferPool::BLOCK_SIZES[i] / 1024
+             << " KB buffer pool: " << stats.hits - first_stats[i].hits << " hits, "
+             << stats.misses - first_stats[i].misses << " misses\n";
+    }
 
     while (x.active() or y.active()) {
         loop();
@@ -101,8 +101,8 @@ static tuple<TCPConfig, FdAdapterConfig, Address, string> get_config(int argc, c
     }
 
     // parse positional command-line arguments
-    c_filt.destination = {argv[curr], argv[curr + 1]};
-    c_filt.source = {source_address, source_port};
+    c_filt.set_destination({argv[curr], argv[curr + 1]});
+    c_filt.set_source({source_address, source_port});
 
     Address next_hop{next_hop_address, "0"};
 
@@ -127,7 +127,7 @@ int main(int argc, char **argv) {
         auto [c_fsm, c_filt, next_hop, tap_dev_name] = get_config(argc, argv);
 
         TCPOverIPv4OverEthernetSpongeSocket tcp_socket(TCPOverIPv4OverEthernetAdapter(
-            TCPOverIPv4OverEthernetAdapter(TapFD(tap_dev_name), local_ethernet_address, c_filt.source, next_hop)));
+            TCPOverIPv4OverEthernetAdapter(TapFD(tap_dev_name), local_ethernet_address, c_filt.source(), next_hop)));
 
         tcp_socket.connect(c_fsm, c_filt);
 
@@ -32,7 +32,16 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-         << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+         << "   -r              Adapt the retransmission timeout to the RTT     (fixed)\n"
+         << "                   (RFC 6298, between 200 ms and 60 s)\n\n"
+
+         << "   -S              Offer selective acknowledgments (RFC 2018)      (off)\n\n"
+
+         << "   -c <algo>       Congestion control: none, newreno, cubic, bbr   none\n\n"
+
+         << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+         << "   -o              Offload checksums and segmentation to the tun   (off)\n"
+         << "                   (virtio-net headers, TSO and GRO)\n\n"
 
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -52,13 +61,14 @@ static void check_argc(int argc, char **argv, int curr, const char *err) {
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char **argv) {
+static tuple<TCPConfig, FdAdapterConfig, bool, char *, bool> get_config(int argc, char **argv) {
     TCPConfig c_fsm{};
     FdAdapterConfig c_filt{};
     char *tundev = nullptr;
 
     int curr = 1;
     bool listen = false;
+    bool offload = false;
 
     string source_address = LOCAL_ADDRESS_DFLT;
     string source_port = to_string(uint16_t(random_device()()));
@@ -88,11 +98,28 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-r", argv[curr], 3) == 0) {
+            c_fsm.adaptive_rto = RTOBounds{};
+            curr += 1;
+
+        } else if (strncmp("-S", argv[curr], 3) == 0) {
+            c_fsm.sack = true;
+            curr += 1;
+
+        } else if (strncmp("-c", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -c requires one argument.");
+            c_fsm.congestion_control = congestion_control_from_name(argv[curr + 1]);
+            curr += 2;
+
         } else if (strncmp("-d", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -t requires one argument.");
             tundev = argv[curr + 1];
             curr += 2;
 
+        } else if (strncmp("-o", argv[curr], 3) == 0) {
+            offload = true;
+            curr += 1;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -121,17 +148,17 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
 
     // parse positional command-line arguments
     if (listen) {
-        c_filt.source = {"0", argv[curr + 1]};
-        if (c_filt.source.port() == 0) {
+        c_filt.set_source({"0", argv[curr + 1]});
+        if (c_filt.source().port() == 0) {
             show_usage(argv[0], "ERROR: listen port cannot be zero in server mode.");
             exit(1);
         }
     } else {
-        c_filt.destination = {argv[curr], argv[curr + 1]};
-        c_filt.source = {source_address, source_port};
+        c_filt.set_destination({argv[curr], argv[curr + 1]});
+        c_filt.set_source({source_address, source_port});
     }
 
-    return make_tuple(c_fsm, c_filt, listen, tundev);
+    return make_tuple(c_fsm, c_filt, listen, tundev, offload);
 }
 
 int main(int argc, char **argv) {
@@ -141,9 +168,9 @@ int main(int argc, char **argv) {
             return EXIT_FAILURE;
         }
 
-        auto [c_fsm, c_filt, listen, tun_dev_name] = get_config(argc, argv);
+        auto [c_fsm, c_filt, listen, tun_dev_name, offload] = get_config(argc, argv);
         LossyTCPOverIPv4SpongeSocket tcp_socket(LossyTCPOverIPv4OverTunFdAdapter(
-            TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name))));
+            TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, false, offload))));
 
         if (listen) {
             tcp_socket.listen_and_accept(c_fsm, c_filt);
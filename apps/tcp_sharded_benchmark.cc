@@ -0,0 +1,138 @@
+#include "tcp_sharded_engine.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Result of one run of the benchmark
+struct Measurement {
+    double gbps;             //!< Payload received by the server per second
+    double steered_percent;  //!< Share of the server's segments read by a shard other than their own
+};
+
+//! \returns an adapter for a UDP socket bound to an ephemeral port on the loopback interface, and the port
+static pair<TCPOverUDPSocketAdapter, uint16_t> loopback_adapter() {
+    UDPSocket sock;
+    sock.bind(Address("127.0.0.1", 0));
+    const uint16_t port = sock.local_address().port();
+    return {TCPOverUDPSocketAdapter(move(sock)), port};
+}
+
+//! Send `bytes` over each of `connections` connections into a server with `shards` shards, with
+//! as many client threads, and measure how fast the server receives it all
+static Measurement measure(const size_t shards, const size_t connections, const size_t bytes) {
+    TCPConfig config;
+    config.rt_timeout = 20;
+
+    uint16_t server_port = 0;
+    TCPOverUDPShardedEngine server{shards, [&](const size_t) {
+                                       UDPSocket sock;
+                                       sock.set_reuseport();
+                                       sock.bind(Address("127.0.0.1", server_port));
+                                       server_port = sock.local_address().port();
+                                       return TCPOverUDPSocketAdapter(move(sock));
+                                   }};
+    server.listen(config, server_port, connections);
+
+    const uint64_t total = bytes * connections;
+    atomic<uint64_t> received{0};
+    atomic<bool> stop{false};
+
+    // each shard discards what its connections receive
+    thread server_thread([&] {
+        server.run([&](const size_t, TCPOverUDPEngine &engine) {
+            vector<TCPOverUDPEngine::Stream> streams;
+            uint64_t sunk = 0;
+            while (not stop) {
+                engine.wait_next_event(10);
+                while (auto stream = engine.accept()) {
+                    streams.push_back(stream.value());
+                }
+                for (auto &stream : streams) {
+                    if (stream.valid()) {
+                        ByteStream &inbound = stream.inbound_stream();
+                        sunk += inbound.buffer_size();
+                        inbound.pop_output(inbound.buffer_size());
+                    }
+                }
+                received.fetch_add(exchange(sunk, 0));
+            }
+        });
+    });
+
+    // each client thread drives the engines of its share of the connections
+    const Buffer payload{string(65536, 'x')};
+    const auto start = steady_clock::now();
+    vector<thread> client_threads;
+    for (size_t t = 0; t < shards; t++) {
+        client_threads.emplace_back([&, t] {
+            vector<unique_ptr<TCPOverUDPEngine>> clients;
+            vector<TCPOverUDPEngine::Stream> streams;
+            vector<size_t> remaining;
+            for (size_t i = t; i < connections; i += shards) {
+                auto [adapter, port] = loopback_adapter();
+                clients.push_back(make_unique<TCPOverUDPEngine>(move(adapter)));
+                const TCPFlow flow{0, Address("127.0.0.1").ipv4_numeric(), port, server_port};
+                streams.push_back(clients.back()->connect(config, flow));
+                remaining.push_back(bytes);
+            }
+
+            while (received < total and not stop) {
+                for (size_t i = 0; i < clients.size(); i++) {
+                    auto &stream = streams[i];
+                    while (remaining[i] and stream.valid() and stream.remaining_outbound_capacity()) {
+                        Buffer piece = payload;
+                        piece.remove_suffix(payload.size() - min(payload.size(), remaining[i]));
+                        remaining[i] -= stream.write(move(piece));
+                    }
+                    clients[i]->wait_next_event(0);
+                }
+                this_thread::yield();
+            }
+        });
+    }
+
+    for (auto &thread : client_threads) {
+        thread.join();
+    }
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    stop = true;
+    server_thread.join();
+
+    const double steered = 100.0 * server.segments_steered() / max(uint64_t{1}, server.segments_read());
+    return {total * 8.0 / double(duration), steered};
+}
+
+int main(int argc, char **argv) {
+    try {
+        const size_t max_shards = argc > 1 ? stoul(argv[1]) : max(1u, thread::hardware_concurrency());
+        const size_t connections = argc > 2 ? stoul(argv[2]) : 64;
+        const size_t bytes = (argc > 3 ? stoul(argv[3]) : 4) * 1024 * 1024;
+
+        cout << fixed << setprecision(2);
+        cout << "TCP-over-UDP throughput into a sharded engine, " << connections << " connections of "
+             << bytes / (1024 * 1024) << " MiB (" << thread::hardware_concurrency() << " cores)\n";
+        cout << setw(8) << "shards" << setw(12) << "Gbit/s" << setw(12) << "steered" << "\n";
+        for (size_t shards = 1; shards <= max_shards; shards *= 2) {
+            const auto m = measure(shards, connections, bytes);
+            cout << setw(8) << shards << setw(12) << m.gbps << setw(11) << m.steered_percent << "%\n";
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
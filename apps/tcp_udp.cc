@@ -28,6 +28,13 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -r              Adapt the retransmission timeout to the RTT     (fixed)\n"
+         << "                   (RFC 6298, between 200 ms and 60 s)\n\n"
+
+         << "   -S              Offer selective acknowledgments (RFC 2018)      (off)\n\n"
+
+         << "   -c <algo>       Congestion control: none, newreno, cubic, bbr   none\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
@@ -68,6 +75,19 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-r", argv[curr], 3) == 0) {
+            c_fsm.adaptive_rto = RTOBounds{};
+            curr += 1;
+
+        } else if (strncmp("-S", argv[curr], 3) == 0) {
+            c_fsm.sack = true;
+            curr += 1;
+
+        } else if (strncmp("-c", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -c requires one argument.");
+            c_fsm.congestion_control = congestion_control_from_name(argv[curr + 1]);
+            curr += 2;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -95,9 +115,9 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
     }
 
     if (listen) {
-        c_filt.source = {"0", argv[argc - 1]};
+        c_filt.set_source({"0", argv[argc - 1]});
     } else {
-        c_filt.destination = {argv[argc - 2], argv[argc - 1]};
+        c_filt.set_destination({argv[argc - 2], argv[argc - 1]});
     }
 
     return make_tuple(c_fsm, c_filt, listen);
@@ -116,7 +136,7 @@ int main(int argc, char **argv) {
         // build a TCP FSM on top of the UDP socket
         UDPSocket udp_sock;
         if (listen) {
-            udp_sock.bind(c_filt.source);
+            udp_sock.bind(c_filt.source());
         }
         LossyTCPOverUDPSpongeSocket tcp_socket(LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))));
         if (listen) {
@@ -0,0 +1,83 @@
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t iterations = 1 << 20;  // datagrams unwrapped per measurement
+
+//! An adapter that demultiplexes the way unwrap_tcp_in_ip did before FdAdapterConfig cached its
+//! numeric tuple: by asking the configured Address objects for their numbers on every datagram
+class AddressLookupAdapter : public TCPOverIPv4Adapter {
+  public:
+    optional<TCPSegment> unwrap_by_address(const InternetDatagram &ip_dgram) {
+        if (ip_dgram.header().dst != config().source().ipv4_numeric() or
+            ip_dgram.header().src != config().destination().ipv4_numeric() or
+            ip_dgram.header().proto != IPv4Header::PROTO_TCP) {
+            return {};
+        }
+
+        TCPSegment tcp_seg;
+        if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(), false)) {
+            return {};
+        }
+
+        if (tcp_seg.header().dport != config().source().port() or
+            tcp_seg.header().sport != config().destination().port()) {
+            return {};
+        }
+        return tcp_seg;
+    }
+};
+
+//! \returns nanoseconds per datagram taken by `unwrap`, which must accept every datagram
+template <typename T>
+double measure(T &&unwrap) {
+    size_t accepted = 0;
+    const auto start = steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        accepted += unwrap().has_value();
+    }
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    if (accepted != iterations) {
+        throw runtime_error("unwrap_benchmark: a datagram was rejected");
+    }
+    return double(duration) / iterations;
+}
+
+int main() {
+    try {
+        AddressLookupAdapter adapter;
+        adapter.config_mut().set_source({"10.0.0.1", 1234});
+        adapter.config_mut().set_destination({"10.0.0.2", 80});
+
+        // a datagram from the peer, serialized and parsed back as if it had come off the wire
+        AddressLookupAdapter peer;
+        peer.config_mut().set_source(adapter.config().destination());
+        peer.config_mut().set_destination(adapter.config().source());
+        TCPSegment seg;
+        seg.header().ack = true;
+        seg.payload() = Buffer(string(64, 'x'));
+        InternetDatagram dgram;
+        if (ParseResult::NoError != dgram.parse(Buffer(peer.wrap_tcp_in_ip(seg).serialize().concatenate()))) {
+            throw runtime_error("unwrap_benchmark: could not parse the datagram");
+        }
+
+        cout << fixed << setprecision(1);
+        cout << "Demultiplexing an established connection's datagram, in ns per datagram\n";
+        cout << setw(28) << "Address lookups" << setw(12)
+             << measure([&] { return adapter.unwrap_by_address(dgram); }) << "\n";
+        cout << setw(28) << "cached numeric tuple" << setw(12)
+             << measure([&] { return adapter.unwrap_tcp_in_ip(dgram, true); }) << "\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -18,6 +18,11 @@ add_test(NAME t_send_retx            COMMAND send_retx)
 add_test(NAME t_send_window          COMMAND send_window)
 add_test(NAME t_send_ack             COMMAND send_ack)
 add_test(NAME t_send_close           COMMAND send_close)
+add_test(NAME t_congestion_control   COMMAND congestion_control)
+add_test(NAME t_rtt_estimation       COMMAND rtt_estimation)
+add_test(NAME t_fast_retransmit      COMMAND fast_retransmit)
+add_test(NAME t_sack                 COMMAND sack)
+add_test(NAME t_sponge_socket        COMMAND sponge_socket)
 
 add_test(NAME t_strm_reassem_cap         COMMAND fsm_stream_reassembler_cap)
 add_test(NAME t_strm_reassem_single      COMMAND fsm_stream_reassembler_single)
@@ -33,6 +38,8 @@ add_test(NAME t_byte_stream_one_write    COMMAND byte_stream_one_write)
 add_test(NAME t_byte_stream_two_writes   COMMAND byte_stream_two_writes)
 add_test(NAME t_byte_stream_capacity     COMMAND byte_stream_capacity)
 add_test(NAME t_byte_stream_many_writes  COMMAND byte_stream_many_writes)
+add_test(NAME t_byte_stream_spans        COMMAND byte_stream_spans)
+add_test(NAME t_byte_stream_chunked      COMMAND byte_stream_chunked)
 
 add_test(NAME t_webget               COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh")
 
@@ -42,6 +49,16 @@ add_test(NAME router_test    COMMAND network_simulator)
 
 add_test(NAME t_tcp_parser           COMMAND tcp_parser "${PROJECT_SOURCE_DIR}/tests/ipv4_parser.data")
 add_test(NAME t_ipv4_parser          COMMAND ipv4_parser "${PROJECT_SOURCE_DIR}/tests/ipv4_parser.data")
+add_test(NAME t_internet_checksum    COMMAND internet_checksum)
+add_test(NAME t_packet_builder       COMMAND packet_builder)
+add_test(NAME t_buffer_pool          COMMAND buffer_pool)
+add_test(NAME t_eventloop            COMMAND eventloop)
+add_test(NAME t_timer_wheel          COMMAND timer_wheel)
+add_test(NAME t_tcp_engine           COMMAND tcp_engine)
+add_test(NAME t_tcp_listener         COMMAND tcp_listener)
+add_test(NAME t_toeplitz_hash        COMMAND toeplitz_hash)
+add_test(NAME t_tcp_sharded_engine   COMMAND tcp_sharded_engine)
+add_test(NAME t_udp_batch            COMMAND udp_batch)
 add_test(NAME t_active_close         COMMAND fsm_active_close)
 add_test(NAME t_passive_close        COMMAND fsm_passive_close)
 add_test(NAME ec_ack_rst             COMMAND fsm_ack_rst)
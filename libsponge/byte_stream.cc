@@ -1,6 +1,7 @@
 #include "byte_stream.hh"
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <stdexcept>
 
@@ -8,34 +9,153 @@
 
 using namespace std;
 
-ByteStream::ByteStream(const size_t capacity) : _capacity(capacity) {}
+//! \returns the smallest power of two that is at least `n` (and at least 1)
+static size_t round_up_to_power_of_two(const size_t n) {
+    size_t ret = 1;
+    while (ret < n) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+//! \param[in] capacity is the maximum number of bytes the stream will buffer
+//! \param[in] storage selects how buffered bytes are held (see ByteStream::Storage)
+ByteStream::ByteStream(const size_t capacity, const Storage storage)
+    : _storage(storage)
+    , _buffer(storage == Storage::Ring ? round_up_to_power_of_two(capacity) : 0)
+    , _mask(_buffer.size() - 1)
+    , _capacity(capacity) {}
 
-size_t ByteStream::write(const string &data) {
+size_t ByteStream::write(const string_view data) {
     size_t bytes_to_write = min(data.size(), remaining_capacity());
-    _buffer.insert(_buffer.end(), data.begin(), data.begin() + bytes_to_write);
-    _bytes_written += bytes_to_write;
+    if (bytes_to_write == 0) {
+        return 0;
+    }
+    if (_storage == Storage::Chunked) {
+        auto [chunk, dst] = Buffer::allocate(bytes_to_write);
+        memcpy(dst, data.data(), bytes_to_write);
+        return write(move(chunk));
+    }
+
+    size_t bytes_copied = 0;
+    while (bytes_copied < bytes_to_write) {
+        const auto [dst, len] = writable_span();
+        const size_t n = min(len, bytes_to_write - bytes_copied);
+        memcpy(dst, data.data() + bytes_copied, n);
+        commit(n);
+        bytes_copied += n;
+    }
     return bytes_to_write;
 }
 
+//! \param[in] data is appended by reference for Storage::Chunked (trimmed to the remaining
+//! capacity), or copied into the ring buffer for Storage::Ring
+size_t ByteStream::write(Buffer data) {
+    if (_storage == Storage::Ring) {
+        return write(data.str());
+    }
+
+    size_t bytes_to_write = min(data.size(), remaining_capacity());
+    if (bytes_to_write > 0) {
+        data.remove_suffix(data.size() - bytes_to_write);
+        _chunks.append(BufferList(move(data)));
+        _bytes_written += bytes_to_write;
+    }
+    return bytes_to_write;
+}
+
+//! \details The span ends at the end of the ring buffer or at the capacity limit, whichever comes
+//! first, so it may be shorter than remaining_capacity(); write again after commit() to use the rest.
+pair<char *, size_t> ByteStream::writable_span() {
+    if (_storage != Storage::Ring) {
+        throw runtime_error("ByteStream::writable_span: only available with Storage::Ring");
+    }
+    const size_t tail = _bytes_written & _mask;
+    return {_buffer.data() + tail, min(_buffer.size() - tail, remaining_capacity())};
+}
+
+//! \param[in] len bytes that were written into writable_span() become readable
+void ByteStream::commit(const size_t len) {
+    if (_storage != Storage::Ring) {
+        throw runtime_error("ByteStream::commit: only available with Storage::Ring");
+    }
+    if (len > remaining_capacity()) {
+        throw out_of_range("ByteStream::commit");
+    }
+    _bytes_written += len;
+}
+
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    return string(_buffer.begin(), _buffer.begin() + min(len, buffer_size()));
+    string ret(min(len, buffer_size()), 0);
+    _peek_into(ret.data(), ret.size());
+    return ret;
+}
+
+//! \param[out] dst receives the bytes; it must have room for `len` bytes
+//! \param[in] len is the number of bytes to copy, at most buffer_size()
+void ByteStream::_peek_into(char *dst, const size_t len) const {
+    size_t copied = 0;
+    if (_storage == Storage::Chunked) {
+        for (auto it = _chunks.buffers().begin(); it != _chunks.buffers().end() and copied < len; ++it) {
+            const size_t n = min(it->size(), len - copied);
+            memcpy(dst + copied, it->str().data(), n);
+            copied += n;
+        }
+        return;
+    }
+
+    for (const auto &span : readable_spans()) {
+        const size_t n = min(span.size(), len - copied);
+        memcpy(dst + copied, span.data(), n);
+        copied += n;
+    }
+}
+
+array<string_view, 2> ByteStream::readable_spans() const {
+    if (_storage == Storage::Chunked) {
+        const auto &chunks = _chunks.buffers();
+        return {chunks.size() > 0 ? chunks[0].str() : string_view{},
+                chunks.size() > 1 ? chunks[1].str() : string_view{}};
+    }
+
+    const size_t head = _bytes_read & _mask;
+    const size_t first_len = min(_buffer.size() - head, buffer_size());
+    return {string_view{_buffer.data() + head, first_len}, string_view{_buffer.data(), buffer_size() - first_len}};
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
-void ByteStream::pop_output(const size_t len) {
-    size_t bytes_to_pop = min(len, buffer_size());
-    _buffer.erase(_buffer.begin(), _buffer.begin() + bytes_to_pop);
+void ByteStream::consume(const size_t len) {
+    const size_t bytes_to_pop = min(len, buffer_size());
+    if (_storage == Storage::Chunked) {
+        _chunks.remove_prefix(bytes_to_pop);
+    }
     _bytes_read += bytes_to_pop;
 }
 
+//! \param[in] len is the maximum number of bytes to read
+Buffer ByteStream::read_buffer(const size_t len) {
+    const size_t bytes_to_read = min(len, buffer_size());
+    if (_storage == Storage::Chunked and bytes_to_read > 0 and _chunks.buffers().front().size() >= bytes_to_read) {
+        Buffer ret = _chunks.buffers().front();
+        ret.remove_suffix(ret.size() - bytes_to_read);
+        consume(bytes_to_read);
+        return ret;
+    }
+
+    auto [ret, dst] = Buffer::allocate(bytes_to_read);
+    _peek_into(dst, bytes_to_read);
+    consume(bytes_to_read);
+    return move(ret);
+}
+
 void ByteStream::end_input() { _input_ended = true; }
 
 bool ByteStream::input_ended() const { return _input_ended; }
 
-size_t ByteStream::buffer_size() const { return _buffer.size(); }
+size_t ByteStream::buffer_size() const { return _bytes_written - _bytes_read; }
 
-bool ByteStream::buffer_empty() const { return _buffer.empty(); }
+bool ByteStream::buffer_empty() const { return buffer_size() == 0; }
 
 bool ByteStream::eof() const { return input_ended() && buffer_empty(); }
 
@@ -1,11 +1,15 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "buffer.hh"
+
+#include <array>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 //! \brief An in-order byte stream.
 
@@ -13,17 +17,31 @@
 //! side.  The byte stream is finite: the writer can end the input,
 //! and then no more bytes can be written.
 class ByteStream {
+  public:
+    //! How the stream holds the bytes that have been written but not yet read
+    enum class Storage {
+        Ring,    //!< Copy bytes into a contiguous ring buffer (allows in-place writes through writable_span())
+        Chunked  //!< Keep the written Buffers by reference, so read_buffer() can hand out shared slices
+    };
+
   private:
-    std::deque<char> _buffer{};
+    Storage _storage;
+    //! Ring buffer storage; its size is a power of two no smaller than `_capacity` (empty for Storage::Chunked)
+    std::vector<char> _buffer;
+    size_t _mask;  //!< `_buffer.size() - 1`, maps an absolute stream index to a slot in `_buffer`
+    BufferList _chunks{};  //!< Buffered bytes for Storage::Chunked
     size_t _capacity;
     size_t _bytes_read = 0;
     size_t _bytes_written = 0;
     bool _input_ended = false;
     bool _error = false;  //!< Flag indicating that the stream suffered an error.
 
+    //! Copy the next `len` buffered bytes to `dst` without popping them
+    void _peek_into(char *dst, const size_t len) const;
+
   public:
     //! Construct a stream with room for `capacity` bytes.
-    ByteStream(const size_t capacity);
+    ByteStream(const size_t capacity, const Storage storage = Storage::Ring);
 
     //! \name "Input" interface for the writer
     //!@{
@@ -31,11 +49,30 @@ class ByteStream {
     //! Write a string of bytes into the stream. Write as many
     //! as will fit, and return how many were written.
     //! \returns the number of bytes accepted into the stream
-    size_t write(const std::string &data);
+    size_t write(const std::string_view data);
+
+    //! \brief Write a Buffer into the stream; a Storage::Chunked stream keeps it without copying.
+    //! \returns the number of bytes accepted into the stream
+    size_t write(Buffer data);
+
+    //! \brief Write a string into the stream; a Storage::Chunked stream takes ownership without copying.
+    //! \returns the number of bytes accepted into the stream
+    size_t write(std::string &&data) { return write(Buffer(std::move(data))); }
+
+    //! \brief Contiguous free space that the writer may fill in place
+    //! \returns a pointer to the first free byte and the number of bytes that may be written there
+    //! \note Call commit() afterwards to make the bytes part of the stream. Only available for Storage::Ring.
+    std::pair<char *, size_t> writable_span();
+
+    //! Append `len` bytes that were written in place through writable_span()
+    void commit(const size_t len);
 
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
 
+    //! How the stream stores its bytes
+    Storage storage() const { return _storage; }
+
     //! Signal that the byte stream has reached its ending
     void end_input();
 
@@ -50,8 +87,23 @@ class ByteStream {
     //! \returns a string
     std::string peek_output(const size_t len) const;
 
+    //! \brief Views of the buffered bytes, without copying
+    //! \returns two views that hold the next buffered bytes in order. For Storage::Ring they hold
+    //! all of them (the second is empty unless the bytes wrap around the end of the ring buffer);
+    //! for Storage::Chunked they are the first two chunks.
+    //! \note The views are invalidated by any write to or pop from the stream
+    std::array<std::string_view, 2> readable_spans() const;
+
+    //! \brief Read (i.e., take and then pop) up to `len` bytes as a Buffer
+    //! \details For Storage::Chunked, the result shares storage with the written Buffer whenever
+    //! the bytes come from a single chunk; otherwise they are copied into a pooled Buffer.
+    Buffer read_buffer(const size_t len);
+
+    //! Remove bytes from the buffer (same as pop_output())
+    void consume(const size_t len);
+
     //! Remove bytes from the buffer
-    void pop_output(const size_t len);
+    void pop_output(const size_t len) { consume(len); }
 
     //! Read (i.e., copy and then pop) the next "len" bytes of the stream
     //! \returns a vector of bytes read
@@ -0,0 +1,279 @@
+#include "congestion_controller.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+CongestionControl congestion_control_from_name(const string &name) {
+    if (name == "none") {
+        return CongestionControl::None;
+    }
+    if (name == "newreno") {
+        return CongestionControl::NewReno;
+    }
+    if (name == "cubic") {
+        return CongestionControl::Cubic;
+    }
+    if (name == "bbr") {
+        return CongestionControl::BBR;
+    }
+    throw runtime_error("unknown congestion control algorithm: " + name);
+}
+
+//! \param[in] algorithm is the algorithm to use
+//! \param[in] mss is the largest payload the sender puts in a segment
+unique_ptr<CongestionController> CongestionController::make(const CongestionControl algorithm, const size_t mss) {
+    switch (algorithm) {
+        case CongestionControl::NewReno:
+            return make_unique<NewRenoController>(mss);
+        case CongestionControl::Cubic:
+            return make_unique<CubicController>(mss);
+        case CongestionControl::BBR:
+            return make_unique<BBRController>(mss);
+        case CongestionControl::None:
+            break;
+    }
+    return nullptr;
+}
+
+//! \details The initial window is the one of RFC 5681 (three segments of 1452 bytes, or 4380 bytes).
+//! \param[in] mss is the largest payload the sender puts in a segment
+NewRenoController::NewRenoController(const size_t mss)
+    : _mss(mss), _cwnd(min(4 * mss, max(2 * mss, size_t{4380}))), _ssthresh(numeric_limits<size_t>::max()) {}
+
+//! \details The window grows by at most two segments per acknowledgment (appropriate byte counting, RFC 3465).
+size_t NewRenoController::_slow_start(const size_t bytes_acked) {
+    if (_cwnd >= _ssthresh) {
+        return bytes_acked;
+    }
+    const size_t grow = min({bytes_acked, 2 * _mss, _ssthresh - _cwnd});
+    _cwnd += grow;
+    return _cwnd >= _ssthresh ? bytes_acked - grow : 0;
+}
+
+//! \details In fast recovery the window stays at `_ssthresh`; the sender inflates it.
+void NewRenoController::on_ack(const AckSample &sample) {
+    if (sample.in_recovery) {
+        return;
+    }
+    _acked_in_ca += _slow_start(sample.bytes_acked);
+    if (_acked_in_ca >= _cwnd) {
+        _acked_in_ca -= _cwnd;
+        _cwnd += _mss;
+    }
+}
+
+void NewRenoController::on_loss(const uint64_t, const size_t bytes_in_flight) {
+    _ssthresh = max(bytes_in_flight / 2, 2 * _mss);
+    _cwnd = _ssthresh;
+    _acked_in_ca = 0;
+}
+
+//! \details Rather than open the whole window at once, which would send it in one burst, grow it from what
+//! is left in flight (RFC 6582, 3.2 step 3).
+void NewRenoController::on_recovery_exit(const size_t bytes_in_flight) {
+    _cwnd = min(_ssthresh, max(bytes_in_flight, _mss) + _mss);
+}
+
+void NewRenoController::on_rto(const uint64_t, const size_t bytes_in_flight) {
+    _ssthresh = max(bytes_in_flight / 2, 2 * _mss);
+    _cwnd = _mss;
+    _acked_in_ca = 0;
+}
+
+//! \details With fast convergence: a loss below the previous plateau lowers the next plateau further,
+//! releasing bandwidth to newer flows. The window of the loss is at least what was in flight, so that
+//! back-to-back timeouts (each of which leaves the window at one segment) don't shrink it to nothing.
+void CubicController::_reduce(const size_t bytes_in_flight) {
+    const size_t window = max(_cwnd, bytes_in_flight);
+    const double w = double(window) / _mss;
+    _w_max = w < _w_max ? w * (1 + BETA) / 2 : w;
+    _ssthresh = max(static_cast<size_t>(window * BETA), 2 * _mss);
+    _acked_in_ca = 0;
+    _growth = 0;
+    _epoch.reset();
+}
+
+void CubicController::on_ack(const AckSample &sample) {
+    _rtt = sample.rtt.value_or(_rtt);
+    if (sample.in_recovery) {
+        return;
+    }
+    const size_t bytes_acked = _slow_start(sample.bytes_acked);
+    if (bytes_acked == 0) {
+        return;
+    }
+
+    const double cwnd = double(_cwnd) / _mss;
+    if (not _epoch) {
+        _epoch = sample.now;
+        _k = _w_max > cwnd ? cbrt((_w_max - cwnd) / C) : 0;
+        _w_max = max(_w_max, cwnd);
+        _w_est = cwnd;
+    }
+
+    // where the curve will be one RTT from now, but never more than half again the current window
+    const double t = double(sample.now - _epoch.value() + _rtt) / 1000;
+    double target = clamp(C * pow(t - _k, 3) + _w_max, cwnd, 1.5 * cwnd);
+
+    // in the region where NewReno would grow faster, grow as fast as NewReno (with CUBIC's decrease factor)
+    _w_est += 3 * (1 - BETA) / (1 + BETA) * (double(bytes_acked) / _mss) / cwnd;
+    target = max(target, _w_est);
+
+    // each acknowledged byte closes 1/cwnd of the gap to the target; with a large window (or small
+    // acknowledgments) that is less than a byte, so the fraction is kept for the next acknowledgment
+    _growth += (target - cwnd) / cwnd * bytes_acked;
+    const auto whole_bytes = static_cast<size_t>(_growth);
+    _cwnd += whole_bytes;
+    _growth -= whole_bytes;
+}
+
+void CubicController::on_loss(const uint64_t, const size_t bytes_in_flight) {
+    _reduce(bytes_in_flight);
+    _cwnd = _ssthresh;
+}
+
+void CubicController::on_rto(const uint64_t, const size_t bytes_in_flight) {
+    _reduce(bytes_in_flight);
+    _cwnd = _mss;
+}
+
+double BBRController::_bdp() const { return _bandwidth * max<size_t>(_min_rtt.value_or(1), 1); }
+
+void BBRController::_update_pacing_rate() {
+    double rate = _pacing_gain * _bandwidth;
+    if (_pacing_rate == 0 and _min_rtt) {
+        // at first, send the initial window over one RTT (times the gain)
+        rate = _pacing_gain * _cwnd / max<size_t>(_min_rtt.value(), 1);
+    }
+    if (_filled_pipe or rate > _pacing_rate) {
+        _pacing_rate = rate;
+    }
+}
+
+//! \details Until the pipe is filled the window grows with each acknowledgment, like slow start, up to the
+//! target (or regardless of it, until the first ten segments are delivered).
+void BBRController::_update_window(const size_t bytes_acked, const uint64_t delivered) {
+    const size_t target = max(4 * _mss, static_cast<size_t>(_cwnd_gain * _bdp()));
+    if (_filled_pipe) {
+        _cwnd = min(_cwnd + bytes_acked, target);
+    } else if (_cwnd < target or delivered < 10 * _mss) {
+        _cwnd += bytes_acked;
+    }
+    _cwnd = max(_cwnd, 4 * _mss);
+}
+
+void BBRController::_enter_probe_bw(const uint64_t now) {
+    _mode = Mode::ProbeBW;
+    _cwnd_gain = 2;
+    // start anywhere in the cycle but the phase that drains the queue
+    _cycle_index = (now / max<size_t>(_min_rtt.value_or(1), 1)) % (PACING_GAINS.size() - 1);
+    _cycle_index += _cycle_index >= 1;
+    _cycle_stamp = now;
+    _pacing_gain = PACING_GAINS.at(_cycle_index);
+}
+
+void BBRController::on_ack(const AckSample &sample) {
+    _after_rto = false;
+
+    // the propagation delay is the smallest RTT seen in the last MIN_RTT_EXPIRY_MS
+    const bool min_rtt_expired = _min_rtt and sample.now > _min_rtt_stamp + MIN_RTT_EXPIRY_MS;
+    if (sample.rtt and (not _min_rtt or sample.rtt.value() <= _min_rtt.value() or min_rtt_expired)) {
+        _min_rtt = sample.rtt;
+        _min_rtt_stamp = sample.now;
+    }
+
+    // a round ends when a segment sent after the previous round ended is acknowledged
+    bool round_start = false;
+    if (sample.prior_delivered >= _next_round_delivered) {
+        _next_round_delivered = sample.delivered;
+        _round++;
+        round_start = true;
+        _bandwidth_samples.at(_round % BANDWIDTH_ROUNDS) = 0;
+    }
+
+    // an application-limited sample only counts if it shows more bandwidth than the estimate
+    if (sample.interval > 0) {
+        const double rate = double(sample.delivered - sample.prior_delivered) / sample.interval;
+        if (not sample.application_limited or rate > _bandwidth) {
+            double &slot = _bandwidth_samples.at(_round % BANDWIDTH_ROUNDS);
+            slot = max(slot, rate);
+        }
+    }
+    _bandwidth = *max_element(_bandwidth_samples.begin(), _bandwidth_samples.end());
+
+    switch (_mode) {
+        case Mode::Startup:
+            // the pipe is full once three rounds in a row have not grown the bandwidth by a quarter
+            if (round_start and not sample.application_limited) {
+                if (_bandwidth >= _full_bandwidth * 1.25) {
+                    _full_bandwidth = _bandwidth;
+                    _full_bandwidth_rounds = 0;
+                } else if (++_full_bandwidth_rounds >= 3) {
+                    _filled_pipe = true;
+                    _mode = Mode::Drain;
+                    _pacing_gain = 1 / HIGH_GAIN;
+                }
+            }
+            break;
+        case Mode::Drain:
+            if (sample.bytes_in_flight <= _bdp()) {
+                _enter_probe_bw(sample.now);
+            }
+            break;
+        case Mode::ProbeBW:
+            if (sample.now - _cycle_stamp > _min_rtt.value_or(0)) {
+                _cycle_index = (_cycle_index + 1) % PACING_GAINS.size();
+                _cycle_stamp = sample.now;
+                _pacing_gain = PACING_GAINS.at(_cycle_index);
+            }
+            break;
+        case Mode::ProbeRTT:
+            if (sample.now >= _probe_rtt_done) {
+                _min_rtt_stamp = sample.now;
+                if (_filled_pipe) {
+                    _enter_probe_bw(sample.now);
+                } else {
+                    _mode = Mode::Startup;
+                    _pacing_gain = _cwnd_gain = HIGH_GAIN;
+                }
+            }
+            break;
+    }
+
+    // drain the queue for a moment to see the propagation delay again
+    if (min_rtt_expired and _mode != Mode::ProbeRTT) {
+        _mode = Mode::ProbeRTT;
+        _pacing_gain = 1;
+        _probe_rtt_done = sample.now + PROBE_RTT_MS;
+    }
+
+    _update_pacing_rate();
+    _update_window(sample.bytes_acked, sample.delivered);
+}
+
+//! \details BBR does not take losses as a signal of congestion.
+void BBRController::on_loss(const uint64_t, const size_t) {}
+
+//! \details Until the next acknowledgment, only one segment may be in flight.
+void BBRController::on_rto(const uint64_t, const size_t) { _after_rto = true; }
+
+size_t BBRController::window() const {
+    if (_after_rto) {
+        return _mss;
+    }
+    if (_mode == Mode::ProbeRTT) {
+        return min(_cwnd, 4 * _mss);
+    }
+    return _cwnd;
+}
+
+std::optional<uint64_t> BBRController::pacing_rate() const {
+    if (_pacing_rate == 0) {
+        return {};
+    }
+    return static_cast<uint64_t>(_pacing_rate * 1000);
+}
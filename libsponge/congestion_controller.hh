@@ -0,0 +1,180 @@
+#ifndef SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
+#define SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+//! \brief Congestion control algorithms that a TCPSender can use
+enum class CongestionControl {
+    None,     //!< Send as much as the receiver's window allows
+    NewReno,  //!< Slow start and additive increase, halving on loss (RFC 5681, RFC 6582)
+    Cubic,    //!< Window growth that is a cubic function of the time since the last loss (RFC 9438)
+    BBR       //!< Paced at the measured bottleneck bandwidth, window bounded by the estimated BDP (BBRv1)
+};
+
+//! The algorithm called `name` ("none", "newreno", "cubic" or "bbr"); throws std::runtime_error if there is none
+CongestionControl congestion_control_from_name(const std::string &name);
+
+//! \brief What a TCPSender tells its CongestionController about an acknowledgment of new data
+struct AckSample {
+    uint64_t now;               //!< Time of the acknowledgment, in milliseconds
+    size_t bytes_acked;         //!< Sequence space newly acknowledged
+    size_t bytes_in_flight;     //!< Sequence space still outstanding once the acknowledgment is applied
+    std::optional<size_t> rtt;  //!< Round-trip time of a newly acknowledged segment never retransmitted, in ms
+    uint64_t delivered;         //!< Sequence space known to have reached the receiver over the whole connection
+    uint64_t prior_delivered;   //!< `delivered` when the newest acknowledged segment was sent
+    uint64_t interval;          //!< Milliseconds over which `delivered - prior_delivered` was delivered
+    bool application_limited;   //!< Whether the sender ran out of data to send since that segment was sent
+    bool in_recovery;           //!< Whether the sender was in fast recovery, repairing a loss, when this arrived
+};
+
+//! \brief Decides how much a TCPSender may have in flight, and how fast it may send it
+class CongestionController {
+  public:
+    //! Make a controller for segments of up to `mss` bytes, or nullptr for CongestionControl::None
+    static std::unique_ptr<CongestionController> make(const CongestionControl algorithm, const size_t mss);
+
+    //! New data was acknowledged
+    virtual void on_ack(const AckSample &sample) = 0;
+
+    //! \brief A loss was detected other than by a retransmission timeout (e.g. by duplicate acknowledgments)
+    //! \details The sender then stays in fast recovery until everything outstanding at the time of the loss
+    //! is acknowledged, and inflates the window by a segment for each further duplicate acknowledgment.
+    //! \param[in] bytes_in_flight is the sequence space outstanding when the loss was detected
+    virtual void on_loss(const uint64_t now, const size_t bytes_in_flight) = 0;
+
+    //! The retransmission timer expired with `bytes_in_flight` outstanding
+    virtual void on_rto(const uint64_t now, const size_t bytes_in_flight) = 0;
+
+    //! Fast recovery ended with `bytes_in_flight` outstanding, once everything outstanding at the loss was acknowledged
+    virtual void on_recovery_exit(const size_t bytes_in_flight) { static_cast<void>(bytes_in_flight); }
+
+    //! \brief Congestion window: how much sequence space may be outstanding, in bytes
+    virtual size_t window() const = 0;
+
+    //! \brief Rate at which to pace segments out, in bytes per second
+    //! \returns an empty optional if segments are sent as soon as the window allows
+    virtual std::optional<uint64_t> pacing_rate() const { return {}; }
+
+    virtual ~CongestionController() = default;
+};
+
+//! \brief NewReno: slow start, then one MSS more per window acknowledged; halve the window on loss
+class NewRenoController : public CongestionController {
+  protected:
+    size_t _mss;              //!< Maximum segment size
+    size_t _cwnd;             //!< Congestion window, in bytes
+    size_t _ssthresh;         //!< Slow-start threshold, in bytes
+    size_t _acked_in_ca = 0;  //!< Bytes acknowledged in congestion avoidance since the window last grew
+
+    //! Grow the window in slow start by the bytes acknowledged, up to `_ssthresh`; \returns the bytes left over
+    size_t _slow_start(const size_t bytes_acked);
+
+  public:
+    explicit NewRenoController(const size_t mss);
+
+    void on_ack(const AckSample &sample) override;
+    void on_loss(const uint64_t now, const size_t bytes_in_flight) override;
+    void on_rto(const uint64_t now, const size_t bytes_in_flight) override;
+    void on_recovery_exit(const size_t bytes_in_flight) override;
+    size_t window() const override { return _cwnd; }
+
+    //! Slow-start threshold, in bytes
+    size_t ssthresh() const { return _ssthresh; }
+};
+
+//! \brief CUBIC: after a loss, grow the window along a cubic curve that plateaus at the window of that loss
+class CubicController : public NewRenoController {
+    static constexpr double C = 0.4;     //!< Scaling constant of the cubic curve, in segments per second cubed
+    static constexpr double BETA = 0.7;  //!< Multiplicative decrease factor
+
+    double _w_max = 0;                 //!< Window when the last loss was detected, in segments
+    double _k = 0;                     //!< Seconds the curve takes to climb back to `_w_max`
+    std::optional<uint64_t> _epoch{};  //!< Time the current congestion-avoidance epoch began
+    double _w_est = 0;                 //!< Window that NewReno would have reached in this epoch, in segments
+    size_t _rtt = 0;                   //!< Latest round-trip time sample, in ms
+    double _growth = 0;                //!< Growth of the window not yet applied, less than a byte
+
+    //! Reduce the window after a loss with `bytes_in_flight` outstanding, and end the epoch
+    void _reduce(const size_t bytes_in_flight);
+
+  public:
+    explicit CubicController(const size_t mss) : NewRenoController(mss) {}
+
+    void on_ack(const AckSample &sample) override;
+    void on_loss(const uint64_t now, const size_t bytes_in_flight) override;
+    void on_rto(const uint64_t now, const size_t bytes_in_flight) override;
+};
+
+//! \brief BBR: model the path's bottleneck bandwidth and round-trip propagation time, and pace at the former
+class BBRController : public CongestionController {
+  public:
+    //! What the controller is probing for
+    enum class Mode { Startup, Drain, ProbeBW, ProbeRTT };
+
+  private:
+    static constexpr double HIGH_GAIN = 2.885;            //!< 2/ln(2): doubles the sending rate each round
+    static constexpr size_t BANDWIDTH_ROUNDS = 10;        //!< Rounds over which the bandwidth maximum is kept
+    static constexpr uint64_t MIN_RTT_EXPIRY_MS = 10000;  //!< Age at which the minimum RTT is probed again
+    static constexpr uint64_t PROBE_RTT_MS = 200;         //!< Time spent with a minimal window in ProbeRTT
+    static constexpr std::array<double, 8> PACING_GAINS = {1.25, 0.75, 1, 1, 1, 1, 1, 1};  //!< ProbeBW cycle
+
+    size_t _mss;   //!< Maximum segment size
+    size_t _cwnd;  //!< Congestion window, in bytes
+    Mode _mode = Mode::Startup;
+
+    //! Maximum delivery rate sampled in each of the last BANDWIDTH_ROUNDS rounds, in bytes per ms
+    std::array<double, BANDWIDTH_ROUNDS> _bandwidth_samples{};
+    double _bandwidth = 0;  //!< Bottleneck bandwidth estimate: the maximum of `_bandwidth_samples`
+
+    std::optional<size_t> _min_rtt{};  //!< Round-trip propagation time estimate, in ms
+    uint64_t _min_rtt_stamp = 0;       //!< Time `_min_rtt` was last lowered or confirmed
+
+    uint64_t _round = 0;                 //!< Rounds (of one RTT each) completed
+    uint64_t _next_round_delivered = 0;  //!< `delivered` once the current round's first segment is acknowledged
+
+    double _full_bandwidth = 0;         //!< Bandwidth at which Startup last saw growth
+    size_t _full_bandwidth_rounds = 0;  //!< Rounds of Startup without 25% bandwidth growth
+    bool _filled_pipe = false;          //!< Whether Startup has found the bottleneck bandwidth
+
+    size_t _cycle_index = 0;       //!< Phase of the ProbeBW gain cycle
+    uint64_t _cycle_stamp = 0;     //!< Time the current phase began
+    uint64_t _probe_rtt_done = 0;  //!< Time ProbeRTT ends
+    bool _after_rto = false;       //!< Whether the window is held at a minimum until the next acknowledgment
+
+    double _pacing_gain = HIGH_GAIN;
+    double _cwnd_gain = HIGH_GAIN;
+    double _pacing_rate = 0;  //!< Bytes per ms, or 0 before the first RTT sample
+
+    //! Set the pacing rate from the model; until the pipe is filled, it only rises
+    void _update_pacing_rate();
+
+    //! Move the window toward `_cwnd_gain` times the BDP, by at most `bytes_acked`, with `delivered` so far
+    void _update_window(const size_t bytes_acked, const uint64_t delivered);
+
+    //! Estimated bandwidth-delay product, in bytes
+    double _bdp() const;
+
+    void _enter_probe_bw(const uint64_t now);
+
+  public:
+    explicit BBRController(const size_t mss) : _mss(mss), _cwnd(10 * mss) {}
+
+    void on_ack(const AckSample &sample) override;
+    void on_loss(const uint64_t now, const size_t bytes_in_flight) override;
+    void on_rto(const uint64_t now, const size_t bytes_in_flight) override;
+    size_t window() const override;
+    std::optional<uint64_t> pacing_rate() const override;
+
+    //! What the controller is probing for
+    Mode mode() const { return _mode; }
+
+    //! Bottleneck bandwidth estimate, in bytes per second
+    uint64_t bandwidth() const { return static_cast<uint64_t>(_bandwidth * 1000); }
+};
+
+#endif  // SPONGE_LIBSPONGE_CONGESTION_CONTROLLER_HH
@@ -92,6 +92,17 @@ void NetworkInterface::tick(const size_t ms_since_last_tick) {
     }
 }
 
+optional<uint64_t> NetworkInterface::time_until_next_expiry() const {
+    optional<uint64_t> earliest{};
+    for (const auto &entry : _arp_table) {
+        const uint64_t until = entry.second.expire_time > _current_time ? entry.second.expire_time - _current_time : 0;
+        if (not earliest or until < earliest.value()) {
+            earliest = until;
+        }
+    }
+    return earliest;
+}
+
 void NetworkInterface::_send_ipv4_datagram(const InternetDatagram &dgram, const uint32_t ipaddr) {
     EthernetFrame frame;
 
@@ -94,6 +94,9 @@ class NetworkInterface {
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until the next ARP table entry expires (empty if the table is empty)
+    std::optional<uint64_t> time_until_next_expiry() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
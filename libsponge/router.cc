@@ -27,7 +27,7 @@ void Router::route_one_datagram(InternetDatagram &dgram) {
                 return;
             }
 
-            dgram.header().ttl -= 1;
+            dgram.header().decrement_ttl();
 
             Address next_hop =
                 _routing_table[i][prefix_to_match].next_hop.value_or(Address::from_ipv4_numeric(dgram.header().dst));
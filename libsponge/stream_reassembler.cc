@@ -1,5 +1,7 @@
 #include "stream_reassembler.hh"
 
+#include <iterator>
+
 // Implementation of a stream reassembler.
 
 using namespace std;
@@ -10,46 +12,68 @@ StreamReassembler::StreamReassembler(const size_t capacity) : _output(capacity),
 //! possibly out-of-order, from the logical stream, and assembles any newly
 //! contiguous substrings and writes them into the output stream in order.
 void StreamReassembler::push_substring(const string &data, const size_t index, const bool eof) {
+    push_substring(Buffer(string(data)), index, eof);
+}
+
+//! \details Stored segments are slices of `data` that share its storage, so out-of-order bytes
+//! are not copied until they are written to the output stream.
+void StreamReassembler::push_substring(const Buffer &data, const size_t index, const bool eof) {
     _has_eof |= eof;
 
     size_t unacceptable_index = _next_index + (_capacity - _output.buffer_size());
 
     // ignore empty or outputed segments
-    if (data.empty() || index + data.size() <= _next_index || index >= unacceptable_index) {
+    if (data.size() == 0 || index + data.size() <= _next_index || index >= unacceptable_index) {
         if (empty() && _has_eof) {
             _output.end_input();
         }
         return;
     }
 
+    // fast path: in-order data with no holes pending goes straight to the output stream
+    if (index == _next_index && empty()) {
+        _next_index += _output.write(data);
+        _in_order_pushes++;
+        if (_has_eof) {
+            _output.end_input();
+        }
+        return;
+    }
+
     // trim input to ensure index >= _next_index and it fits in the buffer
     size_t trimmed_index = max(index, _next_index);
     size_t trimmed_end = min(index + data.size(), unacceptable_index);
-    size_t trimmed_size = trimmed_end - trimmed_index;
-
-    // ensure no overlapping segments
-    for (auto iter = _unassembled_segments.begin(); iter != _unassembled_segments.end(); /* NOTHING */) {
-        auto segment_index = iter->first;
-        auto segment_end = segment_index + iter->second.size();
 
-        if (trimmed_index >= segment_index && trimmed_end <= segment_end) {  // ignore when data is subset of a segment
+    // stored segments never overlap, so only the one starting at or before trimmed_index can cover its start
+    auto following = _unassembled_segments.upper_bound(trimmed_index);
+    if (following != _unassembled_segments.begin()) {
+        const auto previous = std::prev(following);
+        size_t previous_end = previous->first + previous->second.size();
+        if (previous_end >= trimmed_end) {  // ignore when data is subset of a segment
             return;
-        } else if (trimmed_index <= segment_index && trimmed_end >= segment_end) {  // segment is subset of data, remove
-            _unassembled_bytes -= iter->second.size();
-            iter = _unassembled_segments.erase(iter);
-            continue;
-        } else if (trimmed_index < segment_index && trimmed_end > segment_index) {
-            trimmed_size = segment_index - trimmed_index;
-        } else if (trimmed_index < segment_end && trimmed_end > segment_end) {
-            trimmed_index = segment_end;
-            trimmed_size = trimmed_end - segment_end;
         }
-        iter++;
+        trimmed_index = max(trimmed_index, previous_end);
+    }
+
+    // remove the segments that data covers, and trim data against the first one that extends past it
+    while (following != _unassembled_segments.end() && following->first < trimmed_end) {
+        if (following->first + following->second.size() > trimmed_end) {
+            trimmed_end = following->first;
+            break;
+        }
+        _unassembled_bytes -= following->second.size();
+        following = _unassembled_segments.erase(following);
     }
 
     // insert the segment
-    _unassembled_bytes += trimmed_size;
-    _unassembled_segments[trimmed_index] = data.substr(trimmed_index - index, trimmed_size);
+    if (trimmed_index < trimmed_end) {
+        const size_t trimmed_size = trimmed_end - trimmed_index;
+        Buffer segment = data;
+        segment.remove_prefix(trimmed_index - index);
+        segment.remove_suffix(segment.size() - trimmed_size);
+        _unassembled_segments.emplace_hint(following, trimmed_index, move(segment));
+        _unassembled_bytes += trimmed_size;
+    }
 
     // try to output as much as it can
     for (auto iter = _unassembled_segments.begin(); iter != _unassembled_segments.end(); /* NOTHING */) {
@@ -73,4 +97,18 @@ size_t StreamReassembler::first_unassembled() const { return _next_index; }
 
 size_t StreamReassembler::unassembled_bytes() const { return _unassembled_bytes; }
 
+vector<pair<uint64_t, uint64_t>> StreamReassembler::unassembled_ranges() const {
+    vector<pair<uint64_t, uint64_t>> ranges;
+    for (const auto &[index, data] : _unassembled_segments) {
+        if (not ranges.empty() and ranges.back().second == index) {
+            ranges.back().second += data.size();
+        } else {
+            ranges.emplace_back(index, index + data.size());
+        }
+    }
+    return ranges;
+}
+
+size_t StreamReassembler::in_order_pushes() const { return _in_order_pushes; }
+
 bool StreamReassembler::empty() const { return _unassembled_segments.empty(); }
@@ -1,11 +1,14 @@
 #ifndef SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 #define SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 
 #include <cstdint>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 //! \brief A class that assembles a series of excerpts from a byte stream (possibly out of order,
 //! possibly overlapping) into an in-order byte stream.
@@ -13,9 +16,11 @@ class StreamReassembler {
   private:
     ByteStream _output;  //!< The reassembled in-order byte stream
     size_t _capacity;    //!< The maximum number of bytes
-    std::map<size_t, std::string> _unassembled_segments{};
+    //! Substrings waiting to be assembled, keyed by stream index; they never overlap
+    std::map<size_t, Buffer> _unassembled_segments{};
     size_t _unassembled_bytes = 0;
     size_t _next_index = 0;
+    size_t _in_order_pushes = 0;  //!< Number of substrings written straight to the output stream
     bool _has_eof = false;
 
   public:
@@ -36,6 +41,14 @@ class StreamReassembler {
     //! \param eof whether or not this segment ends with the end of the stream
     void push_substring(const std::string &data, const uint64_t index, const bool eof);
 
+    //! \brief Receives a substring held in a Buffer, keeping slices of it (rather than copies)
+    //! until its bytes can be written into the stream.
+    //!
+    //! \param data the Buffer being added
+    //! \param index the index of the first byte in `data`
+    //! \param eof whether or not this segment ends with the end of the stream
+    void push_substring(const Buffer &data, const uint64_t index, const bool eof);
+
     //! \name Access the reassembled byte stream
     //!@{
     const ByteStream &stream_out() const { return _output; }
@@ -51,6 +64,14 @@ class StreamReassembler {
     //! should only be counted once for the purpose of this function.
     size_t unassembled_bytes() const;
 
+    //! \brief The ranges of indices held but not yet reassembled, in order, with adjacent substrings merged
+    //! \returns pairs of the first index of each range and the index just past it
+    std::vector<std::pair<uint64_t, uint64_t>> unassembled_ranges() const;
+
+    //! The number of substrings that took the in-order fast path, i.e. started at
+    //! first_unassembled() while nothing else was waiting, and went straight to the stream
+    size_t in_order_pushes() const;
+
     //! \brief Is the internal state empty (other than the output stream)?
     //! \returns `true` if no substrings are waiting to be assembled
     bool empty() const;
@@ -1,5 +1,9 @@
 #include "tcp_connection.hh"
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
 // Implementation of a TCP connection
 
 using namespace std;
@@ -29,10 +33,17 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
     if (!_syn_received) {
         return;
     }
+    if (seg.header().syn) {
+        _sack_permitted = _cfg.sack && seg.header().sack_permitted;
+    }
 
     // ackno is meaningful only if SYN has been received
     if (seg.header().ack) {
-        bool ackno_valid = _sender.ack_received(seg.header().ackno, seg.header().win);
+        if (_sack_permitted) {
+            _sender.sack_received(seg.header());
+        }
+        bool ackno_valid =
+            _sender.ack_received(seg.header().ackno, seg.header().win, seg.length_in_sequence_space() > 0);
 
         if (!ackno_valid) {  // (3) TCPSender thinks the ackno is invalid
             _sender.send_empty_segment();
@@ -65,22 +76,59 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
 
 bool TCPConnection::active() const {
     bool unclean_shutdown = _rst_received || _rst_sent;
-    bool clean_shutdown = (unassembled_bytes() == 0) && _receiver.stream_out().eof() && _sender.stream_in().eof() &&
-                          (bytes_in_flight() == 0) &&
+    bool clean_shutdown = _streams_finished() &&
                           (!_linger_after_streams_finish || _time_since_last_received >= 10 * _cfg.rt_timeout);
 
     return !(unclean_shutdown || clean_shutdown);
 }
 
+bool TCPConnection::_streams_finished() const {
+    return (unassembled_bytes() == 0) && _receiver.stream_out().eof() && _sender.stream_in().eof() &&
+           (bytes_in_flight() == 0);
+}
+
+optional<size_t> TCPConnection::time_until_next_deadline() const {
+    if (!active()) {
+        return {};
+    }
+
+    optional<size_t> ret = _sender.time_until_retransmission();
+
+    // the moment pacing lets a held-back segment go
+    if (const auto until_paced_send = _sender.time_until_paced_send()) {
+        ret = min(ret.value_or(until_paced_send.value()), until_paced_send.value());
+    }
+
+    // the end of lingering, after which the connection becomes inactive
+    if (_linger_after_streams_finish && _streams_finished()) {
+        const size_t until_linger_ends = 10 * _cfg.rt_timeout - _time_since_last_received;
+        ret = min(ret.value_or(until_linger_ends), until_linger_ends);
+    }
+
+    return ret;
+}
+
 size_t TCPConnection::write(const string &data) {
     size_t bytes_written = _sender.stream_in().write(data);
 
-    _sender.fill_window();
-    _send_segments();
+    flush();
 
     return bytes_written;
 }
 
+size_t TCPConnection::write(Buffer data) {
+    size_t bytes_written = _sender.stream_in().write(move(data));
+
+    flush();
+
+    return bytes_written;
+}
+
+void TCPConnection::flush() {
+    _sender.fill_window();
+    _send_segments();
+}
+
 //! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
 void TCPConnection::tick(const size_t ms_since_last_tick) {
     _time_since_last_received += ms_since_last_tick;
@@ -126,7 +174,19 @@ void TCPConnection::_send_segments() {
             seg.header().ack = true;
             seg.header().ackno = _receiver.ackno().value();
         }
-        seg.header().win = _receiver.window_size();
+        // without window scaling, a larger window than the 16-bit field holds is advertised as its maximum
+        seg.header().win = min<size_t>(_receiver.window_size(), numeric_limits<uint16_t>::max());
+
+        // offer SACK in our SYN, or accept the peer's offer in our SYN-ACK; once both offered it,
+        // report what the receiver holds beyond the ackno, in as many blocks (of 8 bytes, after 4 for the
+        // option's kind, length and padding) as the payload leaves room for within MAX_PAYLOAD_SIZE
+        if (seg.header().syn) {
+            seg.header().sack_permitted = _cfg.sack && (!_syn_received || _sack_permitted);
+        } else if (_sack_permitted) {
+            const size_t room = TCPConfig::MAX_PAYLOAD_SIZE - min(seg.payload().size(), TCPConfig::MAX_PAYLOAD_SIZE);
+            _receiver.add_sack_blocks(seg.header(), room < 4 ? 0 : (room - 4) / 8);
+        }
+        seg.header().doff = (TCPHeader::LENGTH + seg.header().options_length()) / 4;
 
         _segments_out.push(seg);
         _sender.segments_out().pop();
@@ -11,7 +11,12 @@ class TCPConnection {
   private:
     TCPConfig _cfg;
     TCPReceiver _receiver{_cfg.recv_capacity};
-    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+    TCPSender _sender{_cfg.send_capacity,
+                      _cfg.rt_timeout,
+                      _cfg.fixed_isn,
+                      _cfg.send_storage,
+                      _cfg.congestion_control,
+                      _cfg.adaptive_rto};
 
     //! outbound queue of segments that the TCPConnection wants sent
     std::queue<TCPSegment> _segments_out{};
@@ -25,6 +30,8 @@ class TCPConnection {
 
     bool _syn_received = false;
     bool _syn_sent = false;
+    //! whether both ends offered selective acknowledgments in their SYNs
+    bool _sack_permitted = false;
     bool _rst_received = false;
     bool _rst_sent = false;
 
@@ -34,6 +41,9 @@ class TCPConnection {
     //! \brief Send RST segment
     void _send_rst();
 
+    //! \brief Have both streams ended, with everything reassembled and acknowledged?
+    bool _streams_finished() const;
+
   public:
     //! \name "Input" interface for the writer
     //!@{
@@ -45,6 +55,18 @@ class TCPConnection {
     //! \returns the number of bytes from `data` that were actually written.
     size_t write(const std::string &data);
 
+    //! \brief Write a Buffer to the outbound byte stream (without copying, if TCPConfig::send_storage
+    //! is ByteStream::Storage::Chunked), and send it over TCP if possible
+    //! \returns the number of bytes from `data` that were actually written.
+    size_t write(Buffer data);
+
+    //! \brief The outbound byte stream, for writers that fill it in place (see ByteStream::writable_span)
+    //! \note Call flush() after committing bytes to it so they are sent over TCP
+    ByteStream &outbound_stream() { return _sender.stream_in(); }
+
+    //! \brief Send any bytes that are waiting in the outbound byte stream, if the window allows
+    void flush();
+
     //! \returns the number of `bytes` that can be written right now.
     size_t remaining_outbound_capacity() const;
 
@@ -57,6 +79,7 @@ class TCPConnection {
 
     //! \brief The inbound byte stream received from the peer
     ByteStream &inbound_stream() { return _receiver.stream_out(); }
+    const ByteStream &inbound_stream() const { return _receiver.stream_out(); }
     //!@}
 
     //! \name Accessors used for testing
@@ -68,6 +91,10 @@ class TCPConnection {
     size_t unassembled_bytes() const;
     //! \brief Number of milliseconds since the last segment was received
     size_t time_since_last_segment_received() const;
+    //! \brief What the sender has measured of the round-trip time (empty until its first sample)
+    const std::optional<RTTEstimate> &rtt_estimate() const { return _sender.rtt_estimate(); }
+    //! \brief Number of losses the sender repaired by fast retransmission
+    uint64_t fast_retransmissions() const { return _sender.fast_retransmissions(); }
     //!< \brief summarize the state of the sender, receiver, and the connection
     TCPState state() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
     //!@}
@@ -87,6 +114,10 @@ class TCPConnection {
     //! but could also be user datagrams (UDP) or any other kind).
     std::queue<TCPSegment> &segments_out() { return _segments_out; }
 
+    //! \brief Milliseconds until tick() next has something to do: retransmit, send a paced segment, or stop lingering
+    //! \returns an empty optional if the connection is inactive or only waits for segments or data
+    std::optional<size_t> time_until_next_deadline() const;
+
     //! \brief Is the connection still alive in any way?
     //! \returns `true` if either stream is still running or if the TCPConnection is lingering
     //! after both streams have finished (e.g. to ACK retransmissions from the peer)
@@ -5,6 +5,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -17,8 +18,10 @@ ParseResult EthernetFrame::parse(const Buffer buffer) {
 }
 
 BufferList EthernetFrame::serialize() const {
-    BufferList ret;
-    ret.append(_header.serialize());
+    auto [header_out, header_data] = Buffer::allocate(EthernetHeader::LENGTH);
+    _header.serialize_into(reinterpret_cast<uint8_t *>(header_data));
+
+    BufferList ret{move(header_out)};
     ret.append(_payload);
     return ret;
 }
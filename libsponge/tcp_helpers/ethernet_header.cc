@@ -2,50 +2,49 @@
 
 #include "util.hh"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
 using namespace std;
 
 ParseResult EthernetHeader::parse(NetParser &p) {
-    if (p.buffer().size() < EthernetHeader::LENGTH) {
+    const uint8_t *h = p.take(EthernetHeader::LENGTH);
+    if (h == nullptr) {
         return ParseResult::PacketTooShort;
     }
 
     /* read destination address */
-    for (auto &byte : dst) {
-        byte = p.u8();
-    }
+    memcpy(dst.data(), h, dst.size());
 
     /* read source address */
-    for (auto &byte : src) {
-        byte = p.u8();
-    }
+    memcpy(src.data(), h + dst.size(), src.size());
 
     /* read the frame's type (e.g. IPv4, ARP, or something else) */
-    type = p.u16();
+    type = NetParser::u16(h + dst.size() + src.size());
 
     return p.get_error();
 }
 
 string EthernetHeader::serialize() const {
-    string ret;
-    ret.reserve(LENGTH);
+    string ret(LENGTH, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
 
+uint8_t *EthernetHeader::serialize_into(uint8_t *out) const {
     /* write destination address */
     for (auto &byte : dst) {
-        NetUnparser::u8(ret, byte);
+        out = NetUnparser::u8(out, byte);
     }
 
     /* write source address */
     for (auto &byte : src) {
-        NetUnparser::u8(ret, byte);
+        out = NetUnparser::u8(out, byte);
     }
 
     /* write the frame's type (e.g. IPv4, ARP or something else) */
-    NetUnparser::u16(ret, type);
-
-    return ret;
+    return NetUnparser::u16(out, type);
 }
 
 //! \returns A string with a textual representation of an Ethernet address
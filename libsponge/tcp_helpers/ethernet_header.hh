@@ -33,6 +33,10 @@ struct EthernetHeader {
     //! Serialize the Ethernet fields to a string
     std::string serialize() const;
 
+    //! \brief Serialize the Ethernet fields into `out`, which must have room for LENGTH bytes
+    //! \returns the position just past the header
+    uint8_t *serialize_into(uint8_t *out) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 };
@@ -1,11 +1,36 @@
 #include "fd_adapter.hh"
 
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
 #include <iostream>
+#include <netinet/in.h>
 #include <stdexcept>
 #include <utility>
 
 using namespace std;
 
+//! \param[in] sock is the socket to carry the segments
+//! \param[in] offload is whether to try to enable UDP GSO and GRO
+TCPOverUDPSocketAdapter::TCPOverUDPSocketAdapter(UDPSocket &&sock, const bool offload)
+    : _sock(move(sock)), _recv_slots(BATCH_SIZE), _recv_buffers(BATCH_SIZE) {
+    if (not offload) {
+        return;
+    }
+
+    // kernels before Linux 4.18 (GSO) and 5.0 (GRO) reject the options; go without them there
+    try {
+        _sock.set_gso_size(0);
+        _gso = true;
+    } catch (const unix_error &) {
+    }
+    try {
+        _sock.set_gro();
+        _gro = true;
+    } catch (const unix_error &) {
+    }
+}
+
 //! \details This function first attempts to parse a TCP segment from the next UDP
 //! payload recv()d from the socket.
 //!
@@ -19,23 +44,30 @@ using namespace std;
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    Buffer payload;
+    const auto *datagram = _next_datagram(payload);
+    if (not datagram) {
+        return {};
+    }
 
     // is it for us?
-    if (not listening() and (datagram.source_address != config().destination)) {
+    const auto &source = reinterpret_cast<const sockaddr_in &>(datagram->source_address.storage);
+    const TCPFlow &expected = config().flow();
+    if (not listening() and (source.sin_family != AF_INET or ntohl(source.sin_addr.s_addr) != expected.remote_address or
+                             ntohs(source.sin_port) != expected.remote_port)) {
         return {};
     }
 
     // is the payload a valid TCP segment?
     TCPSegment seg;
-    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+    if (ParseResult::NoError != seg.parse(move(payload), 0)) {
         return {};
     }
 
     // should we target this source in all future replies?
     if (listening()) {
         if (seg.header().syn and not seg.header().rst) {
-            config_mutable().destination = datagram.source_address;
+            config_mutable().set_destination({datagram->source_address, datagram->source_address_len});
             set_listening(false);
         } else {
             return {};
@@ -48,9 +80,167 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
 //! Serialize a TCP segment and send it as the payload of a UDP datagram.
 //! \param[in] seg is the TCP segment to write
 void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
-    seg.header().sport = config().source.port();
-    seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
+    seg.header().sport = config().flow().local_port;
+    seg.header().dport = config().flow().remote_port;
+    _queue(config().destination(), seg);
+}
+
+//! \details Unlike read(), this does not filter by the adapter's configuration: the segment is
+//! returned whichever peer sent it, for the caller to demultiplex by `flow`.
+//! \param[out] flow is set to the flow of the segment; the remote end is the UDP sender
+//! \returns a std::optional<TCPSegment> that is empty if the payload was not a valid TCP segment
+optional<TCPSegment> TCPOverUDPSocketAdapter::read(TCPFlow &flow) {
+    Buffer payload;
+    const auto *datagram = _next_datagram(payload);
+    if (not datagram or datagram->source_address.storage.ss_family != AF_INET) {
+        return {};
+    }
+
+    TCPSegment seg;
+    if (ParseResult::NoError != seg.parse(move(payload), 0)) {
+        return {};
+    }
+
+    // read the sender straight from the sockaddr, without building an Address
+    const auto &source = reinterpret_cast<const sockaddr_in &>(datagram->source_address.storage);
+    flow.local_address = 0;
+    flow.remote_address = ntohl(source.sin_addr.s_addr);
+    flow.local_port = seg.header().dport;
+    flow.remote_port = ntohs(source.sin_port);
+    return seg;
+}
+
+//! \param[in] seg is the TCP segment to write
+//! \param[in] flow is the flow the segment belongs to
+void TCPOverUDPSocketAdapter::write(TCPSegment &seg, const TCPFlow &flow) {
+    seg.header().sport = flow.local_port;
+    seg.header().dport = flow.remote_port;
+    _queue(flow.remote(), seg);
+}
+
+//! \details The payload shares the slot's pooled storage, which the slot gives up; it gets new
+//! storage before the next batch is received. A slot of datagrams coalesced by GRO is cut back
+//! into its datagrams, all of which share its storage.
+//! \param[out] payload is set to the datagram's payload
+const UDPSocket::batch_slot *TCPOverUDPSocketAdapter::_next_datagram(Buffer &payload) {
+    if (_recv_rest.size() == 0) {
+        if (_recv_next == _recv_count) {
+            const size_t slot_size = _gro ? GRO_RECV_SIZE : RECV_MTU;
+            for (size_t i = 0; i < BATCH_SIZE; i++) {
+                if (not _recv_slots[i].buffer) {
+                    auto [storage, data] = Buffer::allocate(slot_size);
+                    _recv_buffers[i] = move(storage);
+                    _recv_slots[i].buffer = data;
+                    _recv_slots[i].capacity = slot_size;
+                }
+            }
+            _recv_count = _sock.recv_batch(_recv_slots.data(), BATCH_SIZE);
+            _recv_next = 0;
+            if (_recv_count == 0) {
+                // a non-blocking socket with nothing waiting
+                return nullptr;
+            }
+        }
+
+        const size_t index = _recv_next++;
+        UDPSocket::batch_slot &slot = _recv_slots[index];
+        if (slot.length > slot.capacity) {
+            // truncated: drop it, and keep the storage for the next batch
+            return nullptr;
+        }
+
+        _recv_rest = move(_recv_buffers[index]);
+        _recv_rest.remove_suffix(slot.capacity - slot.length);
+        _recv_segment_size = slot.segment_size ? slot.segment_size : slot.length;
+        _recv_slot = index;
+        slot.buffer = nullptr;
+    }
+
+    const size_t length = min(_recv_segment_size, _recv_rest.size());
+    payload = _recv_rest;
+    payload.remove_suffix(payload.size() - length);
+    _recv_rest.remove_prefix(length);
+    return &_recv_slots[_recv_slot];
+}
+
+size_t TCPOverUDPSocketAdapter::pending_reads() const {
+    const size_t coalesced = _recv_rest.size() ? (_recv_rest.size() + _recv_segment_size - 1) / _recv_segment_size : 0;
+    return _recv_count - _recv_next + coalesced;
+}
+
+//! \param[in] destination is the address to send the datagram to
+//! \param[in] seg is the TCP segment to carry
+void TCPOverUDPSocketAdapter::_queue(const Address &destination, const TCPSegment &seg) {
+    _send_queue.push_back({destination, seg.serialize(0)});
+    if (_send_queue.size() >= (_gso ? MAX_GSO_SEGMENTS : BATCH_SIZE)) {
+        flush();
+    }
+}
+
+//! \details A run of datagrams to one destination is coalesced while all but the last are as long
+//! as the first, and the last is no longer, which is how the kernel cuts the payload back apart.
+void TCPOverUDPSocketAdapter::_send_coalesced() {
+    _coalesced.clear();
+    _coalesced_counts.clear();
+    for (size_t i = _send_done; i < _send_queue.size(); i++) {
+        const auto &datagram = _send_queue[i];
+        if (not _coalesced.empty()) {
+            auto &run = _coalesced.back();
+            size_t &count = _coalesced_counts.back();
+            if (run.payload.size() == count * run.segment_size and datagram.payload.size() <= run.segment_size and
+                count < MAX_GSO_SEGMENTS and run.payload.size() + datagram.payload.size() <= MAX_GSO_PAYLOAD and
+                run.destination == datagram.destination) {
+                run.payload.append(datagram.payload);
+                count++;
+                continue;
+            }
+        }
+        _coalesced.push_back({datagram.destination, datagram.payload, datagram.payload.size()});
+        _coalesced_counts.push_back(1);
+    }
+
+    size_t sent = 0;
+    while (sent < _coalesced.size()) {
+        const size_t batch = _sock.sendto_batch(_coalesced.data() + sent, _coalesced.size() - sent);
+        if (batch == 0) {
+            // a non-blocking socket's buffer is full: drop the rest, as a full queue on the path would
+            _send_done = _send_queue.size();
+            return;
+        }
+        for (size_t i = sent; i < sent + batch; i++) {
+            _send_done += _coalesced_counts[i];
+        }
+        sent += batch;
+    }
+}
+
+void TCPOverUDPSocketAdapter::flush() {
+    try {
+        if (_gso) {
+            try {
+                _send_coalesced();
+            } catch (const unix_error &e) {
+                // the route cannot take GSO (e.g. its device lacks checksum offload): stop using it
+                if (e.code().value() != EIO and e.code().value() != EINVAL) {
+                    throw;
+                }
+                _gso = false;
+            }
+        }
+        while (_send_done < _send_queue.size()) {
+            const size_t batch = _sock.sendto_batch(_send_queue.data() + _send_done, _send_queue.size() - _send_done);
+            if (batch == 0) {
+                break;  // a non-blocking socket's buffer is full: drop the rest, as in _send_coalesced()
+            }
+            _send_done += batch;
+        }
+    } catch (...) {
+        _send_queue.clear();
+        _send_done = 0;
+        throw;
+    }
+    _send_queue.clear();
+    _send_done = 0;
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
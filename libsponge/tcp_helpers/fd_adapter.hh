@@ -5,11 +5,14 @@
 #include "lossy_fd_adapter.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
+#include "tcp_flow.hh"
 #include "tcp_header.hh"
 #include "tcp_segment.hh"
 
+#include <cstddef>
 #include <optional>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
@@ -40,23 +43,104 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! Milliseconds until tick() next has work to do (empty if it never does)
+    std::optional<uint64_t> time_until_next_tick() const { return {}; }
+
+    //! Number of segments already received that read() returns without touching the fd
+    size_t pending_reads() const { return 0; }
+
+    //! Send the segments that write() queued (adapters that write immediately queue none)
+    void flush() {}
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
+//! \details Datagrams are received and sent in batches, a system call each: read() receives as
+//! many as are waiting (up to BATCH_SIZE) and returns them one at a time (see pending_reads()),
+//! and write() queues each datagram until flush() is called or the queue is full.
+//!
+//! Where the kernel supports it, the adapter also offloads segmentation to it. flush() coalesces
+//! runs of equal-length datagrams to one destination into one payload that the kernel cuts back
+//! into datagrams (UDP GSO), and the kernel may hand read() such runs as one payload (UDP GRO),
+//! which read() cuts back into segments.
 class TCPOverUDPSocketAdapter : public FdAdapterBase {
+  public:
+    //! Most datagrams received, or sent, by one system call
+    static constexpr size_t BATCH_SIZE = 32;
+
+    //! Longest datagram received without GRO; a longer one is dropped, as by a link with this MTU
+    static constexpr size_t RECV_MTU = BufferPool::BLOCK_SIZES[0];
+
+    //! Longest payload received with GRO (datagrams coalesced by the kernel fill at most one IPv4 datagram)
+    static constexpr size_t GRO_RECV_SIZE = BufferPool::BLOCK_SIZES[1];
+
+    //! Most datagrams that GSO cuts one payload into (the kernel's UDP_MAX_SEGMENTS)
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;
+
+    //! Longest payload sent with GSO: the largest UDP payload of an IPv4 datagram
+    static constexpr size_t MAX_GSO_PAYLOAD = 65507;
+
   private:
     UDPSocket _sock;
 
+    bool _gso = false;  //!< Does flush() coalesce datagrams for the kernel to cut apart (UDP_SEGMENT)?
+    bool _gro = false;  //!< May the kernel coalesce the datagrams that read() receives (UDP_GRO)?
+
+    std::vector<UDPSocket::batch_slot> _recv_slots;  //!< Where each datagram of a batch is received
+    std::vector<Buffer> _recv_buffers;               //!< Pooled storage behind each of `_recv_slots`
+    size_t _recv_next = 0;                           //!< Next slot of the batch for read() to take
+    size_t _recv_count = 0;                          //!< Number of slots filled by the batch
+
+    size_t _recv_slot = 0;          //!< Slot of the datagrams in `_recv_rest`
+    Buffer _recv_rest{};            //!< Datagrams of a coalesced slot not yet returned
+    size_t _recv_segment_size = 0;  //!< Length of each of those but the last
+
+    std::vector<UDPSocket::outgoing_datagram> _send_queue{};  //!< Datagrams written but not yet sent
+    size_t _send_done = 0;                                    //!< Datagrams of `_send_queue` sent so far
+
+    std::vector<UDPSocket::outgoing_datagram> _coalesced{};  //!< `_send_queue`, coalesced for GSO
+    std::vector<size_t> _coalesced_counts{};                 //!< Number of datagrams in each of `_coalesced`
+
+    //! \brief Take the next received datagram, receiving a batch first if none is left
+    //! \returns the datagram's slot (for its sender), or nullptr if it was truncated or none was waiting
+    const UDPSocket::batch_slot *_next_datagram(Buffer &payload);
+
+    //! Queue a datagram carrying `seg` to `destination`, sending the queue once it is full
+    void _queue(const Address &destination, const TCPSegment &seg);
+
+    //! Send the unsent datagrams of `_send_queue`, coalescing runs of them with GSO
+    void _send_coalesced();
+
   public:
-    //! Construct from a UDPSocket sliced into a FileDescriptor
-    explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
+    //! \brief Construct from a UDPSocket sliced into a FileDescriptor
+    //! \details With `offload`, GSO and GRO are used if the kernel supports them.
+    explicit TCPOverUDPSocketAdapter(UDPSocket &&sock, const bool offload = true);
 
     //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
     std::optional<TCPSegment> read();
 
-    //! Writes a TCP segment into a UDP payload
+    //! Writes a TCP segment into a UDP payload (sent by the next flush())
     void write(TCPSegment &seg);
 
+    //! Reads a TCP segment from a UDP payload sent by any peer, and the flow it belongs to
+    std::optional<TCPSegment> read(TCPFlow &flow);
+
+    //! Writes a TCP segment of `flow` into a UDP payload sent to the flow's remote end (by the next flush())
+    void write(TCPSegment &seg, const TCPFlow &flow);
+
+    //! Number of datagrams of the last batch that read() has yet to return
+    size_t pending_reads() const;
+
+    //! \brief Send every queued datagram, in as few system calls as possible
+    //! \details If the socket is non-blocking and its buffer fills, the datagrams left are dropped.
+    void flush();
+
+    //! Does the adapter coalesce the datagrams it sends with UDP GSO?
+    bool gso() const { return _gso; }
+
+    //! Does the adapter accept datagrams coalesced by UDP GRO?
+    bool gro() const { return _gro; }
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
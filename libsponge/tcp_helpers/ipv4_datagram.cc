@@ -5,6 +5,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -25,17 +26,12 @@ BufferList IPv4Datagram::serialize() const {
         throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
     }
 
-    IPv4Header header_out = _header;
-    header_out.cksum = 0;
-    const string header_zero_checksum = header_out.serialize();
+    // a parsed header that was only patched already carries the right checksum;
+    // otherwise calculate it -- taken over header only
+    auto [header_out, header_data] = Buffer::allocate(4 * _header.hlen);
+    _header.serialize_into_with_cksum(reinterpret_cast<uint8_t *>(header_data));
 
-    // calculate checksum -- taken over header only
-    InternetChecksum check;
-    check.add(header_zero_checksum);
-    header_out.cksum = check.value();
-
-    BufferList ret;
-    ret.append(header_out.serialize());
+    BufferList ret{move(header_out)};
     ret.append(_payload);
     return ret;
 }
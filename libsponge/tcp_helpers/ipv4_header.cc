@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <arpa/inet.h>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -22,29 +23,31 @@ using namespace std;
 //! - the checksum is bad
 ParseResult IPv4Header::parse(NetParser &p) {
     Buffer original_serialized_version = p.buffer();
+    _cksum_valid = false;
 
     const size_t data_size = p.buffer().size();
-    if (data_size < IPv4Header::LENGTH) {
+    const uint8_t *h = p.take(IPv4Header::LENGTH);  // the fixed fields are bounds-checked once
+    if (h == nullptr) {
         return ParseResult::PacketTooShort;
     }
 
-    const uint8_t first_byte = p.u8();
-    ver = first_byte >> 4;     // version
-    hlen = first_byte & 0x0f;  // header length
-    tos = p.u8();              // type of service
-    len = p.u16();             // length
-    id = p.u16();              // id
+    const uint8_t first_byte = NetParser::u8(h);
+    ver = first_byte >> 4;        // version
+    hlen = first_byte & 0x0f;     // header length
+    tos = NetParser::u8(h + 1);   // type of service
+    len = NetParser::u16(h + 2);  // length
+    id = NetParser::u16(h + 4);   // id
 
-    const uint16_t fo_val = p.u16();
+    const uint16_t fo_val = NetParser::u16(h + 6);
     df = static_cast<bool>(fo_val & 0x4000);  // don't fragment
     mf = static_cast<bool>(fo_val & 0x2000);  // more fragments
     offset = fo_val & 0x1fff;                 // offset
 
-    ttl = p.u8();     // ttl
-    proto = p.u8();   // proto
-    cksum = p.u16();  // checksum
-    src = p.u32();    // source address
-    dst = p.u32();    // destination address
+    ttl = NetParser::u8(h + 8);                // ttl
+    proto = NetParser::u8(h + 9);              // proto
+    cksum = NetParser::u16(h + CKSUM_OFFSET);  // checksum
+    src = NetParser::u32(h + 12);              // source address
+    dst = NetParser::u32(h + 16);              // destination address
 
     if (data_size < 4 * hlen) {
         return ParseResult::PacketTooShort;
@@ -71,9 +74,26 @@ ParseResult IPv4Header::parse(NetParser &p) {
         return ParseResult::BadChecksum;
     }
 
+    // options are not kept, so only a header without them can be serialized again as parsed
+    if (hlen == LENGTH / 4) {
+        memcpy(_cksum_covers.data(), h, LENGTH);
+        _cksum_valid = true;
+    }
     return ParseResult::NoError;
 }
 
+//! \details TTL and protocol share one 16-bit word of the header, so a valid checksum can be patched
+//! with InternetChecksum::patch instead of being recomputed when the datagram is serialized.
+void IPv4Header::decrement_ttl() {
+    const uint16_t old_word = (ttl << 8) | proto;
+    ttl -= 1;
+    if (_cksum_valid) {
+        cksum = InternetChecksum::patch(cksum, old_word, (ttl << 8) | proto);
+        NetUnparser::u8(&_cksum_covers[8], ttl);
+        NetUnparser::u16(&_cksum_covers[CKSUM_OFFSET], cksum);
+    }
+}
+
 //! Serialize the IPv4Header to a string (does not recompute the checksum)
 string IPv4Header::serialize() const {
     // sanity checks
@@ -84,29 +104,58 @@ string IPv4Header::serialize() const {
         throw runtime_error("IP header too short");
     }
 
-    string ret;
-    ret.reserve(4 * hlen);
+    string ret(4 * hlen, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
+
+//! \param[out] out receives the header (does not recompute the checksum); options are zero-filled
+uint8_t *IPv4Header::serialize_into(uint8_t *out) const {
+    // sanity checks
+    if (ver != 4) {
+        throw runtime_error("wrong IP version");
+    }
+    if (4 * hlen < IPv4Header::LENGTH) {
+        throw runtime_error("IP header too short");
+    }
 
+    uint8_t *p = out;
     const uint8_t first_byte = (ver << 4) | (hlen & 0xf);
-    NetUnparser::u8(ret, first_byte);  // version and header length
-    NetUnparser::u8(ret, tos);         // type of service
-    NetUnparser::u16(ret, len);        // length
-    NetUnparser::u16(ret, id);         // id
+    p = NetUnparser::u8(p, first_byte);  // version and header length
+    p = NetUnparser::u8(p, tos);         // type of service
+    p = NetUnparser::u16(p, len);        // length
+    p = NetUnparser::u16(p, id);         // id
 
     const uint16_t fo_val = (df ? 0x4000 : 0) | (mf ? 0x2000 : 0) | (offset & 0x1fff);
-    NetUnparser::u16(ret, fo_val);  // flags and offset
+    p = NetUnparser::u16(p, fo_val);  // flags and offset
 
-    NetUnparser::u8(ret, ttl);    // time to live
-    NetUnparser::u8(ret, proto);  // protocol number
+    p = NetUnparser::u8(p, ttl);    // time to live
+    p = NetUnparser::u8(p, proto);  // protocol number
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    p = NetUnparser::u16(p, cksum);  // checksum
 
-    NetUnparser::u32(ret, src);  // src address
-    NetUnparser::u32(ret, dst);  // dst address
+    p = NetUnparser::u32(p, src);  // src address
+    p = NetUnparser::u32(p, dst);  // dst address
 
-    ret.resize(4 * hlen);  // expand header to advertised size
+    memset(p, 0, 4 * hlen - LENGTH);  // expand header to advertised size
 
-    return ret;
+    return out + 4 * hlen;
+}
+
+//! \details The fields are public, so any of them may have been assigned since parse(): `cksum` is only
+//! reused if the header written is byte for byte the one it was computed over.
+//! \param[out] out receives the header, with a valid checksum
+uint8_t *IPv4Header::serialize_into_with_cksum(uint8_t *out) const {
+    uint8_t *end = serialize_into(out);
+    if (_cksum_valid and memcmp(out, _cksum_covers.data(), LENGTH) == 0) {
+        return end;
+    }
+    NetUnparser::u16(out + CKSUM_OFFSET, 0);
+
+    InternetChecksum check;
+    check.add({reinterpret_cast<const char *>(out), size_t(end - out)});
+    NetUnparser::u16(out + CKSUM_OFFSET, check.value());
+    return end;
 }
 
 uint16_t IPv4Header::payload_length() const { return len - 4 * hlen; }
@@ -3,12 +3,15 @@
 
 #include "parser.hh"
 
+#include <array>
+
 //! \brief [IPv4](\ref rfc::rfc791) Internet datagram header
 //! \note IP options are not supported
 struct IPv4Header {
     static constexpr size_t LENGTH = 20;         //!< [IPv4](\ref rfc::rfc791) header length, not including options
     static constexpr uint8_t DEFAULT_TTL = 128;  //!< A reasonable default TTL value
     static constexpr uint8_t PROTO_TCP = 6;      //!< Protocol number for [tcp](\ref rfc::rfc793)
+    static constexpr size_t CKSUM_OFFSET = 10;   //!< Offset of the checksum field within the header
 
     //! \struct IPv4Header
     //! ~~~{.txt}
@@ -46,12 +49,24 @@ struct IPv4Header {
     uint32_t dst = 0;           //!< dst address
     //!@}
 
+    //! Decrement the TTL, patching `cksum` incrementally if it is the checksum of the header as parsed
+    void decrement_ttl();
+
     //! Parse the IP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
     //! Serialize the IP fields
     std::string serialize() const;
 
+    //! \brief Serialize the IP fields into `dst`, which must have room for `4 * hlen` bytes
+    //! \returns the position just past the header
+    uint8_t *serialize_into(uint8_t *dst) const;
+
+    //! \brief Serialize the IP fields into `dst` with a valid checksum: `cksum` if it is still the checksum
+    //! of the header as parsed (and patched by decrement_ttl()), otherwise a freshly computed one
+    //! \returns the position just past the header
+    uint8_t *serialize_into_with_cksum(uint8_t *dst) const;
+
     //! Length of the payload
     uint16_t payload_length() const;
 
@@ -63,6 +78,12 @@ struct IPv4Header {
 
     //! Return a string containing a human-readable summary of the header
     std::string summary() const;
+
+  private:
+    //! The header as parsed, with `cksum` patched by decrement_ttl(); while the fields still serialize
+    //! to these bytes, `cksum` is their checksum and need not be computed again
+    std::array<uint8_t, LENGTH> _cksum_covers{};
+    bool _cksum_valid = false;  //!< Does `_cksum_covers` hold a whole header (without options) with a valid checksum?
 };
 
 //! \struct IPv4Header
@@ -3,6 +3,7 @@
 
 #include "file_descriptor.hh"
 #include "tcp_config.hh"
+#include "tcp_flow.hh"
 #include "tcp_segment.hh"
 #include "util.hh"
 
@@ -56,6 +57,24 @@ class LossyFdAdapter {
         return _adapter.write(seg);
     }
 
+    //! \brief Read a segment of any flow from the underlying AdapterT instance, potentially dropping it
+    //! \param[out] flow is set to the flow of the segment
+    std::optional<TCPSegment> read(TCPFlow &flow) {
+        auto ret = _adapter.read(flow);
+        if (_should_drop(false)) {
+            return {};
+        }
+        return ret;
+    }
+
+    //! \brief Write a segment of `flow` to the underlying AdapterT instance, potentially dropping it
+    void write(TCPSegment &seg, const TCPFlow &flow) {
+        if (_should_drop(true)) {
+            return;
+        }
+        return _adapter.write(seg, flow);
+    }
+
     //! \name
     //! Passthrough functions to the underlying AdapterT instance
 
@@ -66,6 +85,11 @@ class LossyFdAdapter {
     void tick(const size_t ms_since_last_tick) {
         _adapter.tick(ms_since_last_tick);
     }  //!< FdAdapterBase::tick passthrough
+    std::optional<uint64_t> time_until_next_tick() const {
+        return _adapter.time_until_next_tick();
+    }  //!< FdAdapterBase::time_until_next_tick passthrough
+    size_t pending_reads() const { return _adapter.pending_reads(); }  //!< FdAdapterBase::pending_reads passthrough
+    void flush() { _adapter.flush(); }                                 //!< FdAdapterBase::flush passthrough
     //!@}
 };
 
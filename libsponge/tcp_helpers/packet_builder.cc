@@ -0,0 +1,33 @@
+#include "packet_builder.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] eth_header is the Ethernet header to prepend, or `nullptr` for a bare IPv4 datagram
+//! \param[in] ip_header is the IPv4 header
+//! \param[in] seg is the TCP segment; its payload is not copied
+array<string_view, 2> PacketBuilder::_build(const EthernetHeader *eth_header,
+                                            const IPv4Header &ip_header,
+                                            const TCPSegment &seg) {
+    const size_t tcp_header_length = 4 * seg.header().doff;
+    if (4 * ip_header.hlen != IPv4Header::LENGTH) {
+        throw runtime_error("PacketBuilder: IPv4 options are not supported");
+    }
+    if (ip_header.payload_length() != tcp_header_length + seg.payload().size()) {
+        throw runtime_error("PacketBuilder: IPv4 length does not match the TCP segment");
+    }
+
+    uint8_t *const end = _headroom.data() + HEADROOM;
+    uint8_t *const tcp_start = end - tcp_header_length;
+    uint8_t *start = tcp_start - IPv4Header::LENGTH;
+
+    ip_header.serialize_into_with_cksum(start);
+    seg.serialize_header_into(tcp_start, ip_header.pseudo_cksum());
+    if (eth_header) {
+        start -= EthernetHeader::LENGTH;
+        eth_header->serialize_into(start);
+    }
+
+    return {string_view{reinterpret_cast<const char *>(start), size_t(end - start)}, seg.payload().str()};
+}
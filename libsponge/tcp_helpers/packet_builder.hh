@@ -0,0 +1,46 @@
+#ifndef SPONGE_LIBSPONGE_PACKET_BUILDER_HH
+#define SPONGE_LIBSPONGE_PACKET_BUILDER_HH
+
+#include "ethernet_header.hh"
+#include "ipv4_header.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+//! \brief Serializes outgoing TCP segments, and the headers that encapsulate them, without allocating
+//! \details The Ethernet, IPv4 and TCP headers are written back-to-back into one reusable headroom
+//! area, ending where the payload begins. The packet is returned as two views (headers and
+//! payload) that can be handed straight to FileDescriptor::write.
+class PacketBuilder {
+  public:
+    //! Room for the Ethernet, IPv4 and TCP headers (TCP options are supported, IPv4 options are not)
+    static constexpr size_t HEADROOM = EthernetHeader::LENGTH + IPv4Header::LENGTH + TCPHeader::MAX_LENGTH;
+
+  private:
+    std::array<uint8_t, HEADROOM> _headroom{};
+
+    std::array<std::string_view, 2> _build(const EthernetHeader *eth_header,
+                                           const IPv4Header &ip_header,
+                                           const TCPSegment &seg);
+
+  public:
+    //! \brief Serialize an IPv4 datagram carrying `seg`, computing both checksums
+    //! \note `ip_header.len` must already account for the segment; `ip_header.cksum` is ignored
+    //! \returns views of the headers and the payload, valid until the next call or until `seg` changes
+    std::array<std::string_view, 2> tcp_in_ipv4(const IPv4Header &ip_header, const TCPSegment &seg) {
+        return _build(nullptr, ip_header, seg);
+    }
+
+    //! \brief Serialize an Ethernet frame carrying an IPv4 datagram carrying `seg`
+    //! \returns views of the headers and the payload, valid until the next call or until `seg` changes
+    std::array<std::string_view, 2> tcp_in_ipv4_in_ethernet(const EthernetHeader &eth_header,
+                                                            const IPv4Header &ip_header,
+                                                            const TCPSegment &seg) {
+        return _build(&eth_header, ip_header, seg);
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_PACKET_BUILDER_HH
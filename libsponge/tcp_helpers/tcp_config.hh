@@ -2,12 +2,22 @@
 #define SPONGE_LIBSPONGE_TCP_CONFIG_HH
 
 #include "address.hh"
+#include "byte_stream.hh"
+#include "congestion_controller.hh"
+#include "tcp_flow.hh"
 #include "wrapping_integers.hh"
 
 #include <cstddef>
 #include <cstdint>
 #include <optional>
 
+//! \brief Bounds of a retransmission timeout computed from RTT samples (RFC 6298)
+//! \details RFC 6298 puts the floor at 1 s; 200 ms (as in Linux) suits paths with short round trips.
+struct RTOBounds {
+    uint16_t min = 200;    //!< Floor, in milliseconds
+    uint16_t max = 60000;  //!< Ceiling, in milliseconds
+};
+
 //! Config for TCP sender and receiver
 class TCPConfig {
   public:
@@ -19,17 +29,53 @@ class TCPConfig {
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
     size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
+    //! Storage of the outbound stream; ByteStream::Storage::Chunked sends written Buffers without copying
+    ByteStream::Storage send_storage = ByteStream::Storage::Ring;
+    //! Congestion control of the sender; CongestionControl::None sends as much as the receiver's window allows
+    CongestionControl congestion_control = CongestionControl::None;
+    //! If set, the retransmission timeout follows RTT samples within these bounds, with `rt_timeout` only
+    //! the initial value; otherwise it returns to `rt_timeout` on every acknowledgment of new data
+    std::optional<RTOBounds> adaptive_rto{};
+    //! Whether to offer selective acknowledgments (RFC 2018); they are used if the peer offers them too
+    bool sack = false;
     std::optional<WrappingInt32> fixed_isn{};
 };
 
-//! Config for classes derived from FdAdapter
+//! \brief Config for classes derived from FdAdapter
+//! \details The addresses are also kept as numbers, in flow(), which the per-segment path of the
+//! adapters reads instead of calling Address::port() (a getnameinfo) or Address::ipv4_numeric().
 class FdAdapterConfig {
-  public:
-    Address source{"0", 0};       //!< Source address and port
-    Address destination{"0", 0};  //!< Destination address and port
+  private:
+    Address _source{"0", 0};       //!< Source address and port
+    Address _destination{"0", 0};  //!< Destination address and port
+    TCPFlow _flow{};               //!< `_source` (the local end) and `_destination` (the remote end) as numbers
 
+  public:
     uint16_t loss_rate_dn = 0;  //!< Downlink loss rate (for LossyFdAdapter)
     uint16_t loss_rate_up = 0;  //!< Uplink loss rate (for LossyFdAdapter)
+
+    //! Source address and port
+    const Address &source() const { return _source; }
+
+    //! Destination address and port
+    const Address &destination() const { return _destination; }
+
+    //! The source (as the local end) and destination (as the remote end), in host byte order
+    const TCPFlow &flow() const { return _flow; }
+
+    //! Set the source address and port (an IPv4 address)
+    void set_source(const Address &source) {
+        _source = source;
+        _flow.local_address = source.ipv4_numeric();
+        _flow.local_port = source.port();
+    }
+
+    //! Set the destination address and port (an IPv4 address)
+    void set_destination(const Address &destination) {
+        _destination = destination;
+        _flow.remote_address = destination.ipv4_numeric();
+        _flow.remote_port = destination.port();
+    }
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_CONFIG_HH
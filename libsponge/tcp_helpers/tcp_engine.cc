@@ -0,0 +1,379 @@
+#include "tcp_engine.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+//! A SYN cookie's time slot is timestamp_ms() shifted right by this much (about a minute); a cookie
+//! is accepted in its own slot and the next one
+static constexpr unsigned COOKIE_SLOT_SHIFT = 16;
+
+//! The high bits of a SYN cookie carry the low bits of its time slot, the rest a MAC
+static constexpr unsigned COOKIE_MAC_BITS = 27;
+
+//! \returns a well-mixed 64-bit value (the finalizer of SplitMix64)
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+//! \param[in] adapter is the datagram adapter that carries the segments of every connection
+//! \param[in] backend is the EventLoop::Backend to wait with
+template <typename AdaptT>
+TCPEngine<AdaptT>::TCPEngine(AdaptT &&adapter, const EventLoop::Backend backend)
+    : _adapter(move(adapter))
+    , _eventloop(backend)
+    , _cookie_secret(uint64_t{get_random_generator()()} << 32 | get_random_generator()())
+    , _adapter_last_tick(timestamp_ms()) {
+    _eventloop.add_rule(
+        _adapter,
+        Direction::In,
+        [&] { _read_segments(); },
+        [&] { return _listen_config.has_value() or not _connections.empty(); });
+}
+
+//! \details One read may receive several datagrams (see FdAdapterBase::pending_reads); they are
+//! all handled here, since the fd may not be ready again until more arrive.
+template <typename AdaptT>
+void TCPEngine<AdaptT>::_read_segments() {
+    do {
+        TCPFlow flow;
+        auto seg = _adapter.read(flow);
+        if (not seg or (_steering and _steering(flow, seg.value()))) {
+            continue;
+        }
+        segment_arrived(flow, seg.value());
+    } while (_adapter.pending_reads());
+}
+
+//! \details A segment whose flow has no connection may open one if it is for the listening
+//! port (see _passive_open()); otherwise it is dropped.
+//! \param[in] flow is the flow of the segment
+//! \param[in] seg is the segment
+template <typename AdaptT>
+void TCPEngine<AdaptT>::segment_arrived(const TCPFlow &flow, const TCPSegment &seg) {
+    const auto connection = _connections.find(flow);
+    if (connection == _connections.end()) {
+        if (_listen_config and flow.local_port == _listen_port) {
+            _passive_open(flow, seg);
+        }
+        return;
+    }
+
+    _touch(connection->first, connection->second);
+    connection->second.tcp.segment_received(seg);
+}
+
+//! \details A SYN opens a half-open connection if both queues have room. If only the SYN queue is
+//! full, it is answered with a SYN cookie (when enabled) and forgotten. An ACK that returns a valid
+//! cookie opens an established connection straight into the accept queue.
+//! \param[in] flow is the flow of the segment
+//! \param[in] seg is a segment to the listening port that belongs to no connection
+template <typename AdaptT>
+void TCPEngine<AdaptT>::_passive_open(const TCPFlow &flow, const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    if (header.rst) {
+        return;
+    }
+
+    const uint64_t time_slot = timestamp_ms() >> COOKIE_SLOT_SHIFT;
+
+    if (header.syn and not header.ack) {
+        if (_accept_queue.size() >= _backlog or (_half_open >= _backlog and not _syn_cookies)) {
+            _listener_stats.syns_dropped++;
+            return;
+        }
+
+        if (_half_open >= _backlog) {
+            TCPSegment syn_ack;
+            syn_ack.header().syn = true;
+            syn_ack.header().ack = true;
+            syn_ack.header().seqno = _syn_cookie(flow, header.seqno, time_slot);
+            syn_ack.header().ackno = header.seqno + 1;
+            syn_ack.header().win = min<size_t>(_listen_config.value().recv_capacity, numeric_limits<uint16_t>::max());
+            _adapter.write(syn_ack, flow);
+            _listener_stats.cookies_sent++;
+            return;
+        }
+
+        // the queued connection's ISN is the cookie too, so that whichever of the two answers a
+        // (possibly retransmitted) SYN reaches the peer, its ACK is acceptable to this connection
+        TCPConfig config = _listen_config.value();
+        config.fixed_isn = _syn_cookie(flow, header.seqno, time_slot);
+        Connection &connection = _connections.try_emplace(flow, config, _next_id++, timestamp_ms()).first->second;
+        connection.half_open = true;
+        _half_open++;
+        _touch(flow, connection);
+        connection.tcp.segment_received(seg);
+        return;
+    }
+
+    if (not header.ack or header.syn or not _syn_cookies or _accept_queue.size() >= _backlog) {
+        return;
+    }
+
+    const WrappingInt32 isn = header.ackno - 1;
+    const WrappingInt32 peer_isn = header.seqno - 1;
+    if (_syn_cookie(flow, peer_isn, time_slot) != isn and _syn_cookie(flow, peer_isn, time_slot - 1) != isn) {
+        return;
+    }
+
+    TCPConfig config = _listen_config.value();
+    config.fixed_isn = isn;
+    Connection &connection = _connections.try_emplace(flow, config, _next_id++, timestamp_ms()).first->second;
+    _touch(flow, connection);
+
+    // replay the handshake: the SYN (whose SYN-ACK already went out, carrying the cookie), then this ACK
+    TCPSegment syn;
+    syn.header().syn = true;
+    syn.header().seqno = peer_isn;
+    syn.header().win = header.win;
+    connection.tcp.segment_received(syn);
+    while (not connection.tcp.segments_out().empty()) {
+        connection.tcp.segments_out().pop();
+    }
+    connection.tcp.segment_received(seg);
+
+    _accept_queue.emplace(flow, connection.id);
+    _listener_stats.cookies_accepted++;
+}
+
+//! \param[in] flow is the flow of the connection
+//! \param[in] peer_isn is the ISN of the peer's SYN
+//! \param[in] time_slot is timestamp_ms() >> COOKIE_SLOT_SHIFT when the SYN arrived
+template <typename AdaptT>
+WrappingInt32 TCPEngine<AdaptT>::_syn_cookie(const TCPFlow &flow,
+                                             const WrappingInt32 peer_isn,
+                                             const uint64_t time_slot) const {
+    const uint64_t mac = mix64(_cookie_secret ^ TCPFlow::Hash{}(flow) ^ mix64(time_slot << 32 | peer_isn.raw_value()));
+    const uint32_t slot_bits = static_cast<uint32_t>(time_slot) << COOKIE_MAC_BITS;
+    return WrappingInt32{slot_bits | static_cast<uint32_t>(mac & ((uint32_t{1} << COOKIE_MAC_BITS) - 1))};
+}
+
+//! \param[in] flow is the flow of the connection
+//! \param[in] id is the id of the connection
+template <typename AdaptT>
+typename TCPEngine<AdaptT>::Connection *TCPEngine<AdaptT>::_find(const TCPFlow &flow, const uint64_t id) {
+    const auto connection = _connections.find(flow);
+    if (connection == _connections.end() or connection->second.id != id) {
+        return nullptr;
+    }
+    return &connection->second;
+}
+
+//! \details Called before anything happens to a connection, so that the time since its last
+//! tick is accounted for before the event (e.g. a segment resetting its linger timer).
+//! \param[in] flow is the flow of the connection
+//! \param[in] connection is the connection
+template <typename AdaptT>
+void TCPEngine<AdaptT>::_touch(const TCPFlow &flow, Connection &connection) {
+    const uint64_t now = timestamp_ms();
+    if (now > connection.last_tick) {
+        connection.tcp.tick(now - connection.last_tick);
+        connection.last_tick = now;
+    }
+    if (not connection.dirty) {
+        connection.dirty = true;
+        _dirty.push_back(flow);
+    }
+}
+
+template <typename AdaptT>
+void TCPEngine<AdaptT>::_service() {
+    for (const TCPFlow &flow : _dirty) {
+        const auto it = _connections.find(flow);
+        if (it == _connections.end()) {
+            continue;
+        }
+        Connection &connection = it->second;
+        connection.dirty = false;
+        _eventloop.interest_changed(_group(connection.id));
+
+        auto &segments = connection.tcp.segments_out();
+        while (not segments.empty()) {
+            _adapter.write(segments.front(), flow);
+            segments.pop();
+        }
+
+        // a passively opened connection leaves the SYN queue once its SYN-ACK is acknowledged
+        if (connection.half_open and (not connection.tcp.active() or connection.tcp.bytes_in_flight() == 0)) {
+            connection.half_open = false;
+            _half_open--;
+            if (connection.tcp.active()) {
+                _accept_queue.emplace(flow, connection.id);
+            }
+        }
+
+        const auto until_deadline = connection.tcp.time_until_next_deadline();
+        const uint64_t deadline = connection.last_tick + until_deadline.value_or(0);
+        if (connection.timer and (not until_deadline or deadline != connection.deadline)) {
+            _eventloop.cancel_timer(connection.timer.value());
+            connection.timer.reset();
+        }
+
+        if (not connection.tcp.active()) {
+            // keep a finished connection until the application has read everything it received
+            if (connection.tcp.inbound_stream().buffer_empty()) {
+                const uint64_t id = connection.id;
+                _connections.erase(it);
+                if (_on_removed) {
+                    _on_removed(id);
+                }
+            }
+            continue;
+        }
+
+        if (until_deadline and not connection.timer) {
+            connection.timer = _eventloop.add_timer(deadline, [this, flow] {
+                auto expired = _connections.find(flow);
+                if (expired != _connections.end()) {
+                    expired->second.timer.reset();
+                    _touch(expired->first, expired->second);
+                }
+            });
+            connection.deadline = deadline;
+        }
+    }
+    _dirty.clear();
+
+    // send what every connection (and the listener) wrote, in as few system calls as the adapter can
+    _adapter.flush();
+}
+
+//! \param[in] config is the configuration of the new connection
+//! \param[in] flow is the flow of the new connection
+//! \returns a Stream for the connection
+template <typename AdaptT>
+typename TCPEngine<AdaptT>::Stream TCPEngine<AdaptT>::connect(const TCPConfig &config, const TCPFlow &flow) {
+    if (_connections.count(flow)) {
+        throw runtime_error("TCPEngine::connect(): flow already has a connection");
+    }
+
+    Connection &connection = _connections.try_emplace(flow, config, _next_id++, timestamp_ms()).first->second;
+    _touch(flow, connection);
+    connection.tcp.connect();
+    return {*this, flow, connection.id};
+}
+
+//! \param[in] config is the configuration of passively opened connections
+//! \param[in] port is the local port to accept connections on
+//! \param[in] backlog is the limit of both the SYN queue and the accept queue
+//! \param[in] syn_cookies is whether to answer SYNs with SYN cookies when the SYN queue is full
+template <typename AdaptT>
+void TCPEngine<AdaptT>::listen(const TCPConfig &config,
+                               const uint16_t port,
+                               const size_t backlog,
+                               const bool syn_cookies) {
+    _listen_config = config;
+    _listen_port = port;
+    _backlog = backlog;
+    _syn_cookies = syn_cookies;
+}
+
+template <typename AdaptT>
+optional<typename TCPEngine<AdaptT>::Stream> TCPEngine<AdaptT>::accept() {
+    while (not _accept_queue.empty()) {
+        const auto [flow, id] = _accept_queue.front();
+        _accept_queue.pop();
+        if (_find(flow, id)) {
+            return Stream{*this, flow, id};
+        }
+    }
+    return {};
+}
+
+//! \param[in] timeout_ms is the longest time to wait (negative means wait until something happens)
+template <typename AdaptT>
+EventLoop::Result TCPEngine<AdaptT>::wait_next_event(const int timeout_ms) {
+    // the application may have used its Streams since the last call
+    _service();
+
+    // while the engine holds connections, wake when the adapter next needs a tick (e.g. an ARP entry
+    // expiring); an adapter that never needs one is ticked only as events arrive
+    const optional<uint64_t> until_adapter_tick = _adapter.time_until_next_tick();
+    if (not _connections.empty() and until_adapter_tick) {
+        const uint64_t deadline = _adapter_last_tick + until_adapter_tick.value();
+        if (not _adapter_timer or deadline != _adapter_deadline) {
+            if (_adapter_timer) {
+                _eventloop.cancel_timer(_adapter_timer.value());
+            }
+            _adapter_timer = _eventloop.add_timer(deadline, [&] { _adapter_timer.reset(); });
+            _adapter_deadline = deadline;
+        }
+    } else if (_adapter_timer) {
+        _eventloop.cancel_timer(_adapter_timer.value());
+        _adapter_timer.reset();
+    }
+
+    const auto ret = _eventloop.wait_next_event(timeout_ms);
+
+    const uint64_t now = timestamp_ms();
+    _adapter.tick(now - _adapter_last_tick);
+    _adapter_last_tick = now;
+
+    _service();
+    return ret;
+}
+
+template <typename AdaptT>
+TCPConnection &TCPEngine<AdaptT>::Stream::_tcp() {
+    Connection *connection = _engine->_find(_flow, _id);
+    if (not connection) {
+        throw runtime_error("TCPEngine::Stream: connection no longer exists");
+    }
+    _engine->_touch(_flow, *connection);
+    return connection->tcp;
+}
+
+template <typename AdaptT>
+size_t TCPEngine<AdaptT>::Stream::remaining_outbound_capacity() const {
+    const Connection *connection = _engine->_find(_flow, _id);
+    return connection ? connection->tcp.remaining_outbound_capacity() : 0;
+}
+
+template <typename AdaptT>
+const ByteStream &TCPEngine<AdaptT>::Stream::inbound_stream() const {
+    const Connection *connection = _engine->_find(_flow, _id);
+    if (not connection) {
+        throw runtime_error("TCPEngine::Stream: connection no longer exists");
+    }
+    return connection->tcp.inbound_stream();
+}
+
+template <typename AdaptT>
+bool TCPEngine<AdaptT>::Stream::active() const {
+    const Connection *connection = _engine->_find(_flow, _id);
+    return connection and connection->tcp.active();
+}
+
+template <typename AdaptT>
+TCPState TCPEngine<AdaptT>::Stream::state() const {
+    const Connection *connection = _engine->_find(_flow, _id);
+    if (not connection) {
+        throw runtime_error("TCPEngine::Stream: connection no longer exists");
+    }
+    return connection->tcp.state();
+}
+
+//! Specialization of TCPEngine for TCPOverUDPSocketAdapter
+template class TCPEngine<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPEngine for TCPOverIPv4OverTunFdAdapter
+template class TCPEngine<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialization of TCPEngine for TCPOverIPv4OverEthernetAdapter
+template class TCPEngine<TCPOverIPv4OverEthernetAdapter>;
+
+//! Specialization of TCPEngine for LossyTCPOverUDPSocketAdapter
+template class TCPEngine<LossyTCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPEngine for LossyTCPOverIPv4OverTunFdAdapter
+template class TCPEngine<LossyTCPOverIPv4OverTunFdAdapter>;
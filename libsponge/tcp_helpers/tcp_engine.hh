@@ -0,0 +1,258 @@
+#ifndef SPONGE_LIBSPONGE_TCP_ENGINE_HH
+#define SPONGE_LIBSPONGE_TCP_ENGINE_HH
+
+#include "buffer.hh"
+#include "byte_stream.hh"
+#include "eventloop.hh"
+#include "fd_adapter.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_flow.hh"
+#include "tcp_state.hh"
+#include "tuntap_adapter.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! \brief Drives many TCPConnections over one datagram adapter, from one thread and one EventLoop
+template <typename AdaptT>
+class TCPEngine {
+  public:
+    class Stream;
+
+    //! Default number of half-open, and of not yet accepted, connections a listener keeps
+    static constexpr size_t DEFAULT_BACKLOG = 128;
+
+    //! What a listener did with the SYNs it could not queue
+    struct ListenerStats {
+        uint64_t syns_dropped = 0;      //!< SYNs ignored because a queue was full (and cookies did not apply)
+        uint64_t cookies_sent = 0;      //!< SYN-ACKs sent with a SYN cookie instead of a half-open connection
+        uint64_t cookies_accepted = 0;  //!< Connections opened by an ACK that carried a valid SYN cookie
+    };
+
+    //! \brief Sees each segment read from the adapter before the engine does
+    //! \returns `true` if it took the segment (e.g. to hand it to another engine), `false` to let it through
+    using SteeringT = std::function<bool(const TCPFlow &, TCPSegment &)>;
+
+  private:
+    //! One TCPConnection and the engine's bookkeeping for it
+    struct Connection {
+        TCPConnection tcp;                           //!< The connection itself
+        uint64_t id;                                 //!< Distinguishes successive connections of one flow
+        uint64_t last_tick;                          //!< timestamp_ms() when `tcp` was last ticked
+        std::optional<EventLoop::TimerIdT> timer{};  //!< Fires at the connection's next deadline
+        uint64_t deadline = 0;                       //!< Deadline of `timer`
+        bool dirty = false;                          //!< Whether the connection is in TCPEngine::_dirty
+        bool half_open = false;                      //!< Passively opened, and its SYN-ACK not yet acknowledged
+
+        Connection(const TCPConfig &config, const uint64_t id_, const uint64_t now)
+            : tcp(config), id(id_), last_tick(now) {}
+    };
+
+    AdaptT _adapter;       //!< Reads and writes the segments of every connection
+    EventLoop _eventloop;  //!< Waits for datagrams and for the connections' deadlines
+
+    std::unordered_map<TCPFlow, Connection, TCPFlow::Hash> _connections{};  //!< Connections by flow
+    uint64_t _next_id = 0;                                                   //!< Id of the next connection
+
+    //! Connections that may have segments to send, a new deadline, or be finished
+    std::vector<TCPFlow> _dirty{};
+
+    std::optional<TCPConfig> _listen_config{};  //!< Configuration of passively opened connections, if listening
+    uint16_t _listen_port = 0;                  //!< Port on which new connections are accepted
+    size_t _backlog = DEFAULT_BACKLOG;          //!< Limit of the SYN queue and of the accept queue
+    bool _syn_cookies = true;                   //!< Answer SYNs with SYN cookies when the SYN queue is full
+    size_t _half_open = 0;                      //!< Size of the SYN queue (connections with `half_open` set)
+    uint64_t _cookie_secret;                    //!< Key of the SYN cookie MAC
+    ListenerStats _listener_stats{};
+
+    //! Flows and ids of established, passively opened connections not yet accepted
+    std::queue<std::pair<TCPFlow, uint64_t>> _accept_queue{};
+
+    //! Called with the id of each connection the engine removes
+    std::function<void(uint64_t)> _on_removed{};
+
+    //! Sees each segment read from the adapter, if set
+    SteeringT _steering{};
+
+    uint64_t _adapter_last_tick;                          //!< timestamp_ms() when the adapter was last ticked
+    std::optional<EventLoop::TimerIdT> _adapter_timer{};  //!< Wakes the loop to tick the adapter (e.g. for ARP)
+    uint64_t _adapter_deadline = 0;                       //!< timestamp_ms() at which `_adapter_timer` fires
+
+    //! Read segments from the adapter and hand each to the steering function or to segment_arrived()
+    void _read_segments();
+
+    //! Handle a segment to the listening port that belongs to no connection
+    void _passive_open(const TCPFlow &flow, const TCPSegment &seg);
+
+    //! The ISN of a SYN-ACK that encodes `flow`, the peer's ISN and a coarse timestamp
+    WrappingInt32 _syn_cookie(const TCPFlow &flow, const WrappingInt32 peer_isn, const uint64_t time_slot) const;
+
+    //! EventLoop group of the connection `id` (see Stream::group)
+    static EventLoop::GroupT _group(const uint64_t id) { return id + 1; }
+
+    //! Find the live connection a Stream refers to (nullptr if it is gone)
+    Connection *_find(const TCPFlow &flow, const uint64_t id);
+
+    //! Let the time since a connection was last ticked pass, and queue it for _service()
+    void _touch(const TCPFlow &flow, Connection &connection);
+
+    //! Send the queued segments of dirty connections, re-arm their timers, and remove finished ones
+    void _service();
+
+  public:
+    //! A lightweight handle to one connection of a TCPEngine; valid until the connection is removed
+    class Stream {
+      private:
+        TCPEngine *_engine;  //!< Engine that owns the connection
+        TCPFlow _flow;       //!< Flow of the connection
+        uint64_t _id;        //!< Id of the connection
+
+        //! The connection, which is ticked and queued for servicing; throws if it is gone
+        TCPConnection &_tcp();
+
+      public:
+        //! Construct a handle to the connection `id` of `flow` in `engine`
+        Stream(TCPEngine &engine, const TCPFlow &flow, const uint64_t id)
+            : _engine(&engine), _flow(flow), _id(id) {}
+
+        //! The addresses and ports of the connection
+        const TCPFlow &flow() const { return _flow; }
+
+        //! Unique id of the connection within its engine
+        uint64_t id() const { return _id; }
+
+        //! \brief EventLoop group that the engine marks stale whenever it services the connection
+        //! \details Rules whose interest depends on the connection should use it (see EventLoop::interest_changed)
+        EventLoop::GroupT group() const { return _group(_id); }
+
+        //! `false` once the engine has removed the connection (it finished and its inbound data was read)
+        bool valid() const { return _engine->_find(_flow, _id) != nullptr; }
+
+        //! \name Writer interface (see TCPConnection)
+        //!@{
+        size_t write(const std::string &data) { return _tcp().write(data); }
+        size_t write(Buffer data) { return _tcp().write(std::move(data)); }
+        void end_input_stream() { _tcp().end_input_stream(); }
+
+        //! Number of bytes that can be written right now (0 once the connection is gone)
+        size_t remaining_outbound_capacity() const;
+        //!@}
+
+        //! \name Reader interface
+        //!@{
+
+        //! Read up to `len` bytes from the inbound stream
+        std::string read(const size_t len) { return _tcp().inbound_stream().read(len); }
+
+        //! The inbound stream, for reading from (call it again after each TCPEngine::wait_next_event)
+        ByteStream &inbound_stream() { return _tcp().inbound_stream(); }
+
+        //! The inbound stream, for looking at without counting as a use of the connection
+        const ByteStream &inbound_stream() const;
+        //!@}
+
+        //! Whether the connection is still active (false once it is gone)
+        bool active() const;
+
+        //! The state of the connection; throws if it is gone
+        TCPState state() const;
+    };
+
+    //! Construct an engine that sends and receives segments through `adapter`
+    explicit TCPEngine(AdaptT &&adapter, const EventLoop::Backend backend = EventLoop::Backend::Epoll);
+
+    //! Start connecting to `flow`'s remote end from its local port (and local address, if the transport has one)
+    Stream connect(const TCPConfig &config, const TCPFlow &flow);
+
+    //! \brief Accept connections to `port`, each configured with `config`
+    //! \param[in] backlog limits both the half-open connections and the established ones not yet accepted
+    //! \param[in] syn_cookies makes SYNs that overflow the SYN queue get a stateless SYN cookie instead
+    void listen(const TCPConfig &config,
+                const uint16_t port,
+                const size_t backlog = DEFAULT_BACKLOG,
+                const bool syn_cookies = true);
+
+    //! Take the oldest established, passively opened connection, if there is one
+    std::optional<Stream> accept();
+
+    //! Number of established connections waiting to be accepted
+    size_t accept_queue_size() const { return _accept_queue.size(); }
+
+    //! Counters of the SYNs the listener could not queue
+    const ListenerStats &listener_stats() const { return _listener_stats; }
+
+    //! Set a function to be called with the id of each connection the engine removes
+    void on_removed(const std::function<void(uint64_t)> &callback) { _on_removed = callback; }
+
+    //! Set a function that sees (and may take) each segment read from the adapter
+    void set_steering(const SteeringT &steering) { _steering = steering; }
+
+    //! \brief Hand a segment of `flow` to the connection it belongs to (or to the listener)
+    //! \details Segments read from the adapter go through here; call it directly for segments that
+    //! arrived some other way (e.g. read by another engine's adapter and steered to this one).
+    void segment_arrived(const TCPFlow &flow, const TCPSegment &seg);
+
+    //! \brief Wait for segments or deadlines (at most `timeout_ms`, or forever if negative) and handle them
+    //! \returns EventLoop::Result::Exit once there is nothing left to wait for
+    EventLoop::Result wait_next_event(const int timeout_ms);
+
+    //! Number of connections that the engine still holds
+    size_t connection_count() const { return _connections.size(); }
+
+    //! The event loop, for callers that want to wait on their own fds too
+    EventLoop &eventloop() { return _eventloop; }
+
+    //! The underlying datagram adapter
+    AdaptT &adapter() { return _adapter; }
+
+    //! \name
+    //! Stream handles point at the engine, so it cannot be moved or copied
+
+    //!@{
+    TCPEngine(const TCPEngine &) = delete;
+    TCPEngine(TCPEngine &&) = delete;
+    TCPEngine &operator=(const TCPEngine &) = delete;
+    TCPEngine &operator=(TCPEngine &&) = delete;
+    ~TCPEngine() = default;
+    //!@}
+};
+
+using TCPOverUDPEngine = TCPEngine<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4Engine = TCPEngine<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverIPv4OverEthernetEngine = TCPEngine<TCPOverIPv4OverEthernetAdapter>;
+
+using LossyTCPOverUDPEngine = TCPEngine<LossyTCPOverUDPSocketAdapter>;
+using LossyTCPOverIPv4Engine = TCPEngine<LossyTCPOverIPv4OverTunFdAdapter>;
+
+//! \class TCPEngine
+//! Unlike TCPSpongeSocket, which runs a thread, an EventLoop and a socket pair for each connection,
+//! a TCPEngine runs every connection on the thread that calls TCPEngine::wait_next_event. Incoming
+//! segments are demultiplexed to their TCPConnection by TCPFlow through a hash table, and the
+//! application reads and writes through TCPEngine::Stream handles, which operate on the
+//! connection's ByteStreams directly.
+//!
+//! Only connections with something to do are touched: a connection is ticked (with all the time
+//! that passed since its last tick) and serviced when a segment arrives for it, when the
+//! application uses its Stream, or when its next deadline (a retransmission or the end of
+//! lingering) is reached. Each connection keeps one EventLoop timer for that deadline.
+//!
+//! A connection is removed once it is no longer active and all of its inbound data has been read.
+//!
+//! A listening engine keeps passively opened connections in a SYN queue until their SYN-ACK is
+//! acknowledged, and then in an accept queue until TCPEngine::accept takes them; both are limited
+//! to the backlog. When the accept queue is full, new SYNs are dropped (the peer will retransmit).
+//! When only the SYN queue is full, a SYN is answered with a SYN cookie: the SYN-ACK's sequence
+//! number is a MAC of the flow, the peer's ISN and the time, so no state is kept until an ACK
+//! returns it, at which point the connection is rebuilt as if it had been queued all along. Queued
+//! connections take the same cookie as their ISN, so a peer whose retransmitted SYN got the other
+//! kind of answer still completes the handshake.
+
+#endif  // SPONGE_LIBSPONGE_TCP_ENGINE_HH
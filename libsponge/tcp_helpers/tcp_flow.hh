@@ -0,0 +1,39 @@
+#ifndef SPONGE_LIBSPONGE_TCP_FLOW_HH
+#define SPONGE_LIBSPONGE_TCP_FLOW_HH
+
+#include "address.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+//! \brief The addresses and port numbers that identify one TCP connection, seen from the local end
+//! \details Everything is numeric and in host byte order, so that demultiplexing incoming segments
+//! to connections only compares and hashes integers.
+struct TCPFlow {
+    uint32_t local_address = 0;   //!< Local IPv4 address (0 if the transport doesn't say, e.g. for UDP)
+    uint32_t remote_address = 0;  //!< Remote IPv4 address
+    uint16_t local_port = 0;      //!< Local TCP port
+    uint16_t remote_port = 0;     //!< Remote TCP port
+
+    //! The peer as an Address
+    Address remote() const { return Address::from_ipv4_numeric(remote_address, remote_port); }
+
+    bool operator==(const TCPFlow &other) const {
+        return local_address == other.local_address and remote_address == other.remote_address and
+               local_port == other.local_port and remote_port == other.remote_port;
+    }
+    bool operator!=(const TCPFlow &other) const { return not operator==(other); }
+
+    //! Hash function for unordered containers keyed by TCPFlow
+    struct Hash {
+        size_t operator()(const TCPFlow &flow) const {
+            uint64_t x = (uint64_t{flow.local_address} << 32 | flow.remote_address) ^
+                         (uint64_t{flow.local_port} << 16 | flow.remote_port) * 0x9e3779b97f4a7c15;
+            x ^= x >> 31;
+            x *= 0xbf58476d1ce4e5b9;
+            return x ^ (x >> 29);
+        }
+    };
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_FLOW_HH
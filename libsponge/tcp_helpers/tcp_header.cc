@@ -1,9 +1,62 @@
 #include "tcp_header.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 using namespace std;
 
+//! \name TCP option kinds (RFC 793, RFC 2018)
+//!@{
+static constexpr uint8_t OPTION_END = 0;
+static constexpr uint8_t OPTION_NOP = 1;
+static constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+static constexpr uint8_t OPTION_SACK = 5;
+//!@}
+
+//! \details SACK-permitted takes 4 bytes (two NOPs to align it), and the SACK option 4 bytes (two NOPs,
+//! kind and length) plus 8 per block.
+size_t TCPHeader::options_length() const {
+    return (sack_permitted ? 4 : 0) + (sack_count ? 4 + 8 * sack_count : 0);
+}
+
+//! \brief Parse the options that follow the fixed fields of `header`
+//! \details Options not understood are skipped, and so are malformed ones: parsing stops at an
+//! option whose length is impossible, keeping what was parsed before it.
+//! \param[in] options points to the option bytes of the header
+//! \param[in] length is the number of option bytes (`4 * doff - LENGTH`)
+static void parse_options(TCPHeader &header, const uint8_t *options, const size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        const uint8_t kind = options[i];
+        if (kind == OPTION_END) {
+            return;
+        }
+        if (kind == OPTION_NOP) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= length) {
+            return;
+        }
+        const size_t option_length = options[i + 1];
+        if (option_length < 2 or i + option_length > length) {
+            return;
+        }
+
+        if (kind == OPTION_SACK_PERMITTED and option_length == 2) {
+            header.sack_permitted = true;
+        } else if (kind == OPTION_SACK and option_length % 8 == 2) {
+            header.sack_count = min((option_length - 2) / 8, TCPHeader::MAX_SACK_BLOCKS);
+            for (size_t block = 0; block < header.sack_count; block++) {
+                header.sack[block].left = WrappingInt32{NetParser::u32(options + i + 2 + 8 * block)};
+                header.sack[block].right = WrappingInt32{NetParser::u32(options + i + 6 + 8 * block)};
+            }
+        }
+        i += option_length;
+    }
+}
+
 //! \param[in,out] p is a NetParser from which the TCP fields will be extracted
 //! \returns a ParseResult indicating success or the reason for failure
 //! \details It is important to check for (at least) the following potential errors
@@ -15,13 +68,18 @@ using namespace std;
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
 ParseResult TCPHeader::parse(NetParser &p) {
-    sport = p.u16();                 // source port
-    dport = p.u16();                 // destination port
-    seqno = WrappingInt32{p.u32()};  // sequence number
-    ackno = WrappingInt32{p.u32()};  // ack number
-    doff = p.u8() >> 4;              // data offset
+    const uint8_t *h = p.take(TCPHeader::LENGTH);  // the fixed fields are bounds-checked once
+    if (h == nullptr) {
+        return p.get_error();
+    }
 
-    const uint8_t fl_b = p.u8();                  // byte including flags
+    sport = NetParser::u16(h);                     // source port
+    dport = NetParser::u16(h + 2);                 // destination port
+    seqno = WrappingInt32{NetParser::u32(h + 4)};  // sequence number
+    ackno = WrappingInt32{NetParser::u32(h + 8)};  // ack number
+    doff = NetParser::u8(h + 12) >> 4;             // data offset
+
+    const uint8_t fl_b = NetParser::u8(h + 13);   // byte including flags
     urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
     ack = static_cast<bool>(fl_b & 0b0001'0000);
     psh = static_cast<bool>(fl_b & 0b0000'1000);
@@ -29,19 +87,23 @@ ParseResult TCPHeader::parse(NetParser &p) {
     syn = static_cast<bool>(fl_b & 0b0000'0010);
     fin = static_cast<bool>(fl_b & 0b0000'0001);
 
-    win = p.u16();    // window size
-    cksum = p.u16();  // checksum
-    uptr = p.u16();   // urgent pointer
+    win = NetParser::u16(h + 14);              // window size
+    cksum = NetParser::u16(h + CKSUM_OFFSET);  // checksum
+    uptr = NetParser::u16(h + 18);             // urgent pointer
 
     if (doff < 5) {
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
-
-    if (p.error()) {
-        return p.get_error();
+    // parse the options (which begin where the fixed fields end)
+    sack_permitted = false;
+    sack_count = 0;
+    if (doff * 4 > TCPHeader::LENGTH) {
+        const uint8_t *options = p.take(doff * 4 - TCPHeader::LENGTH);
+        if (options == nullptr) {
+            return p.get_error();
+        }
+        parse_options(*this, options, doff * 4 - TCPHeader::LENGTH);
     }
 
     return ParseResult::NoError;
@@ -54,27 +116,58 @@ string TCPHeader::serialize() const {
         throw runtime_error("TCP header too short");
     }
 
-    string ret;
-    ret.reserve(4 * doff);
+    string ret(4 * doff, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
 
-    NetUnparser::u16(ret, sport);              // source port
-    NetUnparser::u16(ret, dport);              // destination port
-    NetUnparser::u32(ret, seqno.raw_value());  // sequence number
-    NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
+//! \param[out] dst receives the header (does not recompute the checksum); past the options, the
+//! header is zero-filled up to its advertised size
+uint8_t *TCPHeader::serialize_into(uint8_t *dst) const {
+    // sanity check
+    if (doff < 5) {
+        throw runtime_error("TCP header too short");
+    }
+    if (LENGTH + options_length() > 4 * doff) {
+        throw runtime_error("TCP options do not fit in the header");
+    }
+
+    uint8_t *p = dst;
+    p = NetUnparser::u16(p, sport);              // source port
+    p = NetUnparser::u16(p, dport);              // destination port
+    p = NetUnparser::u32(p, seqno.raw_value());  // sequence number
+    p = NetUnparser::u32(p, ackno.raw_value());  // ack number
+    p = NetUnparser::u8(p, doff << 4);           // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
                          (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
-    NetUnparser::u8(ret, fl_b);  // flags
-    NetUnparser::u16(ret, win);  // window size
+    p = NetUnparser::u8(p, fl_b);  // flags
+    p = NetUnparser::u16(p, win);  // window size
+
+    p = NetUnparser::u16(p, cksum);  // checksum
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    p = NetUnparser::u16(p, uptr);  // urgent pointer
 
-    NetUnparser::u16(ret, uptr);  // urgent pointer
+    if (sack_permitted) {
+        p = NetUnparser::u8(p, OPTION_NOP);
+        p = NetUnparser::u8(p, OPTION_NOP);
+        p = NetUnparser::u8(p, OPTION_SACK_PERMITTED);
+        p = NetUnparser::u8(p, 2);
+    }
+    if (sack_count) {
+        p = NetUnparser::u8(p, OPTION_NOP);
+        p = NetUnparser::u8(p, OPTION_NOP);
+        p = NetUnparser::u8(p, OPTION_SACK);
+        p = NetUnparser::u8(p, 2 + 8 * sack_count);
+        for (size_t block = 0; block < sack_count; block++) {
+            p = NetUnparser::u32(p, sack[block].left.raw_value());
+            p = NetUnparser::u32(p, sack[block].right.raw_value());
+        }
+    }
 
-    ret.resize(4 * doff);  // expand header to advertised size
+    memset(p, 0, dst + 4 * doff - p);  // expand header to advertised size
 
-    return ret;
+    return dst + 4 * doff;
 }
 
 //! \returns A string with the header's contents
@@ -90,13 +183,23 @@ string TCPHeader::to_string() const {
        << "TCP winsize: " << +win << '\n'
        << "TCP cksum: " << +cksum << '\n'
        << "TCP uptr: " << +uptr << '\n';
+    if (sack_permitted) {
+        ss << "TCP SACK permitted\n";
+    }
+    for (size_t block = 0; block < sack_count; block++) {
+        ss << "TCP SACK: " << sack[block].left << "-" << sack[block].right << '\n';
+    }
     return ss.str();
 }
 
 string TCPHeader::summary() const {
     stringstream ss{};
     ss << "Header(flags=" << (syn ? "S" : "") << (ack ? "A" : "") << (rst ? "R" : "") << (fin ? "F" : "")
-       << ",seqno=" << seqno << ",ack=" << ackno << ",win=" << win << ")";
+       << ",seqno=" << seqno << ",ack=" << ackno << ",win=" << win;
+    for (size_t block = 0; block < sack_count; block++) {
+        ss << (block ? " " : ",sack=") << sack[block].left << "-" << sack[block].right;
+    }
+    ss << ")";
     return ss.str();
 }
 
@@ -104,5 +207,6 @@ bool TCPHeader::operator==(const TCPHeader &other) const {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
     return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg && ack == other.ack &&
            psh == other.psh && rst == other.rst && syn == other.syn && fin == other.fin && win == other.win &&
-           uptr == other.uptr;
+           uptr == other.uptr && sack_permitted == other.sack_permitted && sack_count == other.sack_count &&
+           equal(sack.begin(), sack.begin() + sack_count, other.sack.begin());
 }
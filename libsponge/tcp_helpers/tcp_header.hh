@@ -4,10 +4,23 @@
 #include "parser.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
+
+//! \brief A range of sequence space that a receiver holds beyond its ackno (RFC 2018)
+struct SACKBlock {
+    WrappingInt32 left{0};   //!< First sequence number of the block
+    WrappingInt32 right{0};  //!< Sequence number just past the block
+
+    bool operator==(const SACKBlock &other) const { return left == other.left and right == other.right; }
+};
+
 //! \brief [TCP](\ref rfc::rfc793) segment header
-//! \note TCP options are not supported
+//! \note The only TCP options understood are SACK-permitted and SACK (RFC 2018); others are skipped
 struct TCPHeader {
     static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t MAX_LENGTH = 60;      //!< Longest header that `doff` can describe, with options
+    static constexpr size_t CKSUM_OFFSET = 16;    //!< Offset of the checksum field within the header
+    static constexpr size_t MAX_SACK_BLOCKS = 4;  //!< SACK blocks that fit in the option space
 
     //! \struct TCPHeader
     //! ~~~{.txt}
@@ -50,12 +63,27 @@ struct TCPHeader {
     uint16_t uptr = 0;          //!< urgent pointer
     //!@}
 
+    //! \name TCP options
+    //!@{
+    bool sack_permitted = false;                    //!< SACK-permitted option (only on SYN segments)
+    std::array<SACKBlock, MAX_SACK_BLOCKS> sack{};  //!< SACK option: the first `sack_count` blocks
+    uint8_t sack_count = 0;                         //!< Number of SACK blocks, or 0 for no SACK option
+    //!@}
+
+    //! \brief Length of the options set above, padded to a multiple of 4 bytes
+    //! \details The header takes `LENGTH + options_length()` bytes; set `doff` to a quarter of that.
+    size_t options_length() const;
+
     //! Parse the TCP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
     //! Serialize the TCP fields
     std::string serialize() const;
 
+    //! \brief Serialize the TCP fields into `dst`, which must have room for `4 * doff` bytes
+    //! \returns the position just past the header
+    uint8_t *serialize_into(uint8_t *dst) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 
@@ -4,7 +4,6 @@
 #include "ipv4_header.hh"
 #include "parser.hh"
 
-#include <arpa/inet.h>
 #include <stdexcept>
 #include <unistd.h>
 #include <utility>
@@ -22,16 +21,20 @@ using namespace std;
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//! \param[in] ip_dgram is the datagram to unwrap
+//! \param[in] tcp_cksum_trusted is whether the device already checked the TCP checksum
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram) {
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                          const bool tcp_cksum_trusted) {
     // is the IPv4 datagram for us?
     // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
-    if (not listening() and (ip_dgram.header().dst != config().source.ipv4_numeric())) {
+    const TCPFlow &expected = config().flow();
+    if (not listening() and (ip_dgram.header().dst != expected.local_address)) {
         return {};
     }
 
     // is the IPv4 datagram from our peer?
-    if (not listening() and (ip_dgram.header().src != config().destination.ipv4_numeric())) {
+    if (not listening() and (ip_dgram.header().src != expected.remote_address)) {
         return {};
     }
 
@@ -42,20 +45,21 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
 
     // is the payload a valid TCP segment?
     TCPSegment tcp_seg;
-    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+    if (ParseResult::NoError !=
+        tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(), not tcp_cksum_trusted)) {
         return {};
     }
 
     // is the TCP segment for us?
-    if (tcp_seg.header().dport != config().source.port()) {
+    if (tcp_seg.header().dport != expected.local_port) {
         return {};
     }
 
     // should we target this source addr/port (and use its destination addr as our source) in reply?
     if (listening()) {
         if (tcp_seg.header().syn and not tcp_seg.header().rst) {
-            config_mutable().source = {inet_ntoa({htobe32(ip_dgram.header().dst)}), config().source.port()};
-            config_mutable().destination = {inet_ntoa({htobe32(ip_dgram.header().src)}), tcp_seg.header().sport};
+            config_mutable().set_source(Address::from_ipv4_numeric(ip_dgram.header().dst, expected.local_port));
+            config_mutable().set_destination(Address::from_ipv4_numeric(ip_dgram.header().src, tcp_seg.header().sport));
             set_listening(false);
         } else {
             return {};
@@ -63,7 +67,7 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
     }
 
     // is the TCP segment from our peer?
-    if (tcp_seg.header().sport != config().destination.port()) {
+    if (tcp_seg.header().sport != expected.remote_port) {
         return {};
     }
 
@@ -72,19 +76,66 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
 
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
-InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
-    // set the port numbers in the TCP segment
-    seg.header().sport = config().source.port();
-    seg.header().dport = config().destination.port();
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) { return wrap_tcp_in_ip(seg, config().flow()); }
+
+//! \param[in] seg is the TCP segment to send; its port numbers are set as necessary
+IPv4Header TCPOverIPv4Adapter::ip_header_for(TCPSegment &seg) { return ip_header_for(seg, config().flow()); }
+
+//! \details Unlike the single-connection version, this accepts segments from any peer (and
+//! never changes the configuration); the caller demultiplexes them by `flow`. If the adapter is
+//! configured with a source address other than 0 (INADDR_ANY), datagrams to other hosts are ignored.
+//! \param[in] ip_dgram is the datagram to unwrap
+//! \param[out] flow is set to the flow of the segment
+//! \param[in] tcp_cksum_trusted is whether the device already checked the TCP checksum
+//! \returns a std::optional<TCPSegment> that is empty if the datagram doesn't carry a valid TCP segment for us
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                          TCPFlow &flow,
+                                                          const bool tcp_cksum_trusted) {
+    const uint32_t local_address = config().flow().local_address;
+    if (local_address != 0 and ip_dgram.header().dst != local_address) {
+        return {};
+    }
 
-    // create an Internet Datagram and set its addresses and length
+    if (ip_dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return {};
+    }
+
+    TCPSegment tcp_seg;
+    if (ParseResult::NoError !=
+        tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(), not tcp_cksum_trusted)) {
+        return {};
+    }
+
+    flow.local_address = ip_dgram.header().dst;
+    flow.remote_address = ip_dgram.header().src;
+    flow.local_port = tcp_seg.header().dport;
+    flow.remote_port = tcp_seg.header().sport;
+    return tcp_seg;
+}
+
+//! \param[in] seg is the TCP segment to convert
+//! \param[in] flow is the flow the segment belongs to
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg, const TCPFlow &flow) {
     InternetDatagram ip_dgram;
-    ip_dgram.header().src = config().source.ipv4_numeric();
-    ip_dgram.header().dst = config().destination.ipv4_numeric();
-    ip_dgram.header().len = ip_dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    ip_dgram.header() = ip_header_for(seg, flow);
 
     // set payload, calculating TCP checksum using information from IP header
     ip_dgram.payload() = seg.serialize(ip_dgram.header().pseudo_cksum());
 
     return ip_dgram;
 }
+
+//! \param[in] seg is the TCP segment to send; its port numbers are set as necessary
+//! \param[in] flow is the flow the segment belongs to
+IPv4Header TCPOverIPv4Adapter::ip_header_for(TCPSegment &seg, const TCPFlow &flow) {
+    // set the port numbers in the TCP segment
+    seg.header().sport = flow.local_port;
+    seg.header().dport = flow.remote_port;
+
+    // set the addresses and length
+    IPv4Header ip_header;
+    ip_header.src = flow.local_address;
+    ip_header.dst = flow.remote_address;
+    ip_header.len = ip_header.hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    return ip_header;
+}
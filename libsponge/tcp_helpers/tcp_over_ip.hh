@@ -4,6 +4,7 @@
 #include "buffer.hh"
 #include "fd_adapter.hh"
 #include "ipv4_datagram.hh"
+#include "tcp_flow.hh"
 #include "tcp_segment.hh"
 
 #include <optional>
@@ -11,9 +12,25 @@
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase {
   public:
-    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram);
+    //! \brief Parse a TCP segment of the configured connection
+    //! \details `tcp_cksum_trusted` skips verifying the TCP checksum, which the device vouched for.
+    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram, const bool tcp_cksum_trusted = false);
 
     InternetDatagram wrap_tcp_in_ip(TCPSegment &seg);
+
+    //! Set the port numbers in `seg` and return the IPv4 header that should carry it
+    IPv4Header ip_header_for(TCPSegment &seg);
+
+    //! Parse a TCP segment addressed to this host, whatever connection it belongs to, and its flow
+    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                               TCPFlow &flow,
+                                               const bool tcp_cksum_trusted = false);
+
+    //! Set the port numbers in `seg` from `flow`, and wrap it in an IPv4 datagram
+    InternetDatagram wrap_tcp_in_ip(TCPSegment &seg, const TCPFlow &flow);
+
+    //! Set the port numbers in `seg` from `flow` and return the IPv4 header that should carry it
+    IPv4Header ip_header_for(TCPSegment &seg, const TCPFlow &flow);
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_OVER_IP_HH
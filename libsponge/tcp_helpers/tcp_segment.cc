@@ -3,17 +3,22 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <string>
+#include <utility>
 #include <variant>
 
 using namespace std;
 
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
-ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum) {
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(buffer);
-    if (check.value()) {
-        return ParseResult::BadChecksum;
+//! \param[in] verify_cksum is whether to verify the checksum
+ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum, const bool verify_cksum) {
+    if (verify_cksum) {
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(buffer);
+        if (check.value()) {
+            return ParseResult::BadChecksum;
+        }
     }
 
     NetParser p{buffer};
@@ -28,18 +33,38 @@ size_t TCPSegment::length_in_sequence_space() const {
 
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
 BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
-    TCPHeader header_out = _header;
-    header_out.cksum = 0;
+    auto [header_out, header_data] = Buffer::allocate(4 * _header.doff);
+    serialize_header_into(reinterpret_cast<uint8_t *>(header_data), datagram_layer_checksum);
 
-    // calculate checksum -- taken over entire segment
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
-    check.add(_payload);
-    header_out.cksum = check.value();
-
-    BufferList ret;
-    ret.append(header_out.serialize());
+    BufferList ret{move(header_out)};
     ret.append(_payload);
 
     return ret;
 }
+
+//! \param[out] dst receives the header
+//! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+uint8_t *TCPSegment::serialize_header_into(uint8_t *dst, const uint32_t datagram_layer_checksum) const {
+    uint8_t *end = _header.serialize_into(dst);
+    NetUnparser::u16(dst + TCPHeader::CKSUM_OFFSET, 0);
+
+    // calculate checksum -- taken over entire segment. The header is a whole number of 32-bit words,
+    // so a payload sum cached by cache_payload_sum() lines up and can seed the checksum directly.
+    const bool payload_summed = _payload_sum.has_value() and _payload.str().data() == _summed_payload.str().data() and
+                                _payload.size() == _summed_payload.size();
+    InternetChecksum check(datagram_layer_checksum + (payload_summed ? _payload_sum.value() : 0));
+    check.add({reinterpret_cast<const char *>(dst), size_t(end - dst)});
+    if (not payload_summed) {
+        check.add(_payload);
+    }
+    NetUnparser::u16(dst + TCPHeader::CKSUM_OFFSET, check.value());
+
+    return end;
+}
+
+void TCPSegment::cache_payload_sum() {
+    InternetChecksum check;
+    check.add(_payload);
+    _summed_payload = _payload;
+    _payload_sum = ~check.value();
+}
@@ -5,6 +5,7 @@
 #include "tcp_header.hh"
 
 #include <cstdint>
+#include <optional>
 
 //! \brief [TCP](\ref rfc::rfc793) segment
 class TCPSegment {
@@ -12,13 +13,27 @@ class TCPSegment {
     TCPHeader _header{};
     Buffer _payload{};
 
+    //! The payload that `_payload_sum` was computed over; holding it keeps its storage from being reused
+    Buffer _summed_payload{};
+    std::optional<uint16_t> _payload_sum{};  //!< Folded one's-complement sum of `_summed_payload`
+
   public:
     //! \brief Parse the segment from a string
-    ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
+    //! \details With `verify_cksum` false, the checksum is taken on trust (e.g. from a device that checked it).
+    ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0, const bool verify_cksum = true);
 
     //! \brief Serialize the segment to a string
     BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
 
+    //! \brief Serialize the header into `dst` (room for `4 * header().doff` bytes) with the checksum filled in
+    //! \returns the position just past the header
+    uint8_t *serialize_header_into(uint8_t *dst, const uint32_t datagram_layer_checksum = 0) const;
+
+    //! \brief Sum the payload now, so that serialize() only has to sum the header
+    //! \details The cached sum is used as long as payload() still refers to the same bytes, which makes
+    //! retransmissions and ackno/window rewrites cost a header-sized checksum.
+    void cache_payload_sum();
+
     //! \name Accessors
     //!@{
     const TCPHeader &header() const { return _header; }
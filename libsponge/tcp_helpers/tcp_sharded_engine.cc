@@ -0,0 +1,181 @@
+#include "tcp_sharded_engine.hh"
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace std;
+
+//! Length of the tuple that a flow's hash covers: two IPv4 addresses and two ports
+static constexpr size_t FLOW_TUPLE_SIZE = 12;
+
+//! \param[in] adapter is the shard's datagram adapter
+//! \param[in] backend is the EventLoop::Backend of the shard's engine
+//! \param[in] pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+template <typename AdaptT>
+TCPShardedEngine<AdaptT>::Shard::Shard(AdaptT &&adapter,
+                                       const EventLoop::Backend backend,
+                                       pair<FileDescriptor, FileDescriptor> pair)
+    : engine(move(adapter), backend), wakeup(move(pair.first)), thread_wakeup(move(pair.second)) {
+    thread_wakeup.set_blocking(false);
+}
+
+//! \param[in] shards is the number of shards (and of threads in run())
+//! \param[in] make_adapter makes the adapter of each shard
+//! \param[in] backend is the EventLoop::Backend of each shard's engine
+template <typename AdaptT>
+TCPShardedEngine<AdaptT>::TCPShardedEngine(const size_t shards,
+                                           const AdapterFactoryT &make_adapter,
+                                           const EventLoop::Backend backend)
+    : _hash(FLOW_TUPLE_SIZE) {
+    if (shards == 0) {
+        throw runtime_error("TCPShardedEngine: needs at least one shard");
+    }
+
+    for (size_t i = 0; i < INDIRECTION_SIZE; i++) {
+        _indirection[i] = i % shards;
+    }
+
+    for (size_t i = 0; i < shards; i++) {
+        _shards.push_back(make_unique<Shard>(make_adapter(i), backend, socket_pair_helper(SOCK_STREAM)));
+        Shard &shard = *_shards.back();
+
+        shard.engine.set_steering([this, i, &shard](const TCPFlow &flow, TCPSegment &seg) {
+            // only this shard's thread writes its counters, so they need no read-modify-write
+            shard.segments_read.store(shard.segments_read.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            const size_t owner = shard_of(flow);
+            if (owner == i) {
+                return false;
+            }
+            _steer(owner, flow, seg);
+            shard.segments_steered.store(shard.segments_steered.load(memory_order_relaxed) + 1,
+                                         memory_order_relaxed);
+            return true;
+        });
+        shard.engine.eventloop().add_rule(shard.thread_wakeup, Direction::In, [this, &shard] { _drain(shard); });
+    }
+}
+
+//! \details The tuple is hashed in the order of the arriving segments' headers, the remote end
+//! being their source; the transport may leave the local address 0, as long as it always does.
+//! \param[in] flow is the flow to find the shard of
+template <typename AdaptT>
+size_t TCPShardedEngine<AdaptT>::shard_of(const TCPFlow &flow) const {
+    const uint8_t tuple[FLOW_TUPLE_SIZE] = {uint8_t(flow.remote_address >> 24),
+                                            uint8_t(flow.remote_address >> 16),
+                                            uint8_t(flow.remote_address >> 8),
+                                            uint8_t(flow.remote_address),
+                                            uint8_t(flow.local_address >> 24),
+                                            uint8_t(flow.local_address >> 16),
+                                            uint8_t(flow.local_address >> 8),
+                                            uint8_t(flow.local_address),
+                                            uint8_t(flow.remote_port >> 8),
+                                            uint8_t(flow.remote_port),
+                                            uint8_t(flow.local_port >> 8),
+                                            uint8_t(flow.local_port)};
+    return _indirection[_hash(static_cast<const uint8_t *>(tuple)) % INDIRECTION_SIZE];
+}
+
+//! \details Buffers are not safe to share between threads, so the payload is copied.
+//! \param[in] to is the shard that owns `flow`
+//! \param[in] flow is the flow of the segment
+//! \param[in] seg is the segment
+template <typename AdaptT>
+void TCPShardedEngine<AdaptT>::_steer(const size_t to, const TCPFlow &flow, const TCPSegment &seg) {
+    TCPSegment copy;
+    copy.header() = seg.header();
+    copy.payload() = Buffer(seg.payload().copy());
+
+    Shard &shard = *_shards[to];
+    {
+        lock_guard<mutex> lock(shard.mutex);
+        shard.inbox.emplace_back(flow, move(copy));
+        if (shard.inbox.size() == 1) {
+            shard.wakeup.write("x");
+        }
+    }
+}
+
+//! \param[in] shard is the shard whose inbox to deliver, which must belong to the calling thread
+template <typename AdaptT>
+void TCPShardedEngine<AdaptT>::_drain(Shard &shard) {
+    vector<pair<TCPFlow, TCPSegment>> batch;
+    {
+        // the one wakeup byte is written and read under the lock, so none is lost or left over
+        lock_guard<mutex> lock(shard.mutex);
+        shard.thread_wakeup.read(1);
+        swap(batch, shard.inbox);
+    }
+
+    for (const auto &[flow, seg] : batch) {
+        shard.engine.segment_arrived(flow, seg);
+    }
+}
+
+//! \param[in] config is the configuration of passively opened connections
+//! \param[in] port is the local port to accept connections on
+//! \param[in] backlog is each shard's limit of both the SYN queue and the accept queue
+//! \param[in] syn_cookies is whether to answer SYNs with SYN cookies when a SYN queue is full
+template <typename AdaptT>
+void TCPShardedEngine<AdaptT>::listen(const TCPConfig &config,
+                                      const uint16_t port,
+                                      const size_t backlog,
+                                      const bool syn_cookies) {
+    for (auto &shard : _shards) {
+        shard->engine.listen(config, port, backlog, syn_cookies);
+    }
+}
+
+//! \param[in] main is run on each shard's thread with the index and engine of the shard
+template <typename AdaptT>
+void TCPShardedEngine<AdaptT>::run(const ShardMainT &main) {
+    mutex error_mutex;
+    exception_ptr error;
+
+    vector<thread> threads;
+    for (size_t i = 0; i < _shards.size(); i++) {
+        threads.emplace_back([&, i] {
+            try {
+                main(i, _shards[i]->engine);
+            } catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (not error) {
+                    error = current_exception();
+                }
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+template <typename AdaptT>
+uint64_t TCPShardedEngine<AdaptT>::segments_read() const {
+    uint64_t ret = 0;
+    for (const auto &shard : _shards) {
+        ret += shard->segments_read.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+template <typename AdaptT>
+uint64_t TCPShardedEngine<AdaptT>::segments_steered() const {
+    uint64_t ret = 0;
+    for (const auto &shard : _shards) {
+        ret += shard->segments_steered.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+//! Specialization of TCPShardedEngine for TCPOverUDPSocketAdapter
+template class TCPShardedEngine<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPShardedEngine for TCPOverIPv4OverTunFdAdapter
+template class TCPShardedEngine<TCPOverIPv4OverTunFdAdapter>;
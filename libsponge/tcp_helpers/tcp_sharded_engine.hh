@@ -0,0 +1,128 @@
+#ifndef SPONGE_LIBSPONGE_TCP_SHARDED_ENGINE_HH
+#define SPONGE_LIBSPONGE_TCP_SHARDED_ENGINE_HH
+
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_engine.hh"
+#include "tcp_flow.hh"
+#include "tcp_segment.hh"
+#include "toeplitz_hash.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//! \brief Spreads connections over several TCPEngines, one per thread, by a Toeplitz hash of their flow
+template <typename AdaptT>
+class TCPShardedEngine {
+  public:
+    using EngineT = TCPEngine<AdaptT>;
+
+    //! Makes the adapter of the shard it is given the index of
+    using AdapterFactoryT = std::function<AdaptT(size_t)>;
+
+    //! Runs on the thread of the shard it is given the index of, and drives that shard's engine
+    using ShardMainT = std::function<void(size_t, EngineT &)>;
+
+    //! Entries in the table that maps the low bits of a flow's hash to a shard (as in NIC RSS)
+    static constexpr size_t INDIRECTION_SIZE = 128;
+
+  private:
+    //! One engine, and the segments that other shards read for its flows
+    struct Shard {
+        EngineT engine;                   //!< Owns the connections of the flows that hash to this shard
+        LocalStreamSocket wakeup;         //!< Other shards' end of a socket pair that wakes this shard
+        LocalStreamSocket thread_wakeup;  //!< This shard's end of the same socket pair
+        std::mutex mutex{};               //!< Guards `inbox` and writes to `wakeup`
+        std::vector<std::pair<TCPFlow, TCPSegment>> inbox{};  //!< Segments steered here, not yet delivered
+
+        //! \name Counters, written only by the shard's own thread
+        //!@{
+        std::atomic<uint64_t> segments_read{0};     //!< Segments read from the shard's adapter
+        std::atomic<uint64_t> segments_steered{0};  //!< Of those, segments steered to another shard
+        //!@}
+
+        Shard(AdaptT &&adapter, const EventLoop::Backend backend, std::pair<FileDescriptor, FileDescriptor> pair);
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards{};  //!< The shards, each driven by its own thread in run()
+
+    //! Hashes the (source address, destination address, source port, destination port) of arriving segments
+    ToeplitzHash _hash;
+
+    std::array<size_t, INDIRECTION_SIZE> _indirection{};  //!< Shard of each value of the hash's low bits
+
+    //! Hand a copy of a segment to the shard `to`, and wake it if its inbox was empty
+    void _steer(const size_t to, const TCPFlow &flow, const TCPSegment &seg);
+
+    //! Deliver the segments in a shard's inbox to its engine (on the shard's thread)
+    void _drain(Shard &shard);
+
+  public:
+    //! \brief Construct `shards` engines, the adapter of each made by `make_adapter`
+    //! \details Each adapter may receive segments of any flow (e.g. UDP sockets sharing a port with
+    //! SO_REUSEPORT); a segment read by a shard other than shard_of() its flow is steered to that shard.
+    TCPShardedEngine(const size_t shards,
+                     const AdapterFactoryT &make_adapter,
+                     const EventLoop::Backend backend = EventLoop::Backend::Epoll);
+
+    //! Number of shards
+    size_t shard_count() const { return _shards.size(); }
+
+    //! \brief The shard that owns `flow`
+    //! \details TCPEngine::connect must be called on that shard's engine, from its thread.
+    size_t shard_of(const TCPFlow &flow) const;
+
+    //! The engine of a shard; use it only from that shard's thread once run() has started
+    EngineT &engine(const size_t shard) { return _shards.at(shard)->engine; }
+
+    //! Make every shard accept connections to `port` (see TCPEngine::listen); call before run()
+    void listen(const TCPConfig &config,
+                const uint16_t port,
+                const size_t backlog = EngineT::DEFAULT_BACKLOG,
+                const bool syn_cookies = true);
+
+    //! \brief Run `main` on one thread per shard, and return once every thread has returned
+    //! \details If any of them throws, the first exception is rethrown once the others have returned.
+    void run(const ShardMainT &main);
+
+    //! Number of segments read from the adapters so far
+    uint64_t segments_read() const;
+
+    //! Number of segments read by one shard and steered to another so far
+    uint64_t segments_steered() const;
+
+    //! \name
+    //! Shards point at the engine, so it cannot be moved or copied
+
+    //!@{
+    TCPShardedEngine(const TCPShardedEngine &) = delete;
+    TCPShardedEngine(TCPShardedEngine &&) = delete;
+    TCPShardedEngine &operator=(const TCPShardedEngine &) = delete;
+    TCPShardedEngine &operator=(TCPShardedEngine &&) = delete;
+    ~TCPShardedEngine() = default;
+    //!@}
+};
+
+using TCPOverUDPShardedEngine = TCPShardedEngine<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4ShardedEngine = TCPShardedEngine<TCPOverIPv4OverTunFdAdapter>;
+
+//! \class TCPShardedEngine
+//! Each shard is a TCPEngine with its own thread, EventLoop, connection table and timers, and every
+//! connection lives on exactly one shard, so no TCPConnection, ByteStream or timer is shared
+//! between threads and none needs a lock.
+//!
+//! A flow belongs to the shard that the Toeplitz hash of its tuple selects through an indirection
+//! table, as a NIC does with receive-side scaling. Every shard reads from its own adapter; when the
+//! transport delivers a segment to the wrong shard (the kernel spreads SO_REUSEPORT sockets by its own
+//! hash), the shard copies it into the owner's inbox. Only those hand-offs touch a lock.
+
+#endif  // SPONGE_LIBSPONGE_TCP_SHARDED_ENGINE_HH
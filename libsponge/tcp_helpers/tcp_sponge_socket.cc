@@ -2,9 +2,11 @@
 
 #include "network_interface.hh"
 #include "parser.hh"
+#include "socket.hh"
 #include "tun.hh"
 #include "util.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <exception>
 #include <iostream>
@@ -18,41 +20,74 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! \details Called before the TCPConnection is handed a segment or bytes from the owner, as well as
+//! after each wait, so that the time spent waiting for the event is accounted for before the event
+//! (e.g. before an acknowledgment is timed, or a segment resets the linger timer).
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_advance_time() {
+    const uint64_t now = timestamp_ms();
+    if (_tcp.value().active() and now > _last_tick) {
+        _tcp.value().tick(now - _last_tick);
+        _datagram_adapter.tick(now - _last_tick);
+    }
+    _last_tick = now;
+}
 
 //! \param[in] condition is a function returning true if loop should continue
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()> &condition) {
-    auto base_time = timestamp_ms();
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        // while the TCPConnection is active, sleep until it or the adapter next needs time to pass (a
+        // retransmission, the end of lingering, an ARP entry expiring); with neither, sleep until an
+        // event (an abort writes to _wakeup); once the TCPConnection is inactive, let the event loop exit
+        optional<uint64_t> until_deadline{_tcp.value().time_until_next_deadline()};
+        const optional<uint64_t> until_adapter_tick = _datagram_adapter.time_until_next_tick();
+        if (until_adapter_tick and (not until_deadline or until_adapter_tick.value() < until_deadline.value())) {
+            until_deadline = until_adapter_tick;
+        }
+        if (_tcp.value().active() and until_deadline) {
+            const uint64_t deadline = _last_tick + until_deadline.value();
+            if (not _tick_timer or deadline != _tick_deadline) {
+                if (_tick_timer) {
+                    _eventloop.cancel_timer(_tick_timer.value());
+                }
+                _tick_timer = _eventloop.add_timer(deadline, [&] { _tick_timer.reset(); });
+                _tick_deadline = deadline;
+            }
+        } else if (_tick_timer) {
+            _eventloop.cancel_timer(_tick_timer.value());
+            _tick_timer.reset();
+        }
+
+        auto ret = _eventloop.wait_next_event(-1);
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
 
-        if (_tcp.value().active()) {
-            const auto next_time = timestamp_ms();
-            _tcp.value().tick(next_time - base_time);
-            _datagram_adapter.tick(next_time - base_time);
-            base_time = next_time;
-        }
+        _advance_time();
     }
 }
 
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+//! \param[in] wakeup_pair is another such pair, for the owner to wake the TCP thread
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
 template <typename AdaptT>
 TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> data_socket_pair,
+                                         pair<FileDescriptor, FileDescriptor> wakeup_pair,
                                          AdaptT &&datagram_interface)
     : LocalStreamSocket(move(data_socket_pair.first))
     , _thread_data(move(data_socket_pair.second))
+    , _wakeup(move(wakeup_pair.first))
+    , _thread_wakeup(move(wakeup_pair.second))
     , _datagram_adapter(move(datagram_interface)) {
     _thread_data.set_blocking(false);
+    _thread_wakeup.set_blocking(false);
 }
 
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _tcp.emplace(config);
+    _last_tick = timestamp_ms();
 
     // Set up the event loop
 
@@ -71,20 +106,27 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     //
     // 4) Outbound segment generated by TCP (needs to be
     //    given to underlying datagram socket)
+    //
+    // and a fifth, the owner waking the thread to abort it (see ~TCPSpongeSocket)
 
     // rule 1: read from filtered packet stream and dump into TCPConnection
     _eventloop.add_rule(_datagram_adapter,
                         Direction::In,
                         [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
-                            }
+                            _advance_time();
+
+                            // one read may receive several datagrams: take them all while the fd is ready
+                            do {
+                                auto seg = _datagram_adapter.read();
+                                if (seg) {
+                                    _tcp->segment_received(move(seg.value()));
+                                }
+                            } while (_datagram_adapter.pending_reads() and _tcp->active());
 
                             // debugging output:
                             if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
                                 cerr << "DEBUG: Outbound stream to "
-                                     << _datagram_adapter.config().destination.to_string()
+                                     << _datagram_adapter.config().destination().to_string()
                                      << " has been fully acknowledged.\n";
                                 _fully_acked = true;
                             }
@@ -96,11 +138,17 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
         _thread_data,
         Direction::In,
         [&] {
-            const auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
-            const auto len = data.size();
-            const auto amount_written = _tcp->write(move(data));
-            if (amount_written != len) {
-                throw runtime_error("TCPConnection::write() accepted less than advertised length");
+            _advance_time();
+
+            ByteStream &outbound = _tcp->outbound_stream();
+            if (outbound.storage() == ByteStream::Storage::Ring) {
+                // read straight into the free space of the outbound stream
+                const auto [buf, len] = outbound.writable_span();
+                outbound.commit(_thread_data.read(buf, len));
+                _tcp->flush();
+            } else {
+                // a chunked stream has no free space to read into: hand it what is read as a Buffer
+                _tcp->write(Buffer(_thread_data.read(outbound.remaining_capacity())));
             }
 
             if (_thread_data.eof()) {
@@ -108,7 +156,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                 _outbound_shutdown = true;
 
                 // debugging output:
-                cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+                cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination().to_string()
                      << " finished (" << _tcp.value().bytes_in_flight() << " byte"
                      << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
             }
@@ -128,9 +176,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
             // Write from the inbound_stream into
             // the pipe, handling the possibility of a partial
             // write (i.e., only pop what was actually written).
-            const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
-            const std::string buffer = inbound.peek_output(amount_to_write);
-            const auto bytes_written = _thread_data.write(move(buffer), false);
+            const auto bytes_written = _thread_data.write(inbound.readable_spans(), false);
             inbound.pop_output(bytes_written);
 
             if (inbound.eof() or inbound.error()) {
@@ -138,7 +184,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                 _inbound_shutdown = true;
 
                 // debugging output:
-                cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination.to_string()
+                cerr << "DEBUG: Inbound stream from " << _datagram_adapter.config().destination().to_string()
                      << " finished " << (inbound.error() ? "with an error/reset.\n" : "cleanly.\n");
                 if (_tcp.value().state() == TCPState::State::TIME_WAIT) {
                     cerr << "DEBUG: Waiting for lingering segments (e.g. retransmissions of FIN) from peer...\n";
@@ -148,9 +194,10 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
         [&] {
             return (not _tcp->inbound_stream().buffer_empty()) or
                    ((_tcp->inbound_stream().eof() or _tcp->inbound_stream().error()) and not _inbound_shutdown);
-        });
+        },
+        [&] { _inbound_shutdown = true; });
 
-    // rule 4: read outbound segments from TCPConnection and send as datagrams
+    // rule 4: read outbound segments from TCPConnection and send as datagrams (batched by the adapter)
     _eventloop.add_rule(_datagram_adapter,
                         Direction::Out,
                         [&] {
@@ -158,23 +205,22 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                                 _datagram_adapter.write(_tcp->segments_out().front());
                                 _tcp->segments_out().pop();
                             }
+                            _datagram_adapter.flush();
                         },
                         [&] { return not _tcp->segments_out().empty(); });
-}
 
-//! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
-//! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
-//! \returns a std::pair of connected sockets
-static inline pair<FileDescriptor, FileDescriptor> socket_pair_helper(const int type) {
-    int fds[2];
-    SystemCall("socketpair", ::socketpair(AF_UNIX, type, 0, static_cast<int *>(fds)));
-    return {FileDescriptor(fds[0]), FileDescriptor(fds[1])};
+    // rule 5: wake up when the owner aborts; only while another rule may still be interested, so that
+    // the event loop exits once the connection is over and its inbound stream delivered
+    _eventloop.add_rule(_thread_wakeup,
+                        Direction::In,
+                        [&] { _thread_wakeup.read(1); },
+                        [&] { return _tcp->active() or not _inbound_shutdown; });
 }
 
 //! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
 template <typename AdaptT>
 TCPSpongeSocket<AdaptT>::TCPSpongeSocket(AdaptT &&datagram_interface)
-    : TCPSpongeSocket(socket_pair_helper(SOCK_STREAM), move(datagram_interface)) {}
+    : TCPSpongeSocket(socket_pair_helper(SOCK_STREAM), socket_pair_helper(SOCK_STREAM), move(datagram_interface)) {}
 
 template <typename AdaptT>
 TCPSpongeSocket<AdaptT>::~TCPSpongeSocket() {
@@ -183,6 +229,7 @@ TCPSpongeSocket<AdaptT>::~TCPSpongeSocket() {
             cerr << "Warning: unclean shutdown of TCPSpongeSocket\n";
             // force the other side to exit
             _abort.store(true);
+            _wakeup.write("x");
             _tcp_thread.join();
         }
     } catch (const exception &e) {
@@ -212,7 +259,7 @@ void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterCon
 
     _datagram_adapter.config_mut() = c_ad;
 
-    cerr << "DEBUG: Connecting to " << c_ad.destination.to_string() << "... ";
+    cerr << "DEBUG: Connecting to " << c_ad.destination().to_string() << "... ";
     _tcp->connect();
 
     const TCPState expected_state = TCPState::State::SYN_SENT;
@@ -246,7 +293,7 @@ void TCPSpongeSocket<AdaptT>::listen_and_accept(const TCPConfig &c_tcp, const Fd
         const auto s = _tcp->state();
         return (s == TCPState::State::LISTEN or s == TCPState::State::SYN_RCVD or s == TCPState::State::SYN_SENT);
     });
-    cerr << "new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
+    cerr << "new connection from " << _datagram_adapter.config().destination().to_string() << ".\n";
 
     _tcp_thread = thread(&TCPSpongeSocket::_tcp_main, this);
 }
@@ -285,15 +332,164 @@ template class TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 //! Specialization of TCPSpongeSocket for LossyTCPOverIPv4OverTunFdAdapter
 template class TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
 
+//! \param[in] wakeup_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
+//! \param[in] datagram_interface is the interface for reading and writing datagrams
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::TCPSpongeListener(pair<FileDescriptor, FileDescriptor> wakeup_pair,
+                                             AdaptT &&datagram_interface)
+    : _engine(move(datagram_interface))
+    , _wakeup(move(wakeup_pair.first))
+    , _thread_wakeup(move(wakeup_pair.second)) {
+    _thread_wakeup.set_blocking(false);
+}
+
+//! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::TCPSpongeListener(AdaptT &&datagram_interface)
+    : TCPSpongeListener(socket_pair_helper(SOCK_STREAM), move(datagram_interface)) {}
+
+template <typename AdaptT>
+TCPSpongeListener<AdaptT>::~TCPSpongeListener() {
+    try {
+        if (_thread.joinable()) {
+            _abort.store(true);
+            _wakeup.write("x");
+            _thread.join();
+        }
+    } catch (const exception &e) {
+        cerr << "Exception destructing TCPSpongeListener: " << e.what() << endl;
+    }
+}
+
+//! \param[in] c_tcp is the TCPConfig for each accepted TCPConnection
+//! \param[in] c_ad is the FdAdapterConfig for the FdAdapter; its source port is the listening port
+//! \param[in] backlog is the limit of the SYN queue and of the accept queue
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::listen(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad, const size_t backlog) {
+    if (_thread.joinable()) {
+        throw runtime_error("TCPSpongeListener::listen() called twice");
+    }
+
+    _engine.adapter().config_mut() = c_ad;
+    _engine.listen(c_tcp, c_ad.source().port(), backlog);
+    _engine.on_removed([&](const uint64_t id) {
+        // closing the socket tells the owner that the connection is over, and retires its rules
+        const auto bridge = _bridges.find(id);
+        if (bridge != _bridges.end()) {
+            bridge->second->thread_data.close();
+            _bridges.erase(bridge);
+        }
+    });
+
+    _thread = thread(&TCPSpongeListener::_main, this);
+}
+
+template <typename AdaptT>
+LocalStreamSocket TCPSpongeListener<AdaptT>::accept() {
+    unique_lock<mutex> lock(_mutex);
+    _accepted_ready.wait(lock, [&] { return not _accepted.empty(); });
+    LocalStreamSocket socket = move(_accepted.front());
+    _accepted.pop();
+    return socket;
+}
+
+//! \param[in] stream is the newly accepted connection
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_bridge(const StreamT &stream) {
+    auto [owner_data, thread_data] = socket_pair_helper(SOCK_STREAM);
+    auto new_bridge = make_unique<Bridge>(Bridge{stream, LocalStreamSocket(move(thread_data))});
+    Bridge &bridge = *_bridges.emplace(stream.id(), move(new_bridge)).first->second;
+    bridge.thread_data.set_blocking(false);
+
+    // the rules only look at the connection through a const Stream, so that evaluating their
+    // interest does not count as using it (which would make the engine service it again)
+    const StreamT &peek = bridge.stream;
+    EventLoop &eventloop = _engine.eventloop();
+
+    // read from the owner's writes into the outbound stream
+    eventloop.add_rule(
+        bridge.thread_data,
+        Direction::In,
+        [&bridge] {
+            const string data = bridge.thread_data.read(as_const(bridge.stream).remaining_outbound_capacity());
+            if (not data.empty()) {
+                bridge.stream.write(data);
+            }
+            if (bridge.thread_data.eof()) {
+                bridge.stream.end_input_stream();
+                bridge.outbound_shutdown = true;
+            }
+        },
+        [&bridge, &peek] {
+            return peek.active() and not bridge.outbound_shutdown and peek.remaining_outbound_capacity() > 0;
+        },
+        [] {},
+        stream.group());
+
+    // write from the inbound stream to the owner
+    eventloop.add_rule(
+        bridge.thread_data,
+        Direction::Out,
+        [&bridge] {
+            ByteStream &inbound = bridge.stream.inbound_stream();
+            inbound.pop_output(bridge.thread_data.write(inbound.readable_spans(), false));
+            if (inbound.eof() or inbound.error()) {
+                bridge.thread_data.shutdown(SHUT_WR);
+                bridge.inbound_shutdown = true;
+            }
+        },
+        [&bridge, &peek] {
+            if (not peek.valid()) {
+                return false;
+            }
+            const ByteStream &inbound = peek.inbound_stream();
+            return (not inbound.buffer_empty()) or
+                   ((inbound.eof() or inbound.error()) and not bridge.inbound_shutdown);
+        },
+        [] {},
+        stream.group());
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        _accepted.emplace(move(owner_data));
+    }
+    _accepted_ready.notify_one();
+}
+
+template <typename AdaptT>
+void TCPSpongeListener<AdaptT>::_main() {
+    try {
+        _engine.eventloop().add_rule(_thread_wakeup, Direction::In, [&] { _thread_wakeup.read(1); });
+        while (not _abort) {
+            _engine.wait_next_event(-1);
+            while (auto stream = _engine.accept()) {
+                _bridge(stream.value());
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in TCPSpongeListener thread: " << e.what() << "\n";
+    }
+}
+
+//! Specialization of TCPSpongeListener for TCPOverUDPSocketAdapter
+template class TCPSpongeListener<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPSpongeListener for TCPOverIPv4OverTunFdAdapter
+template class TCPSpongeListener<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialization of TCPSpongeListener for TCPOverIPv4OverEthernetAdapter
+template class TCPSpongeListener<TCPOverIPv4OverEthernetAdapter>;
+
 CS144TCPSocket::CS144TCPSocket() : TCPOverIPv4SpongeSocket(TCPOverIPv4OverTunFdAdapter(TunFD("tun144"))) {}
 
 void CS144TCPSocket::connect(const Address &address) {
     TCPConfig tcp_config;
-    tcp_config.rt_timeout = 100;
+    tcp_config.adaptive_rto = RTOBounds{};
+    tcp_config.sack = true;
 
     FdAdapterConfig multiplexer_config;
-    multiplexer_config.source = {"169.254.144.9", to_string(uint16_t(random_device()()))};
-    multiplexer_config.destination = address;
+    multiplexer_config.set_source({"169.254.144.9", to_string(uint16_t(random_device()()))});
+    multiplexer_config.set_destination(address);
 
     TCPOverIPv4SpongeSocket::connect(tcp_config, multiplexer_config);
 }
@@ -320,11 +516,12 @@ FullStackSocket::FullStackSocket()
 
 void FullStackSocket::connect(const Address &address) {
     TCPConfig tcp_config;
-    tcp_config.rt_timeout = 100;
+    tcp_config.adaptive_rto = RTOBounds{};
+    tcp_config.sack = true;
 
     FdAdapterConfig multiplexer_config;
-    multiplexer_config.source = {LOCAL_TAP_IP_ADDRESS, to_string(uint16_t(random_device()()))};
-    multiplexer_config.destination = address;
+    multiplexer_config.set_source({LOCAL_TAP_IP_ADDRESS, to_string(uint16_t(random_device()()))});
+    multiplexer_config.set_destination(address);
 
     TCPOverIPv4OverEthernetSpongeSocket::connect(tcp_config, multiplexer_config);
 }
@@ -8,12 +8,18 @@
 #include "network_interface.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
+#include "tcp_engine.hh"
 #include "tuntap_adapter.hh"
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 //! Multithreaded wrapper around TCPConnection that approximates the Unix sockets API
@@ -23,6 +29,9 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Stream socket for reads and writes between owner and TCP thread
     LocalStreamSocket _thread_data;
 
+    LocalStreamSocket _wakeup;         //!< Owner's end of a socket pair that interrupts the TCP thread
+    LocalStreamSocket _thread_wakeup;  //!< TCP thread's end of the same socket pair
+
     //! Adapter to underlying datagram socket (e.g., UDP or IP)
     AdaptT _datagram_adapter;
 
@@ -35,6 +44,16 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
     EventLoop _eventloop{};
 
+    //! Timer that wakes the event loop when the TCPConnection next needs to tick, and its deadline
+    std::optional<EventLoop::TimerIdT> _tick_timer{};
+    uint64_t _tick_deadline = 0;
+
+    //! Time at which the TCPConnection and the adapter were last ticked, in ms
+    uint64_t _last_tick = 0;
+
+    //! Tick the TCPConnection and the adapter with the time since `_last_tick`
+    void _advance_time();
+
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
 
@@ -44,8 +63,10 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Handle to the TCPConnection thread; owner thread calls join() in the destructor
     std::thread _tcp_thread{};
 
-    //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-    TCPSpongeSocket(std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT &&datagram_interface);
+    //! Construct LocalStreamSocket fds from socket pairs for the data and for waking the TCP thread
+    TCPSpongeSocket(std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
+                    std::pair<FileDescriptor, FileDescriptor> wakeup_pair,
+                    AdaptT &&datagram_interface);
 
     std::atomic_bool _abort{false};  //!< Flag used by the owner to force the TCPConnection thread to shut down
 
@@ -121,6 +142,82 @@ using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAd
 //! - if TCPSpongeSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
 
+//! A listening socket that accepts many connections on one port, all served by one TCPEngine thread
+template <typename AdaptT>
+class TCPSpongeListener {
+  private:
+    using StreamT = typename TCPEngine<AdaptT>::Stream;
+
+    //! Carries the bytes of one accepted connection between its Stream and the owner's socket
+    struct Bridge {
+        StreamT stream;                  //!< The connection
+        LocalStreamSocket thread_data;   //!< Engine thread's end of the socket pair given to the owner
+        bool inbound_shutdown = false;   //!< Has the inbound stream been shut down towards the owner?
+        bool outbound_shutdown = false;  //!< Has the owner shut down the outbound stream?
+    };
+
+    //! Serves every connection; used only by the engine thread once listen() has started it
+    TCPEngine<AdaptT> _engine;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Bridge>> _bridges{};  //!< Bridges by connection id
+
+    LocalStreamSocket _wakeup;         //!< Owner's end of a socket pair that interrupts the engine thread
+    LocalStreamSocket _thread_wakeup;  //!< Engine thread's end of the same socket pair
+
+    std::mutex _mutex{};                         //!< Guards _accepted
+    std::condition_variable _accepted_ready{};   //!< Signaled when a connection is added to _accepted
+    std::queue<LocalStreamSocket> _accepted{};   //!< Owner's ends of connections not yet taken by accept()
+
+    std::atomic_bool _abort{false};  //!< Flag used by the owner to stop the engine thread
+    std::thread _thread{};           //!< Runs the engine
+
+    //! Construct from a socket pair for waking the engine thread and the datagram interface
+    TCPSpongeListener(std::pair<FileDescriptor, FileDescriptor> wakeup_pair, AdaptT &&datagram_interface);
+
+    //! Give an accepted connection a socket pair, and queue the owner's end for accept()
+    void _bridge(const StreamT &stream);
+
+    //! Main loop of the engine thread
+    void _main();
+
+  public:
+    //! Construct from the interface that the engine thread will use to read and write datagrams
+    explicit TCPSpongeListener(AdaptT &&datagram_interface);
+
+    //! \brief Start accepting connections to the port of `c_ad.source()`, each configured with `c_tcp`
+    //! \param[in] backlog limits the half-open connections and those not yet accepted (see TCPEngine::listen)
+    void listen(const TCPConfig &c_tcp,
+                const FdAdapterConfig &c_ad,
+                const size_t backlog = TCPEngine<AdaptT>::DEFAULT_BACKLOG);
+
+    //! Block until a connection is established, and return a socket for reading and writing it
+    LocalStreamSocket accept();
+
+    //! Stop the engine thread; connections that are still open are abandoned
+    ~TCPSpongeListener();
+
+    //! \name
+    //! This object cannot be safely moved or copied, since it is in use by two threads simultaneously
+
+    //!@{
+    TCPSpongeListener(const TCPSpongeListener &) = delete;
+    TCPSpongeListener(TCPSpongeListener &&) = delete;
+    TCPSpongeListener &operator=(const TCPSpongeListener &) = delete;
+    TCPSpongeListener &operator=(TCPSpongeListener &&) = delete;
+    //!@}
+};
+
+using TCPOverUDPSpongeListener = TCPSpongeListener<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4SpongeListener = TCPSpongeListener<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverIPv4OverEthernetSpongeListener = TCPSpongeListener<TCPOverIPv4OverEthernetAdapter>;
+
+//! \class TCPSpongeListener
+//! Where TCPSpongeSocket::listen_and_accept gives a single connection a thread of its own, a
+//! TCPSpongeListener runs a listening TCPEngine on one thread, with a SYN queue, an accept queue and
+//! SYN cookies. Each connection it accepts is handed to the owner as the end of a socket pair, which
+//! the owner reads and writes like a TCPSpongeSocket; the engine thread copies bytes between the
+//! other end and the connection's Stream.
+
 //! Helper class that makes a TCPOverIPv4SpongeSocket behave more like a (kernel) TCPSocket
 class CS144TCPSocket : public TCPOverIPv4SpongeSocket {
   public:
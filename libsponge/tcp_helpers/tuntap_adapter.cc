@@ -1,7 +1,168 @@
 #include "tuntap_adapter.hh"
 
+#include "parser.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstring>
+
 using namespace std;
 
+//! \param[in] fd is the device to read a batch from, if the last one has been handed out
+optional<Buffer> TunTapReadBatch::next(TunTapFD &fd) {
+    if (_next == _count) {
+        _count = fd.read_batch(_packets.data(), BATCH_SIZE);
+        _next = 0;
+        if (_count == 0) {
+            return {};
+        }
+    }
+    return move(_packets[_next++]);
+}
+
+//! \details A virtio-net header that says the checksum is done (DATA_VALID), or left for the
+//! kernel to do (NEEDS_CSUM: the datagram came from this host), vouches for the TCP checksum.
+optional<InternetDatagram> TCPOverIPv4OverTunFdAdapter::_next_datagram(bool &tcp_cksum_trusted) {
+    auto packet = _batch.next(_tun);
+    if (not packet) {
+        return {};
+    }
+
+    tcp_cksum_trusted = false;
+    if (_tun.vnet_hdr()) {
+        TunTapFD::VnetHeader vnet_header{};
+        if (packet->size() < sizeof(vnet_header)) {
+            return {};
+        }
+        memcpy(&vnet_header, packet->str().data(), sizeof(vnet_header));
+        tcp_cksum_trusted = vnet_header.flags & (vnet_header.F_NEEDS_CSUM | vnet_header.F_DATA_VALID);
+        packet->remove_prefix(sizeof(vnet_header));
+    }
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(move(packet.value())) != ParseResult::NoError) {
+        return {};
+    }
+    return ip_dgram;
+}
+
+//! \param[in] ip_header is the IPv4 header to carry `seg`
+//! \param[in] seg is the TCP segment to send
+void TCPOverIPv4OverTunFdAdapter::_write(const IPv4Header &ip_header, TCPSegment &seg) {
+    if (not _tun.vnet_hdr()) {
+        _tun.write(_builder.tcp_in_ipv4(ip_header, seg));
+        return;
+    }
+
+    _send_queue.emplace_back(ip_header, seg);
+    if (_send_queue.size() >= MAX_QUEUED_SEGMENTS) {
+        flush();
+    }
+}
+
+//! \returns whether `next` can join the TSO run that starts with `first` and (so far) ends with
+//! `last`, and carries `run_payload` bytes: the kernel will give each segment cut from the run
+//! the first's header, with the sequence number advanced, and the FIN and PSH flags of the last.
+static bool continues_run(const pair<IPv4Header, TCPSegment> &first,
+                          const pair<IPv4Header, TCPSegment> &last,
+                          const pair<IPv4Header, TCPSegment> &next,
+                          const size_t run_payload) {
+    const TCPHeader &first_header = first.second.header();
+    const TCPHeader &last_header = last.second.header();
+    const TCPHeader &next_header = next.second.header();
+    const size_t segment_size = first.second.payload().size();
+    const size_t next_size = next.second.payload().size();
+
+    // only the last segment of a run may be short, or carry FIN or PSH
+    if (segment_size == 0 or last.second.payload().size() != segment_size or last_header.fin or last_header.psh) {
+        return false;
+    }
+    if (next_size == 0 or next_size > segment_size or
+        run_payload + next_size > TCPOverIPv4OverTunFdAdapter::MAX_TSO_PAYLOAD) {
+        return false;
+    }
+    if (first_header.syn or first_header.rst or first_header.urg or next_header.syn or next_header.rst or
+        next_header.urg) {
+        return false;
+    }
+
+    // everything else must be what the kernel will copy from the first header
+    return next_header.seqno == last_header.seqno + uint32_t(segment_size) and next.first.src == first.first.src and
+           next.first.dst == first.first.dst and next_header.sport == first_header.sport and
+           next_header.dport == first_header.dport and next_header.ack == first_header.ack and
+           next_header.ackno == first_header.ackno and next_header.win == first_header.win and
+           next_header.doff == first_header.doff and next_header.sack_count == first_header.sack_count and
+           equal(first_header.sack.begin(), first_header.sack.begin() + first_header.sack_count,
+                 next_header.sack.begin());
+}
+
+void TCPOverIPv4OverTunFdAdapter::flush() {
+    size_t first = 0;
+    try {
+        while (first < _send_queue.size()) {
+            size_t last = first + 1;
+            size_t run_payload = _send_queue[first].second.payload().size();
+            while (last < _send_queue.size() and
+                   continues_run(_send_queue[first], _send_queue[last - 1], _send_queue[last], run_payload)) {
+                run_payload += _send_queue[last].second.payload().size();
+                last++;
+            }
+            _send_run(first, last);
+            first = last;
+        }
+    } catch (...) {
+        _send_queue.clear();
+        throw;
+    }
+    _send_queue.clear();
+}
+
+//! \details The TCP checksum field carries only the pseudo-header's sum, for the kernel to finish
+//! (NEEDS_CSUM) in each segment it cuts from the run.
+//! \param[in] first is the index of the run's first segment in `_send_queue`
+//! \param[in] last is the index just past the run's last segment
+void TCPOverIPv4OverTunFdAdapter::_send_run(const size_t first, const size_t last) {
+    const TCPSegment &first_seg = _send_queue[first].second;
+    const TCPSegment &last_seg = _send_queue[last - 1].second;
+    const size_t tcp_header_length = 4 * first_seg.header().doff;
+    size_t payload_length = 0;
+    for (size_t i = first; i < last; i++) {
+        payload_length += _send_queue[i].second.payload().size();
+    }
+
+    IPv4Header ip_header = _send_queue[first].first;
+    ip_header.len = 4 * ip_header.hlen + tcp_header_length + payload_length;
+    TCPHeader tcp_header = first_seg.header();
+    tcp_header.fin = last_seg.header().fin;
+    tcp_header.psh = last_seg.header().psh;
+
+    TunTapFD::VnetHeader vnet_header{};
+    vnet_header.flags = vnet_header.F_NEEDS_CSUM;
+    vnet_header.csum_start = 4 * ip_header.hlen;
+    vnet_header.csum_offset = TCPHeader::CKSUM_OFFSET;
+    if (last - first > 1) {
+        vnet_header.gso_type = vnet_header.GSO_TCPV4;
+        vnet_header.gso_size = first_seg.payload().size();
+        vnet_header.hdr_len = 4 * ip_header.hlen + tcp_header_length;
+    }
+
+    auto [headers, data] = Buffer::allocate(sizeof(vnet_header) + 4 * ip_header.hlen + tcp_header_length);
+    uint8_t *const ip_start = reinterpret_cast<uint8_t *>(data) + sizeof(vnet_header);
+    memcpy(data, &vnet_header, sizeof(vnet_header));
+    uint8_t *const tcp_start = ip_header.serialize_into_with_cksum(ip_start);
+    tcp_header.serialize_into(tcp_start);
+    const uint16_t pseudo_header_sum = ~InternetChecksum(ip_header.pseudo_cksum()).value();
+    NetUnparser::u16(tcp_start + TCPHeader::CKSUM_OFFSET, pseudo_header_sum);
+
+    BufferList packet{move(headers)};
+    for (size_t i = first; i < last; i++) {
+        if (_send_queue[i].second.payload().size()) {
+            packet.append(BufferList{_send_queue[i].second.payload()});
+        }
+    }
+    _tun.write(packet);
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
@@ -11,15 +172,18 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
                                                                const Address &ip_address,
                                                                const Address &next_hop)
     : _tap(move(tap)), _interface(eth_address, ip_address), _next_hop(next_hop) {
+    _tap.set_blocking(false);
+
     // Linux seems to ignore the first frame sent on a TAP device, so send a dummy frame to prime the pump :-(
     EthernetFrame dummy_frame;
     _tap.write(dummy_frame.serialize());
 }
 
-optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
+optional<InternetDatagram> TCPOverIPv4OverEthernetAdapter::read_datagram() {
     // Read Ethernet frame from the raw device
+    auto packet = _batch.next(_tap);
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (not packet or frame.parse(move(packet.value())) != ParseResult::NoError) {
         return {};
     }
 
@@ -29,13 +193,27 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // The incoming frame may have caused the NetworkInterface to send a frame.
     send_pending();
 
+    return ip_dgram;
+}
+
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // Try to interpret IPv4 datagram as TCP
+    optional<InternetDatagram> ip_dgram = read_datagram();
     if (ip_dgram) {
         return unwrap_tcp_in_ip(ip_dgram.value());
     }
     return {};
 }
 
+//! \param[out] flow is set to the flow of the segment
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read(TCPFlow &flow) {
+    optional<InternetDatagram> ip_dgram = read_datagram();
+    if (ip_dgram) {
+        return unwrap_tcp_in_ip(ip_dgram.value(), flow);
+    }
+    return {};
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPOverIPv4OverEthernetAdapter::tick(const size_t ms_since_last_tick) {
     _interface.tick(ms_since_last_tick);
@@ -48,6 +226,13 @@ void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
     send_pending();
 }
 
+//! \param[in] seg the TCPSegment to send
+//! \param[in] flow is the flow the segment belongs to
+void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg, const TCPFlow &flow) {
+    _interface.send_datagram(wrap_tcp_in_ip(seg, flow), _next_hop);
+    send_pending();
+}
+
 void TCPOverIPv4OverEthernetAdapter::send_pending() {
     while (not _interface.frames_out().empty()) {
         _tap.write(_interface.frames_out().front().serialize());
@@ -3,32 +3,107 @@
 
 #include "ethernet_header.hh"
 #include "network_interface.hh"
+#include "packet_builder.hh"
 #include "tun.hh"
 
+#include <cstddef>
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+//! \brief The packets that one TunTapFD::read_batch() read, handed out one at a time
+//! \details An adapter reads every packet waiting on its device when it is readable, so that it
+//! takes one readiness event, rather than one each, for a burst of packets.
+class TunTapReadBatch {
+  public:
+    //! Most packets read in one batch
+    static constexpr size_t BATCH_SIZE = 32;
+
+  private:
+    std::vector<Buffer> _packets;  //!< The packets of the batch
+    size_t _next = 0;              //!< Next packet to hand out
+    size_t _count = 0;             //!< Number of packets in the batch
+
+  public:
+    TunTapReadBatch() : _packets(BATCH_SIZE) {}
+
+    //! \brief Take the next packet, first reading those waiting on `fd` if none is left
+    //! \returns the packet, or nothing if none was waiting
+    std::optional<Buffer> next(TunTapFD &fd);
+
+    //! Number of packets of the batch not yet handed out
+    size_t pending() const { return _count - _next; }
+};
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details The adapter makes the device non-blocking, and reads it in batches (see TunTapReadBatch).
+//!
+//! On a device opened with a virtio-net header (see TunTapFD::vnet_hdr), the adapter leaves TCP
+//! checksums to the kernel both ways, and accepts the large segments that the kernel coalesces.
+//! write() then queues segments until flush(), which sends each run of full-sized segments that
+//! continue one another in one flow as one TSO segment, for the kernel to cut back apart.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
+  public:
+    //! Most segments queued by write() before it flushes them (with a virtio-net header)
+    static constexpr size_t MAX_QUEUED_SEGMENTS = 64;
+
+    //! Longest payload of a TSO segment: the rest of the largest IPv4 datagram
+    static constexpr size_t MAX_TSO_PAYLOAD = 65535 - IPv4Header::LENGTH - TCPHeader::LENGTH;
+
   private:
     TunFD _tun;
+    TunTapReadBatch _batch{};  //!< Datagrams read but not yet returned
+    PacketBuilder _builder{};  //!< Serializes outgoing datagrams without allocating
+
+    //! With a virtio-net header, the segments written but not yet sent, and the IPv4 headers to carry them
+    std::vector<std::pair<IPv4Header, TCPSegment>> _send_queue{};
+
+    //! \brief Take the next datagram, reading a batch first if none is left
+    //! \param[out] tcp_cksum_trusted is set to whether the kernel vouched for the TCP checksum
+    std::optional<InternetDatagram> _next_datagram(bool &tcp_cksum_trusted);
+
+    //! Send `seg` in a datagram with the header `ip_header`, or queue it (with a virtio-net header)
+    void _write(const IPv4Header &ip_header, TCPSegment &seg);
+
+    //! Send `_send_queue[first, last)` as one TSO segment, behind a virtio-net header
+    void _send_run(const size_t first, const size_t last);
 
   public:
     //! Construct from a TunFD
-    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
+    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) { _tun.set_blocking(false); }
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
     std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
+        bool tcp_cksum_trusted = false;
+        const auto ip_dgram = _next_datagram(tcp_cksum_trusted);
+        if (not ip_dgram) {
             return {};
         }
-        return unwrap_tcp_in_ip(ip_dgram);
+        return unwrap_tcp_in_ip(ip_dgram.value(), tcp_cksum_trusted);
     }
 
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    void write(TCPSegment &seg) { _write(ip_header_for(seg), seg); }
+
+    //! Attempts to read and parse an IPv4 datagram containing a TCP segment of any connection, and its flow
+    std::optional<TCPSegment> read(TCPFlow &flow) {
+        bool tcp_cksum_trusted = false;
+        const auto ip_dgram = _next_datagram(tcp_cksum_trusted);
+        if (not ip_dgram) {
+            return {};
+        }
+        return unwrap_tcp_in_ip(ip_dgram.value(), flow, tcp_cksum_trusted);
+    }
+
+    //! Creates an IPv4 datagram from a TCP segment of `flow` and writes it to the TUN device
+    void write(TCPSegment &seg, const TCPFlow &flow) { _write(ip_header_for(seg, flow), seg); }
+
+    //! Number of datagrams already read that read() returns without touching the device
+    size_t pending_reads() const { return _batch.pending(); }
+
+    //! Send the segments that write() queued, coalescing what it can into TSO segments
+    void flush();
 
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
@@ -41,16 +116,22 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
 using LossyTCPOverIPv4OverTunFdAdapter = LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TAP device
+//! \details The adapter makes the device non-blocking, and reads it in batches (see TunTapReadBatch).
 class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
   private:
     TapFD _tap;  //!< Raw Ethernet connection
 
+    TunTapReadBatch _batch{};  //!< Frames read but not yet returned
+
     NetworkInterface _interface;  //!< NIC abstraction
 
     Address _next_hop;  //!< IP address of the next hop
 
     void send_pending();  //!< Sends any pending Ethernet frames
 
+    //! Reads an Ethernet frame and returns the IPv4 datagram it carries, if any
+    std::optional<InternetDatagram> read_datagram();
+
   public:
     //! Construct from a TapFD
     explicit TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
@@ -63,9 +144,21 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
     //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
     void write(TCPSegment &seg);
 
+    //! Attempts to read an Ethernet frame containing a TCP segment of any connection, and its flow
+    std::optional<TCPSegment> read(TCPFlow &flow);
+
+    //! Sends a TCP segment of `flow` (in an IPv4 datagram, in an Ethernet frame).
+    void write(TCPSegment &seg, const TCPFlow &flow);
+
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
+    //! Milliseconds until tick() next has work to do: expiring an ARP table entry
+    std::optional<uint64_t> time_until_next_tick() const { return _interface.time_until_next_expiry(); }
+
+    //! Number of frames already read that read() returns without touching the device
+    size_t pending_reads() const { return _batch.pending(); }
+
     //! Access the underlying raw Ethernet connection
     operator TapFD &() { return _tap; }
 
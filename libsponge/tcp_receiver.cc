@@ -1,5 +1,7 @@
 #include "tcp_receiver.hh"
 
+#include <algorithm>
+
 // Implementation of a TCP receiver
 
 using namespace std;
@@ -21,11 +23,11 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
         _isn = seg.header().seqno;
     }
 
+    size_t segment_seqno = unwrap(seg.header().seqno, _isn, _reassembler.first_unassembled());
     if (seg.header().fin) {
         _fin_received = true;
     }
 
-    size_t segment_seqno = unwrap(seg.header().seqno, _isn, _reassembler.first_unassembled());
     size_t segment_size = seg.length_in_sequence_space() - seg.header().syn - seg.header().fin;
     if (segment_size == 0) {  // if segment’s length is 0, treat it as one byte
         segment_size = 1;
@@ -40,7 +42,15 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
         return false;
     }
 
-    _reassembler.push_substring(seg.payload().copy(), segment_seqno - 1, seg.header().fin);  // minus 1 for SYN
+    // the stream ends where the FIN is, if it fell inside the window (minus 1 for SYN, unless this is the SYN)
+    if (seg.header().fin and not outside_window) {
+        _fin_index = segment_seqno + seg.payload().size() - (seg.header().syn ? 0 : 1);
+    }
+
+    _reassembler.push_substring(seg.payload(), segment_seqno - 1, seg.header().fin);  // minus 1 for SYN
+    if (seg.payload().size() and segment_seqno - 1 > _reassembler.first_unassembled()) {
+        _latest_unassembled = segment_seqno - 1;
+    }
 
     // update ackno, FIN should be acknowledged after received all payloads
     bool finished = _fin_received && (_reassembler.unassembled_bytes() == 0);
@@ -56,4 +66,33 @@ optional<WrappingInt32> TCPReceiver::ackno() const {
     return nullopt;
 }
 
+void TCPReceiver::add_sack_blocks(TCPHeader &header, const size_t max_blocks) const {
+    header.sack_count = 0;
+    const size_t limit = min(max_blocks, TCPHeader::MAX_SACK_BLOCKS);
+    if (_reassembler.empty() or limit == 0) {
+        return;
+    }
+
+    const auto ranges = _reassembler.unassembled_ranges();
+    auto latest = find_if(ranges.begin(), ranges.end(), [&](const auto &range) {
+        return _latest_unassembled and range.first <= _latest_unassembled.value() and
+               _latest_unassembled.value() < range.second;
+    });
+    if (latest == ranges.end()) {
+        latest = ranges.begin();
+    }
+
+    // a block that reaches the end of the stream covers the FIN too
+    const auto add_block = [&](const pair<uint64_t, uint64_t> &range) {
+        const bool fin = _fin_index == range.second;
+        header.sack[header.sack_count++] = {wrap(range.first + 1, _isn), wrap(range.second + 1 + fin, _isn)};
+    };
+    add_block(*latest);
+    for (auto range = ranges.begin(); range != ranges.end() and header.sack_count < limit; range++) {
+        if (range != latest) {
+            add_block(*range);
+        }
+    }
+}
+
 size_t TCPReceiver::window_size() const { return stream_out().remaining_capacity(); }
@@ -25,6 +25,10 @@ class TCPReceiver {
     bool _syn_received = false;
     bool _fin_received = false;
 
+    //! stream index of the latest segment stored beyond a hole, and of the end of the stream (once the FIN is in)
+    std::optional<uint64_t> _latest_unassembled{};
+    std::optional<uint64_t> _fin_index{};
+
   public:
     //! \brief Construct a TCP receiver
     //!
@@ -58,6 +62,13 @@ class TCPReceiver {
     //! \brief number of bytes stored but not yet reassembled
     size_t unassembled_bytes() const { return _reassembler.unassembled_bytes(); }
 
+    //! \brief Set the SACK option of `header` (RFC 2018) to up to `max_blocks` of the ranges held beyond
+    //! the ackno, the one holding the latest segment received first; no blocks if nothing is held
+    void add_sack_blocks(TCPHeader &header, const size_t max_blocks = TCPHeader::MAX_SACK_BLOCKS) const;
+
+    //! \brief number of segments whose payload went straight to the stream (see StreamReassembler::in_order_pushes)
+    size_t in_order_segments() const { return _reassembler.in_order_pushes(); }
+
     //! \brief handle an inbound segment
     //! \returns `true` if any part of the segment was inside the window
     bool segment_received(const TCPSegment &seg);
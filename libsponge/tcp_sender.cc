@@ -2,6 +2,9 @@
 
 #include "tcp_config.hh"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <random>
 
 // Implementation of a TCP sender
@@ -11,21 +14,91 @@ using namespace std;
 //! \param[in] capacity the capacity of the outgoing byte stream
 //! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment
 //! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise uses a random ISN)
-TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout, const std::optional<WrappingInt32> fixed_isn)
+//! \param[in] storage how the outgoing byte stream holds unsent bytes
+//! \param[in] congestion_control the congestion control algorithm
+//! \param[in] adaptive_rto the bounds of the retransmission timeout, if it is to follow RTT samples
+TCPSender::TCPSender(const size_t capacity,
+                     const uint16_t retx_timeout,
+                     const std::optional<WrappingInt32> fixed_isn,
+                     const ByteStream::Storage storage,
+                     const CongestionControl congestion_control,
+                     const std::optional<RTOBounds> adaptive_rto)
     : _isn(fixed_isn.value_or(WrappingInt32{random_device()()}))
-    , _initial_retransmission_timeout{retx_timeout}
+    , _base_retransmission_timeout{retx_timeout}
     , _retransmission_timeout{retx_timeout}
-    , _stream(capacity) {}
+    , _stream(capacity, storage)
+    , _adaptive_rto(adaptive_rto)
+    , _congestion(CongestionController::make(congestion_control, TCPConfig::MAX_PAYLOAD_SIZE)) {}
 
 uint64_t TCPSender::bytes_in_flight() const { return _outstanding_size; }
 
+//! \details As in RFC 6298: the first sample sets SRTT to the sample and RTTVAR to half of it; each later
+//! one moves SRTT an eighth and RTTVAR a quarter of the way to it. The timeout is SRTT + 4 * RTTVAR,
+//! at least one clock tick (a millisecond) more than SRTT, within the bounds.
+//! \param[in] rtt the round-trip time of a segment that was sent only once
+void TCPSender::_sample_rtt(const size_t rtt) {
+    if (not _rtt) {
+        _rtt = RTTEstimate{rtt, rtt, double(rtt), rtt / 2.0, 1};
+    } else {
+        RTTEstimate &estimate = _rtt.value();
+        estimate.variation = 0.75 * estimate.variation + 0.25 * abs(estimate.smoothed - rtt);
+        estimate.smoothed = 0.875 * estimate.smoothed + 0.125 * rtt;
+        estimate.latest = rtt;
+        estimate.minimum = min(estimate.minimum, rtt);
+        estimate.samples++;
+    }
+
+    if (_adaptive_rto) {
+        const double rto = _rtt->smoothed + max(1.0, 4 * _rtt->variation);
+        _base_retransmission_timeout = clamp<size_t>(ceil(rto), _adaptive_rto->min, _adaptive_rto->max);
+    }
+}
+
+//! \details The credit is capped at a millisecond's worth of sending (and at least two segments), so an
+//! idle sender does not save up a burst.
+void TCPSender::_refill_pacing_credit() {
+    const auto rate = _congestion ? _congestion->pacing_rate() : nullopt;
+    if (not rate) {
+        _pacing_refilled_at = _time;
+        return;
+    }
+
+    // at a slow rate, let the time accumulate until it earns a whole byte
+    const int64_t earned = rate.value() * (_time - _pacing_refilled_at) / 1000;
+    if (earned > 0) {
+        const int64_t cap = max<int64_t>(2 * TCPConfig::MAX_PAYLOAD_SIZE, rate.value() / 1000);
+        _pacing_credit = min(_pacing_credit + earned, cap);
+        _pacing_refilled_at = _time;
+    }
+}
+
 void TCPSender::fill_window() {
     // calculate current sliding window capacity
     // when window size is 0, act like window size is 1, "zero window probing"
-    size_t window_capacity = ((_window_size == 0) ? 1 : _window_size) - _outstanding_size;
+    size_t window = (_window_size == 0) ? 1 : _window_size;
+    bool congestion_limited = false;
+    if (_congestion and _window_size != 0 and _congestion->window() + _recovery_inflation < window) {
+        window = _congestion->window() + _recovery_inflation;
+        congestion_limited = true;
+    }
+    size_t window_capacity = window > _outstanding_size ? window - _outstanding_size : 0;
+
+    _refill_pacing_credit();
+    const bool paced = _congestion and _congestion->pacing_rate().has_value();
+    _pacing_blocked = false;
 
     // never send any segments after FIN is sent
     while (!_fin_sent && window_capacity > 0) {
+        // don't send a runt segment while the congestion window is about to let a full one go
+        if (congestion_limited && window_capacity < TCPConfig::MAX_PAYLOAD_SIZE &&
+            _stream.buffer_size() > window_capacity) {
+            return;
+        }
+        if (paced && _pacing_credit <= 0) {
+            _pacing_blocked = true;
+            return;
+        }
+
         TCPSegment seg;
 
         if (_next_seqno == 0) {  // send initial SYN
@@ -34,7 +107,8 @@ void TCPSender::fill_window() {
             seg.header().fin = true;
             _fin_sent = true;
         } else if (!_stream.buffer_empty()) {
-            seg.payload() = Buffer(move(_stream.read(min(window_capacity, TCPConfig::MAX_PAYLOAD_SIZE))));
+            seg.payload() = _stream.read_buffer(min(window_capacity, TCPConfig::MAX_PAYLOAD_SIZE));
+            seg.cache_payload_sum();  // retransmissions and ackno updates then only re-sum the header
 
             // handle piggyback FIN, MUST ensure the sliding window can hold it
             if (_stream.eof() && window_capacity - seg.length_in_sequence_space() > 0) {
@@ -42,6 +116,8 @@ void TCPSender::fill_window() {
                 _fin_sent = true;
             }
         } else {
+            // out of data: bandwidth measured until what is in flight now is delivered understates the path
+            _application_limited_until = _delivered - _delivered_ahead + _outstanding_size + 1;
             return;
         }
         seg.header().seqno = wrap(_next_seqno, _isn);
@@ -49,42 +125,238 @@ void TCPSender::fill_window() {
         _next_seqno += seg.length_in_sequence_space();
         _outstanding_size += seg.length_in_sequence_space();
         window_capacity -= seg.length_in_sequence_space();
-        _segments_outstanding.push(seg);
+        _pacing_credit -= seg.length_in_sequence_space();
+        // start the timer afresh if nothing was outstanding (RFC 6298, 5.1)
+        if (_segments_outstanding.empty()) {
+            _retransmission_timer = 0;
+        }
+        _segments_outstanding.push_back(
+            {seg, _time, _delivered, _delivered_at, _delivered < _application_limited_until});
         _segments_out.push(seg);
     }
 }
 
+void TCPSender::_retransmit_earliest() {
+    OutstandingSegment &outstanding = _segments_outstanding.front();
+    outstanding.sent_at = _time;
+    outstanding.retransmitted = true;
+    outstanding.repaired = true;
+    _segments_out.push(outstanding.segment);
+}
+
+//! \details As in RFC 5681 and RFC 6582: the third duplicate in a row retransmits the earliest segment
+//! and enters fast recovery, unless the duplicates are from a window whose loss was already handled
+//! (before `_recover`); every later duplicate means another segment has left the network.
+void TCPSender::_duplicate_ack_received() {
+    _duplicate_acks++;
+    if (not _sack_seen) {
+        _credit_delivered_ahead(TCPConfig::MAX_PAYLOAD_SIZE);
+    }
+    if (_in_recovery and _sacked_bytes) {
+        _retransmit_holes(false);
+        return;
+    }
+    if (_in_recovery) {
+        _recovery_inflation += TCPConfig::MAX_PAYLOAD_SIZE;
+        return;
+    }
+    if (_duplicate_acks < DUPLICATE_ACK_THRESHOLD) {
+        // limited transmit (RFC 3042): each of the first duplicates lets one new segment out, so that a
+        // small window still brings enough duplicates back
+        _recovery_inflation = _duplicate_acks * TCPConfig::MAX_PAYLOAD_SIZE;
+        return;
+    }
+    if (_duplicate_acks != DUPLICATE_ACK_THRESHOLD or _last_ackno < _recover) {
+        return;
+    }
+
+    _in_recovery = true;
+    _recover = _next_seqno;
+    if (_congestion) {
+        _congestion->on_loss(_time, _outstanding_size);
+    }
+    _fast_retransmissions++;
+    for (auto &outstanding : _segments_outstanding) {
+        outstanding.repaired = false;
+    }
+    if (_sacked_bytes) {
+        _retransmit_holes(true);
+        return;
+    }
+    _recovery_inflation = DUPLICATE_ACK_THRESHOLD * TCPConfig::MAX_PAYLOAD_SIZE;
+    _retransmit_earliest();
+}
+
+//! \details A simplified RFC 6675. A segment is lost once more than DUPLICATE_ACK_THRESHOLD - 1 segments'
+//! worth above it was SACKed, or (with no new data to send instead) anything above it was. The "pipe"
+//! counts what is still in the network: segments neither SACKed nor lost, and retransmissions. Lost
+//! segments are retransmitted in order while the pipe is smaller than the congestion window; the window
+//! inflation then lets new data out while it still is.
+void TCPSender::_retransmit_holes(const bool earliest_lost) {
+    const size_t threshold =
+        _stream.buffer_empty() ? 0 : (DUPLICATE_ACK_THRESHOLD - 1) * TCPConfig::MAX_PAYLOAD_SIZE;
+    size_t sacked_above = 0;
+    for (auto outstanding = _segments_outstanding.rbegin(); outstanding != _segments_outstanding.rend();
+         outstanding++) {
+        outstanding->lost = not outstanding->sacked and sacked_above > threshold;
+        sacked_above += outstanding->sacked ? outstanding->segment.length_in_sequence_space() : 0;
+    }
+    if (earliest_lost and not _segments_outstanding.empty() and not _segments_outstanding.front().sacked) {
+        _segments_outstanding.front().lost = true;
+    }
+
+    size_t pipe = 0;
+    for (const auto &outstanding : _segments_outstanding) {
+        const size_t length = outstanding.segment.length_in_sequence_space();
+        if (not outstanding.sacked) {
+            pipe += (outstanding.lost ? 0 : length) + (outstanding.repaired ? length : 0);
+        }
+    }
+
+    const size_t window = _congestion ? _congestion->window() : numeric_limits<size_t>::max();
+    for (auto &outstanding : _segments_outstanding) {
+        const bool regardless_of_window = earliest_lost and &outstanding == &_segments_outstanding.front();
+        if (outstanding.lost and not outstanding.repaired and (pipe < window or regardless_of_window)) {
+            outstanding.sent_at = _time;
+            outstanding.retransmitted = true;
+            outstanding.repaired = true;
+            _segments_out.push(outstanding.segment);
+            pipe += outstanding.segment.length_in_sequence_space();
+        }
+    }
+
+    _recovery_inflation = _outstanding_size - min(pipe, _outstanding_size);
+}
+
+//! \details Without this, a window repaired by one cumulative acknowledgment would look delivered all at
+//! once, as fast as that acknowledgment came after the last retransmission, and a delivery-rate sample
+//! would overstate the path many times over.
+void TCPSender::_credit_delivered_ahead(const size_t bytes) {
+    const uint64_t credited = min<uint64_t>(bytes, _outstanding_size - min(_delivered_ahead, _outstanding_size));
+    _delivered += credited;
+    _delivered_ahead += credited;
+    _delivered_at = _time;
+}
+
+//! \details Blocks that are not between the ackno and what was sent are ignored.
+void TCPSender::sack_received(const TCPHeader &header) {
+    _sack_seen |= header.sack_count > 0;
+    for (size_t block = 0; block < header.sack_count; block++) {
+        const uint64_t left = unwrap(header.sack[block].left, _isn, _last_ackno);
+        const uint64_t right = unwrap(header.sack[block].right, _isn, _last_ackno);
+        if (left >= right or left < _last_ackno or right > _next_seqno) {
+            continue;
+        }
+        for (auto &outstanding : _segments_outstanding) {
+            const uint64_t seqno = unwrap(outstanding.segment.header().seqno, _isn, _last_ackno);
+            const size_t length = outstanding.segment.length_in_sequence_space();
+            if (seqno >= right) {
+                break;
+            }
+            if (not outstanding.sacked and seqno >= left and seqno + length <= right) {
+                outstanding.sacked = true;
+                _sacked_bytes += length;
+                _credit_delivered_ahead(length);
+            }
+        }
+    }
+}
+
 //! \param ackno The remote receiver's ackno (acknowledgment number)
 //! \param window_size The remote receiver's advertised window size
+//! \param carries_data Whether the acknowledgment came on a segment that occupies sequence space
 //! \returns `false` if the ackno appears invalid (acknowledges something the TCPSender hasn't sent yet)
-bool TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size) {
+bool TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size, const bool carries_data) {
     uint64_t abs_ackno = unwrap(ackno, _isn, _last_ackno);
     if (abs_ackno > next_seqno_absolute()) {
         return false;
     }
 
+    const size_t previous_window_size = _window_size;
     _window_size = window_size;
 
-    // if received ack of an acknowledged packet, do nothing
+    // if received ack of an acknowledged packet, do nothing, unless it is a duplicate: the receiver
+    // got a segment beyond a hole, with nothing else changed
     if (abs_ackno <= _last_ackno) {
+        if (abs_ackno == _last_ackno and not carries_data and window_size != 0 and
+            window_size == previous_window_size and not _segments_outstanding.empty()) {
+            _duplicate_ack_received();
+        }
         return true;
     }
+    const uint64_t bytes_acked = abs_ackno - _last_ackno;
     _last_ackno = abs_ackno;
+    // what SACKs or duplicates already counted as delivered is not counted again
+    const uint64_t credited_ahead = min<uint64_t>(_delivered_ahead, bytes_acked);
+    _delivered_ahead -= credited_ahead;
+    _delivered += bytes_acked - credited_ahead;
+    _delivered_at = _time;
+    _duplicate_acks = 0;
+    if (not _in_recovery) {
+        _recovery_inflation = 0;
+    }
 
+    // the newest segment acknowledged in full tells how long the round trip took, and the delivery rate since
+    AckSample sample{_time, bytes_acked, 0, {}, _delivered, _delivered, 0, false, _in_recovery};
+    bool acked_retransmission = false;
     while (!_segments_outstanding.empty()) {
-        TCPSegment &seg = _segments_outstanding.front();
+        const OutstandingSegment &outstanding = _segments_outstanding.front();
+        const TCPSegment &seg = outstanding.segment;
         uint64_t abs_seqno = unwrap(seg.header().seqno, _isn, _last_ackno);
 
         if (abs_ackno >= abs_seqno + seg.length_in_sequence_space()) {
+            sample.rtt = outstanding.retransmitted ? nullopt : optional<size_t>{_time - outstanding.sent_at};
+            sample.prior_delivered = outstanding.delivered;
+            sample.interval = max<uint64_t>({_time - outstanding.sent_at, _time - outstanding.delivered_at, 1});
+            sample.application_limited = outstanding.application_limited;
+            acked_retransmission |= outstanding.retransmitted;
             _outstanding_size -= seg.length_in_sequence_space();
-            _segments_outstanding.pop();
+            _sacked_bytes -= outstanding.sacked ? seg.length_in_sequence_space() : 0;
+            _segments_outstanding.pop_front();
         } else {
             break;
         }
     }
 
-    // Set RTO back to its "initial value."
-    _retransmission_timeout = _initial_retransmission_timeout;
+    if (sample.rtt) {
+        _sample_rtt(sample.rtt.value());
+    }
+
+    // fast recovery ends once everything outstanding at the loss is acknowledged; an acknowledgment
+    // short of that means the next segment was lost too: retransmit it (and, with SACK information,
+    // any other hole), and deflate the window by what was acknowledged (RFC 6582)
+    if (_in_recovery and abs_ackno >= _recover) {
+        _in_recovery = false;
+        _recovery_inflation = 0;
+        if (_congestion) {
+            _congestion->on_recovery_exit(_outstanding_size);
+        }
+    } else if (_in_recovery and _sacked_bytes) {
+        _retransmit_holes(true);
+    } else if (_last_ackno < _recover and _sacked_bytes) {
+        // after a timeout, SACK information repairs the rest of the window without waiting for another
+        // timeout per hole (RFC 6675, 5.1)
+        _retransmit_holes(true);
+    } else if (_in_recovery) {
+        _recovery_inflation -= min<size_t>(_recovery_inflation, bytes_acked);
+        if (bytes_acked >= TCPConfig::MAX_PAYLOAD_SIZE) {
+            _recovery_inflation += TCPConfig::MAX_PAYLOAD_SIZE;
+        }
+        if (!_segments_outstanding.empty()) {
+            _retransmit_earliest();
+        }
+    }
+
+    if (_congestion) {
+        sample.bytes_in_flight = _outstanding_size;
+        _congestion->on_ack(sample);
+    }
+
+    // Set RTO back to its "initial value" (or estimate); by Karn's algorithm, an adaptive timeout
+    // keeps its backoff until a segment sent only once is acknowledged
+    if (not _adaptive_rto or sample.rtt or not acked_retransmission) {
+        _retransmission_timeout = _base_retransmission_timeout;
+    }
 
     // If the sender has any outstanding data, restart the retransmission timer
     if (!_segments_outstanding.empty()) {
@@ -99,28 +371,74 @@ bool TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_si
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPSender::tick(const size_t ms_since_last_tick) {
+    _time += ms_since_last_tick;
     _retransmission_timer += ms_since_last_tick;
 
     if (_retransmission_timer >= _retransmission_timeout) {
         // retransmit the earliest segment
         if (!_segments_outstanding.empty()) {
-            _segments_out.push(_segments_outstanding.front());
+            _retransmit_earliest();
 
             if (_window_size != 0) {
+                // a timeout with the receiver's window open is a sign of congestion; it ends fast recovery,
+                // and duplicates of what is outstanding now can't start another (RFC 6582, 4.2)
+                if (_congestion) {
+                    _congestion->on_rto(_time, _outstanding_size);
+                }
+                _in_recovery = false;
+                _recovery_inflation = 0;
+                _recover = _next_seqno;
+                _duplicate_acks = 0;
+
+                // the receiver may have dropped what it SACKed (RFC 2018, 8): start the scoreboard afresh
+                for (auto &outstanding : _segments_outstanding) {
+                    outstanding.sacked = false;
+                    outstanding.repaired = false;
+                }
+                _segments_outstanding.front().repaired = true;
+                _sacked_bytes = 0;
+
                 // increment the number of consecutive retransmissions
                 _consecutive_retransmissions += 1;
                 // double the value of RTO
                 _retransmission_timeout *= 2;
+                if (_adaptive_rto) {
+                    _retransmission_timeout = min<size_t>(_retransmission_timeout, _adaptive_rto->max);
+                }
             }
         }
 
         // always reset the retransmission timer
         _retransmission_timer = 0;
     }
+
+    // send what pacing held back, now that it has earned the credit
+    if (_pacing_blocked) {
+        fill_window();
+    }
 }
 
 unsigned int TCPSender::consecutive_retransmissions() const { return _consecutive_retransmissions; }
 
+optional<size_t> TCPSender::time_until_retransmission() const {
+    if (_segments_outstanding.empty()) {
+        return {};
+    }
+    return _retransmission_timer >= _retransmission_timeout ? 0 : _retransmission_timeout - _retransmission_timer;
+}
+
+optional<size_t> TCPSender::time_until_paced_send() const {
+    const auto rate = _congestion ? _congestion->pacing_rate() : nullopt;
+    if (not _pacing_blocked or not rate or rate.value() == 0) {
+        return {};
+    }
+    // credit accrues at `rate` bytes per second from the last refill; it must become positive
+    const uint64_t needed = 1 - _pacing_credit;
+    const uint64_t since_refill = _time - _pacing_refilled_at;
+    const uint64_t until = (needed * 1000 + rate.value() - 1) / rate.value();
+    return until > since_refill ? max<uint64_t>(until - since_refill, 1) : 1;
+}
+
 void TCPSender::send_empty_segment() {
     TCPSegment seg;
     seg.header().seqno = wrap(_next_seqno, _isn);
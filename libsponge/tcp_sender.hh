@@ -2,13 +2,26 @@
 #define SPONGE_LIBSPONGE_TCP_SENDER_HH
 
 #include "byte_stream.hh"
+#include "congestion_controller.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "wrapping_integers.hh"
 
+#include <deque>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
 
+//! \brief What a TCPSender has measured of the round-trip time (RFC 6298)
+struct RTTEstimate {
+    size_t latest;     //!< Latest sample, in milliseconds
+    size_t minimum;    //!< Smallest sample, in milliseconds
+    double smoothed;   //!< Smoothed round-trip time (SRTT), in milliseconds
+    double variation;  //!< Round-trip time variation (RTTVAR), in milliseconds
+    uint64_t samples;  //!< Number of samples taken
+};
+
 //! \brief The "sender" part of a TCP implementation.
 
 //! Accepts a ByteStream, divides it up into segments and sends the
@@ -23,11 +36,28 @@ class TCPSender {
     //! outbound queue of segments that the TCPSender wants sent
     std::queue<TCPSegment> _segments_out{};
 
-    //! queue of segments that the TCPSender is now sending
-    std::queue<TCPSegment> _segments_outstanding{};
-
-    //! retransmission timer for the connection
-    size_t _initial_retransmission_timeout;
+    //! A segment sent but not yet acknowledged, and what the congestion controller needs to know about it
+    struct OutstandingSegment {
+        TCPSegment segment;
+        uint64_t sent_at;            //!< Time of its latest transmission
+        uint64_t delivered;          //!< `_delivered` when it was first sent
+        uint64_t delivered_at;       //!< `_delivered_at` when it was first sent
+        bool application_limited;    //!< Whether the sender was short of data when it was first sent
+        bool retransmitted = false;  //!< Whether it has been retransmitted
+        bool sacked = false;         //!< Whether the receiver has selectively acknowledged it
+        bool lost = false;           //!< Whether the scoreboard deems it lost, given what was SACKed above it
+        bool repaired = false;       //!< Whether it has been retransmitted in the current fast recovery
+    };
+
+    //! segments that the TCPSender is now sending, in order: the SACK scoreboard
+    std::deque<OutstandingSegment> _segments_outstanding{};
+
+    //! sequence space of the outstanding segments that were selectively acknowledged
+    size_t _sacked_bytes = 0;
+
+    //! retransmission timer for the connection; the base timeout is the one before any backoff:
+    //! the initial timeout, or the estimate from RTT samples when the timeout is adaptive
+    size_t _base_retransmission_timeout;
     size_t _retransmission_timeout;
     size_t _retransmission_timer = 0;
     size_t _consecutive_retransmissions = 0;
@@ -42,13 +72,82 @@ class TCPSender {
     size_t _window_size = 1;  // initial window size should be 1
     size_t _outstanding_size = 0;
 
+    //! duplicate acknowledgments received in a row, and how many of them trigger a fast retransmission
+    static constexpr size_t DUPLICATE_ACK_THRESHOLD = 3;
+    size_t _duplicate_acks = 0;
+
+    //! fast recovery (RFC 6582): whether it is under way, the absolute seqno that ends it once acknowledged
+    //! (or, after a timeout, that ends the repair of the window it hit), and the bytes by which it (or
+    //! limited transmit) inflates the congestion window
+    bool _in_recovery = false;
+    uint64_t _recover = 0;
+    size_t _recovery_inflation = 0;
+
+    //! number of fast retransmissions (losses detected by duplicate acknowledgments)
+    uint64_t _fast_retransmissions = 0;
+
+    //! Retransmit the earliest outstanding segment
+    void _retransmit_earliest();
+
+    //! Count a duplicate acknowledgment, and enter fast recovery on the third one in a row
+    void _duplicate_ack_received();
+
+    //! In fast recovery with SACK information, retransmit the segments deemed lost (the earliest one
+    //! whatever the window, if `earliest_lost`), and let new data out as the pipe allows
+    void _retransmit_holes(const bool earliest_lost);
+
     bool _fin_sent = false;
 
+    //! bounds of the retransmission timeout if it follows RTT samples, or empty if it is fixed
+    std::optional<RTOBounds> _adaptive_rto;
+
+    //! round-trip time measured from segments that were never retransmitted (Karn's algorithm)
+    std::optional<RTTEstimate> _rtt{};
+
+    //! Take an RTT sample into the estimate and, if the timeout is adaptive, into the base timeout
+    void _sample_rtt(const size_t rtt);
+
+    //! congestion control, or nullptr to send as much as the receiver's window allows
+    std::unique_ptr<CongestionController> _congestion;
+
+    //! milliseconds elapsed, as told by tick()
+    uint64_t _time = 0;
+
+    //! sequence space delivered so far, and the time it last grew
+    uint64_t _delivered = 0;
+    uint64_t _delivered_at = 0;
+
+    //! part of `_delivered` that the ackno has yet to cover: what SACKs (or, without them, duplicate
+    //! acknowledgments) showed had reached the receiver beyond a hole
+    uint64_t _delivered_ahead = 0;
+
+    //! whether the receiver has sent SACK blocks, so that duplicate acknowledgments no longer stand for a segment each
+    bool _sack_seen = false;
+
+    //! Count `bytes` beyond the ackno as delivered now
+    void _credit_delivered_ahead(const size_t bytes);
+
+    //! segments are application-limited until `_delivered` reaches this
+    uint64_t _application_limited_until = 0;
+
+    //! bytes that pacing lets the sender send now (negative once it has sent ahead), and when it was refilled
+    int64_t _pacing_credit = 0;
+    uint64_t _pacing_refilled_at = 0;
+
+    //! whether pacing held back a segment that the windows allowed
+    bool _pacing_blocked = false;
+
+    //! Add the credit that pacing earned since it was last refilled
+    void _refill_pacing_credit();
+
   public:
     //! Initialize a TCPSender
     TCPSender(const size_t capacity = TCPConfig::DEFAULT_CAPACITY,
               const uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
-              const std::optional<WrappingInt32> fixed_isn = {});
+              const std::optional<WrappingInt32> fixed_isn = {},
+              const ByteStream::Storage storage = ByteStream::Storage::Ring,
+              const CongestionControl congestion_control = CongestionControl::None,
+              const std::optional<RTOBounds> adaptive_rto = {});
 
     //! \name "Input" interface for the writer
     //!@{
@@ -60,7 +159,13 @@ class TCPSender {
     //!@{
 
     //! \brief A new acknowledgment was received
-    bool ack_received(const WrappingInt32 ackno, const uint16_t window_size);
+    //! \details Only acknowledgments on segments that occupy no sequence space can be duplicates.
+    bool ack_received(const WrappingInt32 ackno, const uint16_t window_size, const bool carries_data = false);
+
+    //! \brief Selective acknowledgments (RFC 2018) were received: mark the outstanding segments that the
+    //! SACK blocks of `header` cover, so that fast recovery retransmits only the others
+    //! \note Call this before ack_received() for the same segment.
+    void sack_received(const TCPHeader &header);
 
     //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
     void send_empty_segment();
@@ -83,6 +188,31 @@ class TCPSender {
     //! \brief Number of consecutive retransmissions that have occurred in a row
     unsigned int consecutive_retransmissions() const;
 
+    //! \brief Milliseconds until the retransmission timer expires
+    //! \returns an empty optional if no segment is outstanding (nothing would be retransmitted)
+    std::optional<size_t> time_until_retransmission() const;
+
+    //! \brief Milliseconds until pacing lets the sender send a segment that it is holding back
+    //! \returns an empty optional if pacing is holding nothing back
+    std::optional<size_t> time_until_paced_send() const;
+
+    //! \brief Number of losses repaired by fast retransmission (triggered by duplicate acknowledgments)
+    uint64_t fast_retransmissions() const { return _fast_retransmissions; }
+
+    //! \brief Sequence space outstanding that the receiver has selectively acknowledged
+    size_t sacked_bytes() const { return _sacked_bytes; }
+
+    //! \brief Milliseconds the retransmission timer currently runs for (with any backoff)
+    size_t retransmission_timeout() const { return _retransmission_timeout; }
+
+    //! \brief What the sender has measured of the round-trip time
+    //! \returns an empty optional until a segment sent only once has been acknowledged
+    const std::optional<RTTEstimate> &rtt_estimate() const { return _rtt; }
+
+    //! \brief The congestion controller
+    //! \returns nullptr if the sender only respects the receiver's window
+    const CongestionController *congestion_controller() const { return _congestion.get(); }
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
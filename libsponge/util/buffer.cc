@@ -1,14 +1,111 @@
 #include "buffer.hh"
 
+#include <new>
+#include <stdexcept>
+
 using namespace std;
 
+//! Set once the calling thread's pools have been destroyed (e.g. while static Buffers are destroyed
+//! at exit); trivially destructible, so it stays readable after that.
+static thread_local bool pools_destroyed = false;
+
+//! The calling thread's pools, one per size class
+struct ThreadPools {
+    array<BufferPool, BufferPool::BLOCK_SIZES.size()> pools{{{0, 1024}, {1, 64}}};  // up to 2 MB + 4 MB kept free
+    ~ThreadPools() { pools_destroyed = true; }
+};
+
+static ThreadPools &thread_pools() {
+    thread_local ThreadPools pools;
+    return pools;
+}
+
+//! Destroy and free a pooled block
+static void free_block(BufferStorage *storage) {
+    storage->~BufferStorage();
+    ::operator delete(storage);
+}
+
+void BufferStorage::release() {
+    if (--_refcount > 0) {
+        return;
+    }
+    if (_size_class < 0) {
+        delete this;
+    } else if (pools_destroyed) {
+        free_block(this);
+    } else {
+        BufferPool::local(_size_class).recycle(this);
+    }
+}
+
+BufferPool::~BufferPool() {
+    while (_free_list) {
+        free_block(exchange(_free_list, _free_list->_next_free));
+    }
+}
+
+BufferStorage *BufferPool::acquire() {
+    if (_free_list) {
+        ++_stats.hits;
+        --_stats.free_blocks;
+        BufferStorage *storage = exchange(_free_list, _free_list->_next_free);
+        storage->_refcount = 1;
+        storage->_next_free = nullptr;
+        return storage;
+    }
+    ++_stats.misses;
+    return new (::operator new(sizeof(BufferStorage) + block_size())) BufferStorage(_size_class);
+}
+
+//! \param[in] storage is a block of this pool's size class with no remaining references
+void BufferPool::recycle(BufferStorage *storage) {
+    if (_stats.free_blocks >= _max_free) {
+        free_block(storage);
+        return;
+    }
+    storage->_next_free = _free_list;
+    _free_list = storage;
+    ++_stats.free_blocks;
+}
+
+BufferPool &BufferPool::local(const size_t size_class) { return thread_pools().pools.at(size_class); }
+
+//! \param[in] len is the number of bytes the caller will write
+pair<Buffer, char *> Buffer::allocate(const size_t len) {
+    for (size_t size_class = 0; size_class < BufferPool::BLOCK_SIZES.size(); ++size_class) {
+        if (len <= BufferPool::BLOCK_SIZES[size_class]) {
+            Buffer ret;
+            ret._storage = BufferPool::local(size_class).acquire();
+            ret._size = len;
+            char *const data = ret._storage->_data;
+            return {move(ret), data};
+        }
+    }
+
+    Buffer ret{string(len, 0)};
+    char *const data = ret._storage->_data;
+    return {move(ret), data};
+}
+
 void Buffer::remove_prefix(const size_t n) {
     if (n > str().size()) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
-        _storage.reset();
+    _size -= n;
+    if (_size == 0) {
+        _reset();
+    }
+}
+
+void Buffer::remove_suffix(const size_t n) {
+    if (n > str().size()) {
+        throw out_of_range("Buffer::remove_suffix");
+    }
+    _size -= n;
+    if (_size == 0) {
+        _reset();
     }
 }
 
@@ -70,6 +167,14 @@ BufferViewList::BufferViewList(const BufferList &buffers) {
     }
 }
 
+BufferViewList::BufferViewList(const array<string_view, 2> &views) {
+    for (const auto &x : views) {
+        if (not x.empty()) {
+            _views.push_back(x);
+        }
+    }
+}
+
 void BufferViewList::remove_prefix(size_t n) {
     while (n > 0) {
         if (_views.empty()) {
@@ -2,25 +2,98 @@
 #define SPONGE_LIBSPONGE_BUFFER_HH
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <string_view>
 #include <sys/uio.h>
+#include <utility>
 #include <vector>
 
+//! \brief The bytes behind one or more Buffers, with an intrusive reference count
+//! \details The count is not atomic: a Buffer and its copies must stay on one thread (pass bytes
+//! to another thread as a copy()). Storage taken from a BufferPool goes back to the pool of the
+//! thread that drops the last reference.
+class BufferStorage {
+    friend class Buffer;
+    friend class BufferPool;
+
+    size_t _refcount = 1;
+    int _size_class;  //!< Index into BufferPool::BLOCK_SIZES, or -1 for storage that owns `_owned`
+    std::string _owned{};
+    char *_data;
+    BufferStorage *_next_free = nullptr;  //!< Link in the BufferPool free list
+
+    //! Take ownership of a string
+    explicit BufferStorage(std::string &&str) noexcept
+        : _size_class(-1), _owned(std::move(str)), _data(_owned.data()) {}
+
+    //! A pooled block, whose bytes directly follow the BufferStorage in the same allocation
+    explicit BufferStorage(const int size_class) noexcept
+        : _size_class(size_class), _data(reinterpret_cast<char *>(this + 1)) {}
+
+    //! Drop a reference, freeing or recycling the storage when it was the last one
+    void release();
+
+  public:
+    //! \name
+    //! A BufferStorage cannot be copied or moved
+    //!@{
+    BufferStorage(const BufferStorage &other) = delete;
+    BufferStorage &operator=(const BufferStorage &other) = delete;
+    //!@}
+};
+
 //! \brief A reference-counted read-only string that can discard bytes from the front
 class Buffer {
   private:
-    std::shared_ptr<std::string> _storage{};
+    BufferStorage *_storage = nullptr;
     size_t _starting_offset{};
+    size_t _size{};
+
+    //! Drop this Buffer's reference to its storage
+    void _reset() {
+        if (_storage) {
+            _storage->release();
+            _storage = nullptr;
+        }
+    }
 
   public:
     Buffer() = default;
 
     //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    Buffer(std::string &&str) : _storage(new BufferStorage(std::move(str))), _size(_storage->_owned.size()) {}
+
+    //! \brief Allocate `len` bytes from the calling thread's BufferPool (or the heap, if `len` exceeds
+    //! the largest block size)
+    //! \returns the Buffer and a pointer to its bytes, which the caller fills before sharing the Buffer
+    static std::pair<Buffer, char *> allocate(const size_t len);
+
+    //! \name Copy/move constructor/assignment operators
+    //! Copies share the storage and bump its (non-atomic) reference count
+    //!@{
+    Buffer(const Buffer &other) noexcept
+        : _storage(other._storage), _starting_offset(other._starting_offset), _size(other._size) {
+        if (_storage) {
+            ++_storage->_refcount;
+        }
+    }
+    Buffer(Buffer &&other) noexcept
+        : _storage(std::exchange(other._storage, nullptr))
+        , _starting_offset(std::exchange(other._starting_offset, 0))
+        , _size(std::exchange(other._size, 0)) {}
+    Buffer &operator=(Buffer other) noexcept {
+        std::swap(_storage, other._storage);
+        std::swap(_starting_offset, other._starting_offset);
+        std::swap(_size, other._size);
+        return *this;
+    }
+    ~Buffer() { _reset(); }
+    //!@}
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -28,7 +101,7 @@ class Buffer {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        return {_storage->_data + _starting_offset, _size};
     }
 
     operator std::string_view() const { return str(); }
@@ -46,6 +119,62 @@ class Buffer {
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    //! \note Other copies of the Buffer still see the discarded bytes; use this to take a shared slice.
+    void remove_suffix(const size_t n);
+};
+
+//! \brief A thread-local free list of fixed-size blocks that back pooled Buffers
+//! \details Each thread has one pool per size class. Buffer::allocate() takes a block from the
+//! smallest class that fits, and the block returns to the free list when its last Buffer goes away,
+//! so steady-state packet processing stops allocating once the free lists are warm.
+class BufferPool {
+  public:
+    //! Block sizes: one MTU-sized packet, and the largest IPv4 datagram
+    static constexpr std::array<size_t, 2> BLOCK_SIZES{2048, 65536};
+
+    //! Counters for one pool
+    struct Stats {
+        uint64_t hits = 0;       //!< Blocks handed out from the free list
+        uint64_t misses = 0;     //!< Blocks that had to be allocated
+        size_t free_blocks = 0;  //!< Blocks currently in the free list
+    };
+
+  private:
+    int _size_class;
+    size_t _max_free;  //!< Blocks beyond this many are freed instead of kept
+    BufferStorage *_free_list = nullptr;
+    Stats _stats{};
+
+  public:
+    //! Construct an empty pool for blocks of `BLOCK_SIZES[size_class]` bytes
+    BufferPool(const int size_class, const size_t max_free) : _size_class(size_class), _max_free(max_free) {}
+
+    //! Free the blocks in the free list
+    ~BufferPool();
+
+    //! \name
+    //! A BufferPool cannot be copied or moved
+    //!@{
+    BufferPool(const BufferPool &other) = delete;
+    BufferPool &operator=(const BufferPool &other) = delete;
+    //!@}
+
+    //! Take a block from the free list, or allocate one
+    BufferStorage *acquire();
+
+    //! Return a block whose last reference was dropped
+    void recycle(BufferStorage *storage);
+
+    //! Size of the blocks in this pool
+    size_t block_size() const { return BLOCK_SIZES[_size_class]; }
+
+    //! Hit/miss counters for this pool
+    const Stats &stats() const { return _stats; }
+
+    //! \returns the calling thread's pool for blocks of `BLOCK_SIZES[size_class]` bytes
+    static BufferPool &local(const size_t size_class);
 };
 
 //! \brief A reference-counted discontiguous string that can discard bytes from the front
@@ -67,7 +196,7 @@ class BufferList {
     BufferList(Buffer buffer) : _buffers{buffer} {}
 
     //! \brief Construct by taking ownership of a std::string
-    BufferList(std::string &&str) noexcept {
+    BufferList(std::string &&str) {
         Buffer buf{std::move(str)};
         append(buf);
     }
@@ -112,6 +241,9 @@ class BufferViewList {
 
     //! \brief Construct from a std::string_view
     BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
+
+    //! \brief Construct from two std::string_views (e.g. the two halves of a ring buffer); empty views are skipped
+    BufferViewList(const std::array<std::string_view, 2> &views);
     //!@}
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
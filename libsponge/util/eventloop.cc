@@ -2,8 +2,12 @@
 
 #include "util.hh"
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <limits>
 #include <stdexcept>
+#include <sys/epoll.h>
 #include <system_error>
 #include <utility>
 #include <vector>
@@ -14,22 +18,64 @@ unsigned int EventLoop::Rule::service_count() const {
     return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
 
+//! \param[in] backend selects how wait_next_event waits for the fds (see EventLoop::Backend)
+EventLoop::EventLoop(const Backend backend) : _backend(backend), _timers(timestamp_ms()) {
+    if (_backend == Backend::Epoll) {
+        _epoll.emplace(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC)));
+    }
+}
+
 //! \param[in] fd is the FileDescriptor to be polled
 //! \param[in] direction indicates whether to poll for reading (Direction::In) or writing (Direction::Out)
 //! \param[in] callback is called when `fd` is ready.
 //! \param[in] interest is called by EventLoop::wait_next_event. If it returns `true`, `fd` will
 //!                     be polled, otherwise `fd` will be ignored only for this execution of `wait_next_event.
 //! \param[in] cancel is called when the rule is cancelled (e.g. on hangup, EOF, or closure).
+//! \param[in] group is the group whose interest is re-evaluated together with Backend::Epoll
+//!                  (ignored by Backend::Poll, which re-evaluates every Rule on each wait)
 void EventLoop::add_rule(const FileDescriptor &fd,
                          const Direction direction,
                          const CallbackT &callback,
                          const InterestT &interest,
-                         const CallbackT &cancel) {
-    _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+                         const CallbackT &cancel,
+                         const GroupT group) {
+    const auto rule = _rules.insert(_rules.end(), {fd.duplicate(), direction, callback, interest, cancel, group});
+    if (_backend == Backend::Poll) {
+        return;
+    }
+
+    // a closed fd leaves the loop lazily, so its number may already be back in use: drop its Rules first
+    const int fd_num = rule->fd.fd_num();
+    const auto stale = _registrations.find(fd_num);
+    if (stale != _registrations.end()) {
+        for (const auto &slot : {stale->second.in, stale->second.out}) {
+            if (slot and slot.value()->fd.closed()) {
+                _cancel(slot.value());
+            }
+        }
+    }
+
+    // register the fd (for no events yet) the first time a Rule uses it
+    auto [registration, inserted] = _registrations.try_emplace(fd_num);
+    if (inserted) {
+        epoll_event event{0, {}};
+        event.data.fd = fd_num;
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event));
+    }
+    auto &slot = direction == Direction::In ? registration->second.in : registration->second.out;
+    if (slot) {
+        _rules.erase(rule);
+        throw runtime_error("EventLoop: only one rule per fd and direction is supported with Backend::Epoll");
+    }
+    slot = rule;
+
+    _groups[group].push_back(rule);
+    _stale_groups.insert(group);
 }
 
-//! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll); `wait_next_event`
-//!                       returns Result::Timeout if no fd is ready after the timeout expires.
+//! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll) (shortened to the
+//!                       earliest timer deadline); `wait_next_event` returns Result::Timeout if no fd
+//!                       is ready and no timer fired after the timeout expires.
 //! \returns Eventloop::Result indicating success, timeout, or no more Rule objects to poll.
 //!
 //! For each Rule, this function first calls Rule::interest; if `true`, Rule::fd is added to the
@@ -59,6 +105,34 @@ void EventLoop::add_rule(const FileDescriptor &fd,
 //! will result in a busy loop (poll returns on a ready file descriptor; file descriptor is not read or
 //! written, so it is still ready; the next call to poll will immediately return).
 EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
+    const uint64_t start = timestamp_ms();
+    int remaining_ms = timeout_ms;
+    while (true) {
+        const int timeout = _timeout_for_timers(remaining_ms);
+        const auto result = _backend == Backend::Poll ? _wait_poll(timeout) : _wait_epoll(timeout);
+        if (result == Result::Exit) {
+            return result;
+        }
+
+        // a wait cut short by a timer that fired counts as an event
+        const bool timers_fired = _run_expired_timers();
+        if (result != Result::Timeout or timers_fired) {
+            return Result::Success;
+        }
+
+        // the wait may have ended only for the timer wheel to cascade a timer to a lower level
+        // (see TimerWheel::next_deadline); keep waiting for the rest of the caller's timeout
+        if (timeout_ms >= 0) {
+            const uint64_t elapsed = timestamp_ms() - start;
+            if (elapsed >= uint64_t(timeout_ms)) {
+                return Result::Timeout;
+            }
+            remaining_ms = timeout_ms - static_cast<int>(elapsed);
+        }
+    }
+}
+
+EventLoop::Result EventLoop::_wait_poll(const int timeout_ms) {
     vector<pollfd> pollfds{};
     pollfds.reserve(_rules.size());
     bool something_to_poll = false;
@@ -83,13 +157,15 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
             pollfds.push_back({this_rule.fd.fd_num(), static_cast<short>(this_rule.direction), 0});
             something_to_poll = true;
         } else {
-            pollfds.push_back({this_rule.fd.fd_num(), 0, 0});  // placeholder --- we still want errors
+            // placeholder --- we still want errors, but not a hangup that would wake every poll
+            // (poll ignores a negative fd)
+            pollfds.push_back({this_rule.hung_up ? -1 : this_rule.fd.fd_num(), 0, 0});
         }
         ++it;
     }
 
-    // quit if there is nothing left to poll
-    if (not something_to_poll) {
+    // quit if there is nothing left to poll or wait for
+    if (not something_to_poll and _timers.empty()) {
         return Result::Exit;
     }
 
@@ -117,6 +193,9 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
         const auto &this_rule = *it;
         const auto poll_ready = static_cast<bool>(this_pollfd.revents & this_pollfd.events);
         const auto poll_hup = static_cast<bool>(this_pollfd.revents & POLLHUP);
+        if (poll_hup && !this_pollfd.events) {
+            it->hung_up = true;  // leave it out of the poll until the rule is interested again
+        }
         if (poll_hup && this_pollfd.events && !poll_ready) {
             // if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
             //   - if it was POLLIN and nothing is readable, no more will ever be readable
@@ -143,3 +222,208 @@ EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
 
     return Result::Success;
 }
+
+//! \details Same contract as the poll(2) backend, but the fds stay registered between waits: only
+//! stale groups (see EventLoop::interest_changed) have their Rule::interest callbacks re-evaluated,
+//! and only the Rules on ready fds are visited afterwards.
+EventLoop::Result EventLoop::_wait_epoll(const int timeout_ms) {
+    // bring the registrations up to date
+    _stale_groups.insert(DEFAULT_GROUP);
+    for (const auto group : exchange(_stale_groups, {})) {
+        _refresh_group(group);
+    }
+
+    // quit if there is nothing left to poll or wait for
+    if (_polled_rules == 0 and _timers.empty()) {
+        return Result::Exit;
+    }
+
+    // wait until one of the fds satisfies one of the rules (writeable/readable)
+    array<epoll_event, 256> events{};
+    int ready_count = 0;
+    try {
+        ready_count =
+            SystemCall("epoll_wait", ::epoll_wait(_epoll->fd_num(), events.data(), events.size(), timeout_ms));
+    } catch (unix_error const &e) {
+        if (e.code().value() == EINTR) {
+            return Result::Exit;
+        }
+        throw;
+    }
+    if (ready_count == 0) {
+        return Result::Timeout;
+    }
+
+    // go through the ready fds
+    for (int i = 0; i < ready_count; ++i) {
+        const uint32_t revents = events[i].events;
+        if (revents & EPOLLERR) {
+            throw runtime_error("EventLoop: error on polled file descriptor");
+        }
+
+        // a hangup on an fd that no rule is interested in would wake every wait, so leave the
+        // epoll set until a rule is interested again
+        if (revents & EPOLLHUP) {
+            const auto registration = _registrations.find(events[i].data.fd);
+            if (registration != _registrations.end() and registration->second.events == 0) {
+                SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_DEL, events[i].data.fd, nullptr));
+                registration->second.in_epoll = false;
+                continue;
+            }
+        }
+
+        for (const auto direction : {Direction::In, Direction::Out}) {
+            // look the registration up again: an earlier callback may have added or canceled rules
+            const auto registration = _registrations.find(events[i].data.fd);
+            if (registration == _registrations.end()) {
+                break;
+            }
+            const auto &slot = direction == Direction::In ? registration->second.in : registration->second.out;
+            if (not slot or not slot.value()->polled) {
+                continue;
+            }
+
+            // an earlier callback in this batch may have closed the fd (and freed what its Rules use)
+            const auto rule = slot.value();
+            if (rule->fd.closed()) {
+                _cancel(rule);
+                continue;
+            }
+
+            const auto poll_ready = static_cast<bool>(revents & (direction == Direction::In ? EPOLLIN : EPOLLOUT));
+            const auto poll_hup = static_cast<bool>(revents & EPOLLHUP);
+            if (poll_hup and not poll_ready) {
+                // the only condition was a hangup, so this fd is defunct in this direction
+                _cancel(rule);
+                continue;
+            }
+
+            if (poll_ready) {
+                const auto count_before = rule->service_count();
+                rule->callback();
+                _stale_groups.insert(rule->group);
+
+                // only check for busy wait if we're not canceling or exiting
+                if (count_before == rule->service_count() and rule->interest()) {
+                    throw runtime_error(
+                        "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+                }
+            }
+        }
+    }
+
+    return Result::Success;
+}
+
+//! \param[in] group is the group whose Rules are re-evaluated
+void EventLoop::_refresh_group(const GroupT group) {
+    const auto rules = _groups.find(group);
+    if (rules == _groups.end()) {
+        return;
+    }
+
+    // copy the list, since canceling a Rule removes it from the group
+    for (const auto rule : vector<RuleIterT>(rules->second)) {
+        if ((rule->direction == Direction::In and rule->fd.eof()) or rule->fd.closed()) {
+            // no more reading or writing on this rule
+            _cancel(rule);
+            continue;
+        }
+
+        const bool interested = rule->interest();
+        if (interested != rule->polled) {
+            rule->polled = interested;
+            if (interested) {
+                ++_polled_rules;
+            } else {
+                --_polled_rules;
+            }
+            _update_registration(*rule);
+        }
+    }
+}
+
+//! \param[in] rule is any Rule on the fd whose registration should change
+void EventLoop::_update_registration(const Rule &rule) {
+    if (rule.fd.closed()) {
+        return;  // a closed fd has already left the epoll set
+    }
+    const int fd_num = rule.fd.fd_num();
+    auto &registration = _registrations.at(fd_num);
+
+    uint32_t events = 0;
+    if (registration.in and registration.in.value()->polled) {
+        events |= EPOLLIN;
+    }
+    if (registration.out and registration.out.value()->polled) {
+        events |= EPOLLOUT;
+    }
+    if (events == registration.events) {
+        return;
+    }
+
+    epoll_event event{events, {}};
+    event.data.fd = fd_num;
+    if (registration.in_epoll) {
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event));
+    } else {
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event));
+        registration.in_epoll = true;
+    }
+    registration.events = events;
+}
+
+//! \param[in] rule is the Rule to cancel
+void EventLoop::_cancel(const RuleIterT rule) {
+    rule->cancel();
+
+    const int fd_num = rule->fd.fd_num();
+    auto registration = _registrations.find(fd_num);
+    (rule->direction == Direction::In ? registration->second.in : registration->second.out).reset();
+    if (rule->polled) {
+        rule->polled = false;
+        --_polled_rules;
+    }
+    if (registration->second.in or registration->second.out) {
+        _update_registration(*rule);
+    } else {
+        // a closed fd has already left the epoll set
+        if (registration->second.in_epoll and not rule->fd.closed()) {
+            SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr));
+        }
+        _registrations.erase(registration);
+    }
+
+    auto &group = _groups.at(rule->group);
+    group.erase(find(group.begin(), group.end(), rule));
+    if (group.empty()) {
+        _groups.erase(rule->group);
+    }
+    _rules.erase(rule);
+}
+
+//! \param[in] deadline_ms is the value of timestamp_ms() at which the timer fires
+//! \param[in] callback is called once, after the wait in which the deadline passes
+EventLoop::TimerIdT EventLoop::add_timer(const uint64_t deadline_ms, const CallbackT &callback) {
+    return _timers.schedule(deadline_ms, callback);
+}
+
+//! \param[in] id is the timer to cancel
+void EventLoop::cancel_timer(const TimerIdT id) { _timers.cancel(id); }
+
+//! \param[in] timeout_ms is the caller's timeout (negative means no timeout)
+int EventLoop::_timeout_for_timers(const int timeout_ms) const {
+    const auto deadline = _timers.next_deadline();
+    if (not deadline.has_value()) {
+        return timeout_ms;
+    }
+
+    const uint64_t now = timestamp_ms();
+    const uint64_t until_deadline = deadline.value() > now ? deadline.value() - now : 0;
+    if (timeout_ms >= 0 and uint64_t(timeout_ms) <= until_deadline) {
+        return timeout_ms;
+    }
+    return static_cast<int>(min<uint64_t>(until_deadline, numeric_limits<int>::max()));
+}
+
+bool EventLoop::_run_expired_timers() { return _timers.advance(timestamp_ms()) > 0; }
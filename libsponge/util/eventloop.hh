@@ -2,11 +2,17 @@
 #define SPONGE_LIBSPONGE_EVENTLOOP_HH
 
 #include "file_descriptor.hh"
+#include "timer_wheel.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <optional>
 #include <poll.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
@@ -17,6 +23,28 @@ class EventLoop {
         Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    //! How the EventLoop waits for its file descriptors
+    enum class Backend {
+        Poll,  //!< Build a pollfd for every Rule and call [poll(2)](\ref man2::poll) on each wait
+        Epoll  //!< Keep every fd registered with [epoll(7)](\ref man7::epoll) and only touch ready Rules
+    };
+
+    //! Identifies Rules whose interest callbacks depend on the same state (e.g. one connection)
+    using GroupT = size_t;
+
+    //! Rules in this group have their interest re-evaluated before every wait, whatever the Backend
+    static constexpr GroupT DEFAULT_GROUP = 0;
+
+    //! Identifies a timer added with EventLoop::add_timer
+    using TimerIdT = TimerWheel::IdT;
+
+    //! Returned by each call to EventLoop::wait_next_event.
+    enum class Result {
+        Success,  //!< At least one Rule was triggered.
+        Timeout,  //!< No rules were triggered before timeout.
+        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    };
+
   private:
     using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
     using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
@@ -25,11 +53,14 @@ class EventLoop {
     //! \details Created by calling EventLoop::add_rule() or EventLoop::add_cancelable_rule().
     class Rule {
       public:
-        FileDescriptor fd;    //!< FileDescriptor to monitor for activity.
-        Direction direction;  //!< Direction::In for reading from fd, Direction::Out for writing to fd.
-        CallbackT callback;   //!< A callback that reads or writes fd.
-        InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
-        CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        FileDescriptor fd;     //!< FileDescriptor to monitor for activity.
+        Direction direction;   //!< Direction::In for reading from fd, Direction::Out for writing to fd.
+        CallbackT callback;    //!< A callback that reads or writes fd.
+        InterestT interest;    //!< A callback that returns `true` whenever fd should be polled.
+        CallbackT cancel;      //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        GroupT group;          //!< Group whose interest is re-evaluated together (Backend::Epoll)
+        bool polled = false;   //!< Whether fd is currently registered for `direction` (Backend::Epoll)
+        bool hung_up = false;  //!< Whether fd hung up while the rule was not interested (Backend::Poll)
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
@@ -38,22 +69,71 @@ class EventLoop {
 
     std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
 
-  public:
-    //! Returned by each call to EventLoop::wait_next_event.
-    enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
-        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    using RuleIterT = std::list<Rule>::iterator;
+
+    //! The Rules on one fd registered with epoll, and the events it is registered for
+    struct Registration {
+        std::optional<RuleIterT> in{};   //!< Rule with Direction::In, if any
+        std::optional<RuleIterT> out{};  //!< Rule with Direction::Out, if any
+        uint32_t events = 0;             //!< Events the fd is currently registered for
+        bool in_epoll = true;            //!< `false` after a hangup while no Rule was interested
     };
 
+    Backend _backend;
+    std::optional<FileDescriptor> _epoll{};                        //!< The epoll instance (Backend::Epoll)
+    std::unordered_map<int, Registration> _registrations{};        //!< Registrations by fd number
+    std::unordered_map<GroupT, std::vector<RuleIterT>> _groups{};  //!< Rules by group
+    std::unordered_set<GroupT> _stale_groups{};  //!< Groups whose interest must be re-evaluated before the next wait
+    size_t _polled_rules = 0;                    //!< Number of Rules currently registered for their direction
+
+    TimerWheel _timers;  //!< Pending timers
+
+    //! \returns `timeout_ms`, shortened so that the wait ends by the earliest pending timer deadline
+    int _timeout_for_timers(const int timeout_ms) const;
+
+    //! Run the callbacks of the timers whose deadline has passed
+    //! \returns `true` if any timer fired
+    bool _run_expired_timers();
+
+    //! Wait with Backend::Poll
+    Result _wait_poll(const int timeout_ms);
+
+    //! Wait with Backend::Epoll
+    Result _wait_epoll(const int timeout_ms);
+
+    //! Cancel stale Rules and bring the epoll registrations of a group up to date with its interest callbacks
+    void _refresh_group(const GroupT group);
+
+    //! Re-register a Rule's fd for the events its Rules are interested in
+    void _update_registration(const Rule &rule);
+
+    //! Call Rule::cancel and delete the Rule, deregistering its fd (Backend::Epoll)
+    void _cancel(const RuleIterT rule);
+
+  public:
+    //! Construct an EventLoop that waits with the specified Backend
+    explicit EventLoop(const Backend backend = Backend::Poll);
+
     //! Add a rule whose callback will be called when `fd` is ready in the specified Direction.
     void add_rule(const FileDescriptor &fd,
                   const Direction direction,
                   const CallbackT &callback,
                   const InterestT &interest = [] { return true; },
-                  const CallbackT &cancel = [] {});
+                  const CallbackT &cancel = [] {},
+                  const GroupT group = DEFAULT_GROUP);
+
+    //! \brief Re-evaluate the interest of the Rules in `group` before the next wait
+    //! \details Needed with Backend::Epoll when the group's state changes outside its own callbacks
+    void interest_changed(const GroupT group) { _stale_groups.insert(group); }
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! \brief Call `callback` once, from wait_next_event, when timestamp_ms() reaches `deadline_ms`
+    //! \returns an id that can be passed to cancel_timer()
+    TimerIdT add_timer(const uint64_t deadline_ms, const CallbackT &callback);
+
+    //! Cancel a timer that has not fired yet (canceling a timer that already fired does nothing)
+    void cancel_timer(const TimerIdT id);
+
+    //! Waits for ready fds (with the Backend chosen at construction) and then executes callback for each.
     Result wait_next_event(const int timeout_ms);
 };
 
@@ -72,5 +152,18 @@ using Direction = EventLoop::Direction;
 //! A Rule installed using EventLoop::add_cancelable_rule will be polled and canceled under the
 //! same conditions, with the additional condition that if Rule::callback returns `true`, the
 //! Rule will be canceled.
+//!
+//! With Backend::Epoll, each fd is registered with [epoll(7)](\ref man7::epoll) once, and a wait only
+//! visits the Rules on ready fds. Rule::interest is re-evaluated only for the Rules in
+//! EventLoop::DEFAULT_GROUP, for the groups of Rules whose callbacks just ran, and for groups passed to
+//! EventLoop::interest_changed; the registration is modified only when the answer changes. Rules that
+//! share state (e.g. the fds of one connection) should therefore share a group, and independent
+//! connections should use different groups so that one loop can serve thousands of fds.
+//!
+//! Timers added with EventLoop::add_timer shorten the wait so that it ends at the earliest
+//! deadline, and their callbacks run at the end of the wait_next_event call in which they expire.
+//! They are kept in a TimerWheel, so adding, canceling and expiring a timer cost the same
+//! however many timers (e.g. one per connection) are pending.
+//! An EventLoop with pending timers keeps waiting even when no Rule is interested.
 
 #endif  // SPONGE_LIBSPONGE_EVENTLOOP_HH
@@ -50,17 +50,24 @@ void FileDescriptor::read(std::string &str, const size_t limit) {
     constexpr size_t BUFFER_SIZE = 1024 * 1024;  // maximum size of a read
     const size_t size_to_read = min(BUFFER_SIZE, limit);
     str.resize(size_to_read);
+    str.resize(read(str.data(), size_to_read));
+}
 
-    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read));
+//! \param[out] buf is the memory to read into; it must have room for `limit` bytes
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be read
+//! \returns the number of bytes read
+size_t FileDescriptor::read(char *buf, const size_t limit) {
+    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), buf, limit));
     if (limit > 0 && bytes_read == 0) {
         _internal_fd->_eof = true;
     }
-    if (bytes_read > static_cast<ssize_t>(size_to_read)) {
+    if (bytes_read > static_cast<ssize_t>(limit)) {
         throw runtime_error("read() read more than requested");
     }
-    str.resize(bytes_read);
 
     register_read();
+
+    return bytes_read;
 }
 
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
@@ -73,6 +80,15 @@ string FileDescriptor::read(const size_t limit) {
     return ret;
 }
 
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
+//! \returns a Buffer holding the bytes read, backed by the smallest BufferPool block that fits `limit`
+Buffer FileDescriptor::read_buffer(const size_t limit) {
+    auto [ret, buf] = Buffer::allocate(limit);
+    const size_t bytes_read = read(buf, limit);
+    ret.remove_suffix(ret.size() - bytes_read);
+    return move(ret);
+}
+
 size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     size_t total_bytes_written = 0;
 
@@ -98,6 +114,45 @@ size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     return total_bytes_written;
 }
 
+//! \details Same as write(BufferViewList), but the `iovec`s live on the stack
+size_t FileDescriptor::write(const array<string_view, 2> &views, const bool write_all) {
+    array<string_view, 2> remaining = views;
+    size_t total_bytes_written = 0;
+
+    do {
+        array<iovec, 2> iovecs{};
+        size_t iovec_count = 0;
+        for (const auto &view : remaining) {
+            if (not view.empty()) {
+                iovecs[iovec_count++] = {const_cast<char *>(view.data()), view.size()};
+            }
+        }
+        const size_t remaining_size = remaining[0].size() + remaining[1].size();
+
+        const ssize_t bytes_written = SystemCall("writev", ::writev(fd_num(), iovecs.data(), iovec_count));
+        if (bytes_written == 0 and remaining_size != 0) {
+            throw runtime_error("write returned 0 given non-empty input buffer");
+        }
+
+        if (bytes_written > ssize_t(remaining_size)) {
+            throw runtime_error("write wrote more than length of input buffer");
+        }
+
+        register_write();
+
+        size_t to_remove = bytes_written;
+        for (auto &view : remaining) {
+            const size_t n = min(to_remove, view.size());
+            view.remove_prefix(n);
+            to_remove -= n;
+        }
+
+        total_bytes_written += bytes_written;
+    } while (write_all and remaining[0].size() + remaining[1].size());
+
+    return total_bytes_written;
+}
+
 void FileDescriptor::set_blocking(const bool blocking_state) {
     int flags = SystemCall("fcntl", fcntl(fd_num(), F_GETFL));
     if (blocking_state) {
@@ -61,6 +61,13 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read up to `limit` bytes into caller-owned memory at `buf`
+    //! \returns the number of bytes read
+    size_t read(char *buf, const size_t limit);
+
+    //! Read up to `limit` bytes (e.g. one packet) into a pooled Buffer
+    Buffer read_buffer(const size_t limit = BufferPool::BLOCK_SIZES.back());
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
@@ -70,6 +77,9 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write two pieces (e.g. headers and payload) with one writev(2), without allocating
+    size_t write(const std::array<std::string_view, 2> &views, const bool write_all = true);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
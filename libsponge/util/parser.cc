@@ -1,5 +1,8 @@
 #include "parser.hh"
 
+#include <cstring>
+#include <endian.h>
+
 using namespace std;
 
 //! \param[in] r is the ParseResult to show
@@ -50,6 +53,28 @@ void NetParser::remove_prefix(const size_t n) {
     _buffer.remove_prefix(n);
 }
 
+const uint8_t *NetParser::take(const size_t n) {
+    _check_size(n);
+    if (error()) {
+        return nullptr;
+    }
+    _taken = _buffer;  // removing the last bytes of a Buffer releases its storage
+    _buffer.remove_prefix(n);
+    return reinterpret_cast<const uint8_t *>(_taken.str().data());
+}
+
+uint32_t NetParser::u32(const uint8_t *src) {
+    uint32_t ret;
+    memcpy(&ret, src, sizeof(ret));
+    return be32toh(ret);
+}
+
+uint16_t NetParser::u16(const uint8_t *src) {
+    uint16_t ret;
+    memcpy(&ret, src, sizeof(ret));
+    return be16toh(ret);
+}
+
 template <typename T>
 void NetUnparser::_unparse_int(string &s, T val) {
     constexpr size_t len = sizeof(T);
@@ -70,3 +95,22 @@ void NetUnparser::u32(string &s, const uint32_t val) { return _unparse_int<uint3
 void NetUnparser::u16(string &s, const uint16_t val) { return _unparse_int<uint16_t>(s, val); }
 
 void NetUnparser::u8(string &s, const uint8_t val) { return _unparse_int<uint8_t>(s, val); }
+
+uint8_t *NetUnparser::u32(uint8_t *dst, const uint32_t val) {
+    dst[0] = val >> 24;
+    dst[1] = val >> 16;
+    dst[2] = val >> 8;
+    dst[3] = val;
+    return dst + 4;
+}
+
+uint8_t *NetUnparser::u16(uint8_t *dst, const uint16_t val) {
+    dst[0] = val >> 8;
+    dst[1] = val;
+    return dst + 2;
+}
+
+uint8_t *NetUnparser::u8(uint8_t *dst, const uint8_t val) {
+    dst[0] = val;
+    return dst + 1;
+}
@@ -25,6 +25,7 @@ std::string as_string(const ParseResult r);
 class NetParser {
   private:
     Buffer _buffer;
+    Buffer _taken{};  //!< Keeps the bytes returned by take() alive after they leave `_buffer`
     ParseResult _error = ParseResult::NoError;  //!< Result of parsing so far
 
     //! Check that there is sufficient data to parse the next token
@@ -60,6 +61,25 @@ class NetParser {
 
     //! Remove n bytes from the buffer
     void remove_prefix(const size_t n);
+
+    //! \brief Remove `n` bytes from the buffer after checking their size once, for decoding a fixed-size header
+    //! \returns a pointer to the removed bytes (valid until the next call to take() or the
+    //! NetParser's destruction), or `nullptr` if there were fewer than `n` bytes
+    const uint8_t *take(const size_t n);
+
+    //! \name Decoding from a raw position
+    //! Bulk loads for the bytes returned by take(); these do no bounds checking.
+    //!@{
+
+    //! Decode a 32-bit integer in network byte order
+    static uint32_t u32(const uint8_t *src);
+
+    //! Decode a 16-bit integer in network byte order
+    static uint16_t u16(const uint8_t *src);
+
+    //! Decode an 8-bit integer
+    static uint8_t u8(const uint8_t *src) { return *src; }
+    //!@}
 };
 
 struct NetUnparser {
@@ -74,6 +94,21 @@ struct NetUnparser {
 
     //! Write an 8-bit integer into the data stream in network byte order
     static void u8(std::string &s, const uint8_t val);
+
+    //! \name Writing into a caller-provided buffer
+    //! These write in place and return the position just past the integer, so that consecutive
+    //! fields can be chained without allocating.
+    //!@{
+
+    //! Write a 32-bit integer to `dst` in network byte order
+    static uint8_t *u32(uint8_t *dst, const uint32_t val);
+
+    //! Write a 16-bit integer to `dst` in network byte order
+    static uint8_t *u16(uint8_t *dst, const uint16_t val);
+
+    //! Write an 8-bit integer to `dst`
+    static uint8_t *u8(uint8_t *dst, const uint8_t val);
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_PARSER_HH
@@ -2,9 +2,15 @@
 
 #include "util.hh"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <unistd.h>
+#include <vector>
 
 using namespace std;
 
@@ -141,6 +147,112 @@ void UDPSocket::send(const BufferViewList &payload) {
     register_write();
 }
 
+//! Room for one control message carrying a UDP_GRO or UDP_SEGMENT segment size
+union segment_size_control {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    cmsghdr align;
+};
+
+//! \details Uses [recvmmsg(2)](\ref man2::recvmmsg) with `MSG_WAITFORONE`: like recv(), the call
+//! blocks until a datagram arrives (unless the socket is non-blocking), and then takes whichever
+//! others are already queued. A datagram longer than its slot is truncated, and its slot's `length`
+//! says how long it was. After set_gro(), a slot may hold several datagrams coalesced by the
+//! kernel, all `segment_size` long but the last, which may be shorter.
+//! \param[in,out] slots are where to receive the datagrams; `buffer` and `capacity` must be set
+//! \param[in] count is the number of slots (at most MAX_BATCH are used)
+//! \returns the number of datagrams received, which is 0 if the socket is non-blocking and none was waiting
+size_t UDPSocket::recv_batch(batch_slot *slots, const size_t count) {
+    const size_t batch = min(count, MAX_BATCH);
+    array<mmsghdr, MAX_BATCH> messages{};
+    array<iovec, MAX_BATCH> iovecs{};
+    array<segment_size_control, MAX_BATCH> controls{};
+    for (size_t i = 0; i < batch; i++) {
+        iovecs[i] = {slots[i].buffer, slots[i].capacity};
+        messages[i].msg_hdr.msg_name = static_cast<sockaddr *>(slots[i].source_address);
+        messages[i].msg_hdr.msg_namelen = sizeof(slots[i].source_address.storage);
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = controls[i].buffer;
+        messages[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+    }
+
+    const int received = SystemCall(
+        "recvmmsg", ::recvmmsg(fd_num(), messages.data(), batch, MSG_WAITFORONE | MSG_TRUNC, nullptr), EAGAIN);
+    if (received < 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < received; i++) {
+        slots[i].source_address_len = messages[i].msg_hdr.msg_namelen;
+        slots[i].length = messages[i].msg_len;
+        slots[i].segment_size = 0;
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO) {
+                int segment_size = 0;
+                memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+                slots[i].segment_size = segment_size;
+            }
+        }
+    }
+    register_read();
+    return received;
+}
+
+//! \details Uses [sendmmsg(2)](\ref man2::sendmmsg). On a blocking socket every datagram is sent
+//! unless an error occurs; on a non-blocking one, sending stops when the socket buffer is full.
+//! A datagram with a `segment_size` shorter than its payload is cut into several by the kernel
+//! (UDP GSO), all `segment_size` long but the last; it still counts as one datagram here.
+//! \param[in] datagrams are the datagrams to send
+//! \param[in] count is the number of datagrams (at most MAX_BATCH are sent)
+//! \returns the number of datagrams sent, which is 0 if the socket is non-blocking and its buffer was full
+size_t UDPSocket::sendto_batch(const outgoing_datagram *datagrams, const size_t count) {
+    const size_t batch = min(count, MAX_BATCH);
+    array<mmsghdr, MAX_BATCH> messages{};
+    array<segment_size_control, MAX_BATCH> controls{};
+    // reserve every iovec up front, since each message points into the vector
+    size_t total_buffers = 0;
+    for (size_t i = 0; i < batch; i++) {
+        total_buffers += datagrams[i].payload.buffers().size();
+    }
+    vector<iovec> iovecs;
+    iovecs.reserve(total_buffers);
+    for (size_t i = 0; i < batch; i++) {
+        const size_t first_iovec = iovecs.size();
+        for (const auto &buffer : datagrams[i].payload.buffers()) {
+            iovecs.push_back({const_cast<char *>(buffer.str().data()), buffer.size()});
+        }
+        messages[i].msg_hdr.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(datagrams[i].destination));
+        messages[i].msg_hdr.msg_namelen = datagrams[i].destination.size();
+        messages[i].msg_hdr.msg_iov = iovecs.data() + first_iovec;
+        messages[i].msg_hdr.msg_iovlen = iovecs.size() - first_iovec;
+
+        if (datagrams[i].segment_size and datagrams[i].segment_size < datagrams[i].payload.size()) {
+            messages[i].msg_hdr.msg_control = controls[i].buffer;
+            messages[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const uint16_t segment_size = datagrams[i].segment_size;
+            memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+    }
+
+    const int sent = SystemCall("sendmmsg", ::sendmmsg(fd_num(), messages.data(), batch, 0), EAGAIN);
+    if (sent < 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < sent; i++) {
+        if (messages[i].msg_len != datagrams[i].payload.size()) {
+            throw runtime_error("datagram payload too big for sendmmsg()");
+        }
+    }
+    register_write();
+    return sent;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen(const int backlog) { SystemCall("listen", ::listen(fd_num(), backlog)); }
@@ -166,3 +278,20 @@ void Socket::setsockopt(const int level, const int option, const option_type &op
 // allow local address to be reused sooner, at the cost of some robustness
 //! \note Using `SO_REUSEADDR` may reduce the robustness of your application
 void Socket::set_reuseaddr() { setsockopt(SOL_SOCKET, SO_REUSEADDR, int(true)); }
+
+// let several sockets share one local address, e.g. one per thread
+void Socket::set_reuseport() { setsockopt(SOL_SOCKET, SO_REUSEPORT, int(true)); }
+
+// ask the kernel to coalesce received datagrams of one flow
+void UDPSocket::set_gro() { setsockopt(SOL_UDP, UDP_GRO, int(true)); }
+
+// set the GSO segment size of datagrams sent without a UDP_SEGMENT control message
+//! \param[in] size is the length of each datagram cut from a payload, or 0 not to cut payloads
+void UDPSocket::set_gso_size(const uint16_t size) { setsockopt(SOL_UDP, UDP_SEGMENT, int(size)); }
+
+// a connected pair of Unix-domain sockets, e.g. to wake a thread or to carry a stream to it
+pair<FileDescriptor, FileDescriptor> socket_pair_helper(const int type) {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, type, 0, static_cast<int *>(fds)));
+    return {FileDescriptor(fds[0]), FileDescriptor(fds[1])};
+}
@@ -2,12 +2,14 @@
 #define SPONGE_LIBSPONGE_SOCKET_HH
 
 #include "address.hh"
+#include "buffer.hh"
 #include "file_descriptor.hh"
 
 #include <cstdint>
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <utility>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -45,6 +47,10 @@ class Socket : public FileDescriptor {
 
     //! Allow local address to be reused sooner via [SO_REUSEADDR](\ref man7::socket)
     void set_reuseaddr();
+
+    //! Let several sockets bind the same address, with the kernel spreading flows among them
+    //! ([SO_REUSEPORT](\ref man7::socket))
+    void set_reuseport();
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
@@ -75,6 +81,41 @@ class UDPSocket : public Socket {
 
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
+
+    //! Most datagrams that one call to recv_batch() or sendto_batch() handles
+    static constexpr size_t MAX_BATCH = 64;
+
+    //! Where recv_batch() puts one datagram, and what it learns about it
+    struct batch_slot {
+        char *buffer = nullptr;            //!< Storage for the payload, provided by the caller
+        size_t capacity = 0;               //!< Size of `buffer`
+        Address::Raw source_address{};     //!< Address from which the datagram was received
+        socklen_t source_address_len = 0;  //!< Size of `source_address`
+        size_t length = 0;                 //!< Length of the payload (more than `capacity` if it was truncated)
+        size_t segment_size = 0;           //!< With GRO, length of each coalesced datagram but the last (or 0)
+    };
+
+    //! One datagram for sendto_batch()
+    struct outgoing_datagram {
+        Address destination;      //!< Address to send the datagram to
+        BufferList payload;       //!< UDP datagram payload
+        size_t segment_size = 0;  //!< With GSO, cut the payload into datagrams this long (0 means don't)
+    };
+
+    //! \brief Receive up to `count` datagrams with one system call, waiting only until the first is available
+    //! \returns the number of datagrams received, in `slots[0]` onwards (0 if a non-blocking socket had none)
+    size_t recv_batch(batch_slot *slots, const size_t count);
+
+    //! \brief Send up to `count` datagrams to their destinations with one system call
+    //! \returns the number of datagrams sent, from `datagrams[0]` onwards (0 if a non-blocking socket's buffer is full)
+    size_t sendto_batch(const outgoing_datagram *datagrams, const size_t count);
+
+    //! Let recv_batch() return datagrams that the kernel coalesced ([UDP_GRO](\ref man7::udp))
+    void set_gro();
+
+    //! \brief Set the GSO segment size of datagrams sent without one of their own ([UDP_SEGMENT](\ref man7::udp))
+    //! \details 0 sends each payload as one datagram; setting it fails if the kernel lacks UDP GSO.
+    void set_gso_size(const uint16_t size);
 };
 
 //! \class UDPSocket
@@ -121,4 +162,9 @@ class LocalStreamSocket : public Socket {
 //!
 //! \include socket_example_3.cc
 
+//! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
+//! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
+//! \returns a std::pair of connected sockets
+std::pair<FileDescriptor, FileDescriptor> socket_pair_helper(const int type);
+
 #endif  // SPONGE_LIBSPONGE_SOCKET_HH
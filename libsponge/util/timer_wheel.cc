@@ -0,0 +1,127 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+//! \returns the first time at which slot `index` of `level` is reached, starting from `now`
+static uint64_t slot_start(const uint64_t now, const size_t level, const size_t index) {
+    const size_t span_bits = TimerWheel::SLOT_BITS * (level + 1);
+    return ((now >> span_bits) << span_bits) | (uint64_t{index} << (TimerWheel::SLOT_BITS * level));
+}
+
+TimerWheel::SlotT &TimerWheel::_slot(const size_t level, const size_t index) {
+    return level == LEVELS ? _overflow : _slots.at(level).at(index);
+}
+
+//! \details A timer goes to the lowest level whose current rotation contains its deadline,
+//! so each level only ever holds timers in slots it has not reached yet. Timers that are
+//! already due go to the current slot of the first level.
+//! \param[in] from is the list that currently holds the timer
+//! \param[in] timer is the timer to move
+void TimerWheel::_place(SlotT &from, const SlotT::iterator timer) {
+    const uint64_t deadline = max(timer->deadline, _now);
+
+    size_t level = 0;
+    while (level < LEVELS and (deadline >> (SLOT_BITS * (level + 1))) != (_now >> (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    const size_t index = level == LEVELS ? 0 : (deadline >> (SLOT_BITS * level)) % SLOTS;
+
+    SlotT &slot = _slot(level, index);
+    slot.splice(slot.end(), from, timer);
+    if (level < LEVELS) {
+        _occupied[level] |= uint64_t{1} << index;
+    }
+    _locations.insert_or_assign(timer->id, Location{level, index, timer});
+}
+
+//! \param[in] level is the level of the slot, or LEVELS for the overflow list
+//! \param[in] index is the index of the slot within its level
+void TimerWheel::_cascade(const size_t level, const size_t index) {
+    SlotT timers;
+    timers.splice(timers.end(), _slot(level, index));
+    if (level < LEVELS) {
+        _occupied[level] &= ~(uint64_t{1} << index);
+    }
+    while (not timers.empty()) {
+        _place(timers, timers.begin());
+    }
+}
+
+//! \param[in] deadline_ms is the time at which the timer expires
+//! \param[in] callback is called once, from the call to advance() that reaches `deadline_ms`
+TimerWheel::IdT TimerWheel::schedule(const uint64_t deadline_ms, const CallbackT &callback) {
+    const IdT id = _next_id++;
+    SlotT timer;
+    timer.push_back({id, deadline_ms, callback});
+    _place(timer, timer.begin());
+    return id;
+}
+
+//! \param[in] id is the timer to cancel
+void TimerWheel::cancel(const IdT id) {
+    const auto location = _locations.find(id);
+    if (location == _locations.end()) {
+        return;
+    }
+
+    const auto [level, index, timer] = location->second;
+    SlotT &slot = _slot(level, index);
+    slot.erase(timer);
+    if (level < LEVELS and slot.empty()) {
+        _occupied[level] &= ~(uint64_t{1} << index);
+    }
+    _locations.erase(location);
+}
+
+optional<uint64_t> TimerWheel::next_deadline() const {
+    for (size_t level = 0; level < LEVELS; ++level) {
+        const size_t current = (_now >> (SLOT_BITS * level)) % SLOTS;
+        const uint64_t ahead = _occupied[level] & (~uint64_t{0} << current);
+        if (ahead) {
+            return max(_now, slot_start(_now, level, __builtin_ctzll(ahead)));
+        }
+    }
+    if (not _overflow.empty()) {
+        return slot_start(_now, LEVELS - 1, SLOTS - 1) + (uint64_t{1} << (SLOT_BITS * (LEVELS - 1)));
+    }
+    return {};
+}
+
+//! \details Jumps straight from one non-empty slot to the next, so the cost does not depend
+//! on how much time has passed.
+//! \param[in] now_ms is the current time
+size_t TimerWheel::advance(const uint64_t now_ms) {
+    size_t expired = 0;
+    for (auto tick = next_deadline(); tick.has_value() and tick.value() <= now_ms; tick = next_deadline()) {
+        _now = tick.value();
+
+        // bring timers down from the slots that start now, highest level first
+        if (_now % (uint64_t{1} << (SLOT_BITS * LEVELS)) == 0 and not _overflow.empty()) {
+            _cascade(LEVELS, 0);
+        }
+        for (size_t level = LEVELS - 1; level > 0; --level) {
+            const size_t index = (_now >> (SLOT_BITS * level)) % SLOTS;
+            if (_now % (uint64_t{1} << (SLOT_BITS * level)) == 0 and (_occupied[level] & (uint64_t{1} << index))) {
+                _cascade(level, index);
+            }
+        }
+
+        const size_t index = _now % SLOTS;
+        SlotT &slot = _slots[0][index];
+        while (not slot.empty()) {
+            const CallbackT callback = move(slot.front().callback);
+            _locations.erase(slot.front().id);
+            slot.pop_front();
+            if (slot.empty()) {
+                _occupied[0] &= ~(uint64_t{1} << index);
+            }
+            callback();  // may schedule or cancel timers
+            ++expired;
+        }
+    }
+
+    _now = max(_now, now_ms);
+    return expired;
+}
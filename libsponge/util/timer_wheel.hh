@@ -0,0 +1,90 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+//! \brief A hierarchical timer wheel with millisecond resolution
+//! \details Scheduling and canceling a timer take constant time, and advancing the wheel
+//! only visits timers that expire (plus each timer once per level it cascades through),
+//! however many timers are pending.
+class TimerWheel {
+  public:
+    using IdT = uint64_t;                         //!< Identifies a scheduled timer
+    using CallbackT = std::function<void(void)>;  //!< Called when a timer expires
+
+    static constexpr size_t SLOT_BITS = 6;                   //!< log2 of the number of slots per level
+    static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;  //!< Number of slots per level
+    static constexpr size_t LEVELS = 4;                      //!< Number of levels (together they span ~4.6 hours)
+
+  private:
+    //! A pending timer
+    struct Timer {
+        IdT id;              //!< The timer's id
+        uint64_t deadline;   //!< Time at which the timer expires
+        CallbackT callback;  //!< Called when the timer expires
+    };
+
+    using SlotT = std::list<Timer>;
+
+    //! Where a pending timer is stored
+    struct Location {
+        size_t level;           //!< Level of the slot, or LEVELS for the overflow list
+        size_t index;           //!< Index of the slot within its level
+        SlotT::iterator timer;  //!< The timer within its slot
+    };
+
+    uint64_t _now;  //!< Time up to which the wheel has advanced
+
+    //! Slots of each level; a timer at level `l` expires within slot `(deadline >> (SLOT_BITS * l)) % SLOTS`
+    std::array<std::array<SlotT, SLOTS>, LEVELS> _slots{};
+    std::array<uint64_t, LEVELS> _occupied{};        //!< Bitmap of the non-empty slots of each level
+    SlotT _overflow{};                               //!< Timers beyond the range of the last level
+    std::unordered_map<IdT, Location> _locations{};  //!< Where each pending timer is stored
+    IdT _next_id = 0;
+
+    //! Returns the slot at (`level`, `index`), or the overflow list if `level` is LEVELS
+    SlotT &_slot(const size_t level, const size_t index);
+
+    //! Move a timer out of `from` into the slot where its deadline belongs
+    void _place(SlotT &from, const SlotT::iterator timer);
+
+    //! Reinsert the timers of a slot (or of the overflow list) at the levels below it
+    void _cascade(const size_t level, const size_t index);
+
+  public:
+    //! Construct a wheel whose current time is `now_ms`
+    explicit TimerWheel(const uint64_t now_ms) : _now(now_ms) {}
+
+    //! \brief Call `callback` once, from advance(), when the time reaches `deadline_ms`
+    //! \returns an id that can be passed to cancel()
+    IdT schedule(const uint64_t deadline_ms, const CallbackT &callback);
+
+    //! Cancel a pending timer (canceling a timer that already expired does nothing)
+    void cancel(const IdT id);
+
+    //! \brief Advance the wheel to `now_ms`, calling the callbacks of the timers that expire
+    //! \returns the number of timers that expired
+    size_t advance(const uint64_t now_ms);
+
+    //! \brief The next time at which advance() has work to do (empty if no timer is pending)
+    //! \details This is the earliest pending deadline, unless the earliest timer still has to cascade
+    //! to a lower level, in which case it is the (earlier) time of that cascade.
+    std::optional<uint64_t> next_deadline() const;
+
+    //! Number of pending timers
+    size_t size() const { return _locations.size(); }
+
+    //! `true` if no timer is pending
+    bool empty() const { return _locations.empty(); }
+
+    //! Time up to which the wheel has advanced
+    uint64_t now() const { return _now; }
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH
@@ -0,0 +1,58 @@
+#include "toeplitz_hash.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+const ToeplitzHash::KeyT ToeplitzHash::DEFAULT_KEY = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
+    0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
+    0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa};
+
+//! \returns the 32 bits of `key` that start `bit` bits from its beginning
+static uint32_t key_window(const ToeplitzHash::KeyT &key, const size_t bit) {
+    const size_t byte = bit / 8;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 5; i++) {
+        bits = bits << 8 | (byte + i < key.size() ? key[byte + i] : 0);
+    }
+    return static_cast<uint32_t>(bits >> (8 - bit % 8));
+}
+
+//! \param[in] input_size is the length in bytes of the inputs to hash (at most MAX_INPUT_SIZE)
+//! \param[in] key is the secret key
+ToeplitzHash::ToeplitzHash(const size_t input_size, const KeyT &key) : _table(input_size * 256) {
+    if (input_size > MAX_INPUT_SIZE) {
+        throw runtime_error("ToeplitzHash: input is longer than the key can hash");
+    }
+
+    // for each set bit of the input, counting from its most significant bit, the hash takes in
+    // the 32-bit window of the key that starts at that bit
+    for (size_t pos = 0; pos < input_size; pos++) {
+        for (size_t value = 0; value < 256; value++) {
+            uint32_t contribution = 0;
+            for (size_t bit = 0; bit < 8; bit++) {
+                if (value & (0x80 >> bit)) {
+                    contribution ^= key_window(key, pos * 8 + bit);
+                }
+            }
+            _table[pos * 256 + value] = contribution;
+        }
+    }
+}
+
+uint32_t ToeplitzHash::operator()(const string_view input) const {
+    if (input.size() != input_size()) {
+        throw runtime_error("ToeplitzHash: input has the wrong length");
+    }
+    return operator()(reinterpret_cast<const uint8_t *>(input.data()));
+}
+
+uint32_t ToeplitzHash::operator()(const uint8_t *input) const {
+    uint32_t hash = 0;
+    const size_t size = input_size();
+    for (size_t pos = 0; pos < size; pos++) {
+        hash ^= _table[pos * 256 + input[pos]];
+    }
+    return hash;
+}
@@ -0,0 +1,41 @@
+#ifndef SPONGE_LIBSPONGE_TOEPLITZ_HASH_HH
+#define SPONGE_LIBSPONGE_TOEPLITZ_HASH_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//! \brief The Toeplitz hash that NICs use for receive-side scaling (RSS)
+//! \details The hash is linear over XOR, so each input byte contributes a value that depends
+//! only on its position and its value. Those are precomputed for inputs of a fixed length,
+//! which makes hashing one lookup and one XOR per byte.
+class ToeplitzHash {
+  public:
+    static constexpr size_t KEY_SIZE = 40;                  //!< Length of an RSS key in bytes
+    static constexpr size_t MAX_INPUT_SIZE = KEY_SIZE - 4;  //!< Longest input a key can hash
+    using KeyT = std::array<uint8_t, KEY_SIZE>;
+
+    //! The key that the Microsoft RSS specification uses (and that many drivers default to)
+    static const KeyT DEFAULT_KEY;
+
+  private:
+    //! Contribution of each value of each input byte: `_table[pos * 256 + value]`
+    std::vector<uint32_t> _table;
+
+  public:
+    //! Construct a hash of inputs of `input_size` bytes under `key`
+    explicit ToeplitzHash(const size_t input_size, const KeyT &key = DEFAULT_KEY);
+
+    //! Hash `input`, which must be as long as the hash was constructed for
+    uint32_t operator()(const std::string_view input) const;
+
+    //! Hash the bytes of `input`, which must be as long as the hash was constructed for
+    uint32_t operator()(const uint8_t *input) const;
+
+    //! Length of the inputs this hashes
+    size_t input_size() const { return _table.size() / 256; }
+};
+
+#endif  // SPONGE_LIBSPONGE_TOEPLITZ_HASH_HH
@@ -7,25 +7,45 @@
 #include <linux/if.h>
 #include <linux/if_tun.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 static constexpr const char *CLONEDEV = "/dev/net/tun";
 
+//! Bytes that a TAP device's frames carry beyond the MTU: an Ethernet header and a VLAN tag
+static constexpr size_t ETHERNET_OVERHEAD = 18;
+
 using namespace std;
 
+//! \returns the MTU of the network interface named by `req`
+static size_t interface_mtu(ifreq &req) {
+    FileDescriptor sock{SystemCall("socket", ::socket(AF_INET, SOCK_DGRAM, 0))};
+    SystemCall("ioctl", ioctl(sock.fd_num(), SIOCGIFMTU, static_cast<void *>(&req)));
+    return req.ifr_mtu;
+}
+
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects Ethernet frames)
+//! \param[in] multi_queue is `true` to open one more queue of a device created with `multi_queue`
+//! \param[in] vnet_hdr is `true` to exchange packets with virtio-net headers, and offload checksums and TSO
 //!
 //! To create a TUN device, you should already have run
 //!
 //!     ip tuntap add mode tun user `username` name `devname`
 //!
-//! as root before calling this function.
+//! as root before calling this function (adding `multi_queue` to open it with `multi_queue`).
 
-TunTapFD::TunTapFD(const string &devname, const bool is_tun)
-    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))) {
+TunTapFD::TunTapFD(const string &devname, const bool is_tun, const bool multi_queue, const bool vnet_hdr)
+    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))), _read_size(0), _vnet_hdr(vnet_hdr) {
     struct ifreq tun_req {};
 
     tun_req.ifr_flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI;  // tun device with no packetinfo
+    if (multi_queue) {
+        tun_req.ifr_flags |= IFF_MULTI_QUEUE;
+    }
+    if (vnet_hdr) {
+        tun_req.ifr_flags |= IFF_VNET_HDR;
+    }
 
     // copy devname to ifr_name, making sure to null terminate
 
@@ -33,4 +53,31 @@ TunTapFD::TunTapFD(const string &devname, const bool is_tun)
     tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
     SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)));
+
+    // with a virtio-net header, let the kernel pass TCP segments coalesced up to 64 KB, checksummed or
+    // not; without one, undo that for a persistent device that was last opened with one
+    const unsigned long offloads = vnet_hdr ? TUN_F_CSUM | TUN_F_TSO4 : 0;
+    SystemCall("ioctl", ioctl(fd_num(), TUNSETOFFLOAD, offloads));
+
+    // read each packet into the smallest pooled block that holds one of the largest the device passes
+    const size_t max_packet =
+        vnet_hdr ? BufferPool::BLOCK_SIZES[1] : interface_mtu(tun_req) + (is_tun ? 0 : ETHERNET_OVERHEAD);
+    _read_size = max_packet <= BufferPool::BLOCK_SIZES[0] ? BufferPool::BLOCK_SIZES[0] : BufferPool::BLOCK_SIZES[1];
+}
+
+//! \param[out] packets are set to the packets read
+//! \param[in] count is the most packets to read
+size_t TunTapFD::read_batch(Buffer *packets, const size_t count) {
+    size_t packets_read = 0;
+    while (packets_read < count) {
+        auto [packet, data] = Buffer::allocate(_read_size);
+        const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), data, _read_size), EAGAIN);
+        if (bytes_read < 0) {
+            break;
+        }
+        register_read();
+        packet.remove_suffix(_read_size - bytes_read);
+        packets[packets_read++] = move(packet);
+    }
+    return packets_read;
 }
@@ -1,29 +1,79 @@
 #ifndef SPONGE_LIBSPONGE_TUN_HH
 #define SPONGE_LIBSPONGE_TUN_HH
 
+#include "buffer.hh"
 #include "file_descriptor.hh"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor {
+  public:
+    //! \brief The `struct virtio_net_hdr` in front of each packet of a device opened with `vnet_hdr`
+    //! \details Declared here because <linux/virtio_net.h> is not valid C++; fields are in host byte order.
+    struct VnetHeader {
+        static constexpr uint8_t F_NEEDS_CSUM = 1;  //!< Checksum from `csum_start` on, into `csum_offset` past it
+        static constexpr uint8_t F_DATA_VALID = 2;  //!< Checksum already verified
+        static constexpr uint8_t GSO_NONE = 0;      //!< Not to be segmented
+        static constexpr uint8_t GSO_TCPV4 = 1;     //!< A TCP segment over IPv4, to be cut into `gso_size` pieces
+
+        uint8_t flags = 0;             //!< F_NEEDS_CSUM and/or F_DATA_VALID
+        uint8_t gso_type = GSO_NONE;   //!< Kind of segmentation offload
+        uint16_t hdr_len = 0;          //!< Length of the headers copied into each segment
+        uint16_t gso_size = 0;         //!< Payload length of each segment but the last
+        uint16_t csum_start = 0;       //!< Offset at which checksumming starts
+        uint16_t csum_offset = 0;      //!< Offset of the checksum field past `csum_start`
+    };
+
+  private:
+    size_t _read_size;  //!< Size of the pooled Buffer that read_batch() reads each packet into
+    bool _vnet_hdr;     //!< Does every packet start with a virtio-net header?
+
   public:
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunTapFD(const std::string &devname, const bool is_tun);
+    explicit TunTapFD(const std::string &devname,
+                      const bool is_tun,
+                      const bool multi_queue = false,
+                      const bool vnet_hdr = false);
+
+    //! Does every packet read or written start with a `struct virtio_net_hdr`?
+    bool vnet_hdr() const { return _vnet_hdr; }
+
+    //! \brief Read up to `count` packets that are already waiting, each into a pooled Buffer
+    //! \details The device must be non-blocking; reading stops at the first read that would block.
+    //! \returns the number of packets read, into `packets[0]` onwards
+    size_t read_batch(Buffer *packets, const size_t count);
 };
 
+static_assert(sizeof(TunTapFD::VnetHeader) == 10, "VnetHeader must match struct virtio_net_hdr");
+
+//! \class TunTapFD
+//! A device created with `multi_queue` can be opened several times, each TunTapFD being one of
+//! its queues; the kernel spreads the flows it sends out over the queues, so that, e.g., each
+//! shard of a TCPShardedEngine can read from a queue of its own.
+//!
+//! A device opened with `vnet_hdr` (IFF_VNET_HDR) prefixes each packet with a virtio-net header
+//! in both directions, and takes on checksum and TCP segmentation offload (TUNSETOFFLOAD): the
+//! kernel may hand over TCP segments coalesced up to 64 KB whose checksum it vouches for, and
+//! accepts such segments for it to cut apart and checksum.
+
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD {
   public:
     //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunFD(const std::string &devname) : TunTapFD(devname, true) {}
+    explicit TunFD(const std::string &devname, const bool multi_queue = false, const bool vnet_hdr = false)
+        : TunTapFD(devname, true, multi_queue, vnet_hdr) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TapFD : public TunTapFD {
   public:
     //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TapFD(const std::string &devname) : TunTapFD(devname, false) {}
+    //! \note There is no `vnet_hdr` option: TCPOverIPv4OverEthernetAdapter does not handle virtio-net headers.
+    explicit TapFD(const std::string &devname, const bool multi_queue = false)
+        : TunTapFD(devname, false, multi_queue) {}
 };
 
 #endif  // SPONGE_LIBSPONGE_TUN_HH
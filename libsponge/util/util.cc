@@ -1,13 +1,19 @@
 #include "util.hh"
 
+#include <arpa/inet.h>
 #include <array>
 #include <cctype>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <sys/socket.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 //! \returns the number of milliseconds since the program started
@@ -86,25 +92,167 @@ mt19937 get_random_generator() {
 //! on the Internet checksum, and consult the [IP](\ref rfc::rfc791) and [TCP](\ref rfc::rfc793) RFCs.
 InternetChecksum::InternetChecksum(const uint32_t initial_sum) : _sum(initial_sum) {}
 
-void InternetChecksum::add(std::string_view data) {
-    for (size_t i = 0; i < data.size(); i++) {
-        uint16_t val = uint8_t(data[i]);
-        if (not _parity) {
-            val <<= 8;
+// Checksum kernels. Each one sums `src` as native-order 32-bit words (zero-padding the last one) into a
+// 64-bit accumulator, and copies it to `dst` along the way if `copy` is set. Since 2^16 = 1 in ones'
+// complement arithmetic, folding that sum to 16 bits gives the sum of the 16-bit words in memory order.
+namespace {
+using KernelT = uint64_t (*)(char *dst, const char *src, const size_t len);
+
+template <bool copy>
+uint64_t sum_scalar(char *dst, const char *src, const size_t len) {
+    uint64_t sum = 0;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, src + i, 4);
+        if constexpr (copy) {
+            memcpy(dst + i, &word, 4);
+        }
+        sum += word;
+    }
+    if (i < len) {
+        uint32_t word = 0;
+        memcpy(&word, src + i, len - i);
+        if constexpr (copy) {
+            memcpy(dst + i, src + i, len - i);
+        }
+        sum += word;
+    }
+    return sum;
+}
+
+#if defined(__x86_64__)
+template <bool copy>
+uint64_t sum_sse2(char *dst, const char *src, const size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;  // two 64-bit lanes, so no carries are lost
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        if constexpr (copy) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
         }
-        _sum += val;
-        _parity = !_parity;
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
     }
+    array<uint64_t, 2> lanes{};
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data()), acc);
+    return lanes[0] + lanes[1] + sum_scalar<copy>(copy ? dst + i : dst, src + i, len - i);
 }
 
-uint16_t InternetChecksum::value() const {
-    uint32_t ret = _sum;
+template <bool copy>
+[[gnu::target("avx2")]] uint64_t sum_avx2(char *dst, const char *src, const size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;  // four 64-bit lanes
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        if constexpr (copy) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+        }
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero));
+    }
+    array<uint64_t, 4> lanes{};
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.data()), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_sse2<copy>(copy ? dst + i : dst, src + i, len - i);
+}
+#endif
 
-    while (ret > 0xffff) {
-        ret = (ret >> 16) + (ret & 0xffff);
+struct Kernels {
+    InternetChecksum::Kernel kernel;
+    KernelT sum;
+    KernelT copy_and_sum;
+};
+
+Kernels kernels_for(const InternetChecksum::Kernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__)
+        case InternetChecksum::Kernel::AVX2:
+            return {kernel, sum_avx2<false>, sum_avx2<true>};
+        case InternetChecksum::Kernel::SSE2:
+            return {kernel, sum_sse2<false>, sum_sse2<true>};
+#endif
+        default:
+            return {InternetChecksum::Kernel::Scalar, sum_scalar<false>, sum_scalar<true>};
     }
+}
 
-    return ~ret;
+bool kernel_supported(const InternetChecksum::Kernel kernel) {
+    switch (kernel) {
+        case InternetChecksum::Kernel::Scalar:
+            return true;
+#if defined(__x86_64__)
+        case InternetChecksum::Kernel::SSE2:
+            return true;  // part of the x86-64 baseline
+        case InternetChecksum::Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+Kernels &active_kernels() {
+    static Kernels active = kernels_for(kernel_supported(InternetChecksum::Kernel::AVX2)
+                                            ? InternetChecksum::Kernel::AVX2
+                                            : kernel_supported(InternetChecksum::Kernel::SSE2)
+                                                  ? InternetChecksum::Kernel::SSE2
+                                                  : InternetChecksum::Kernel::Scalar);
+    return active;
+}
+
+uint16_t fold(uint64_t sum) {
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+}  // namespace
+
+//! \param[in] native_sum is the kernel's sum over the bytes just added
+//! \param[in] len is the number of bytes just added
+void InternetChecksum::_add_native_sum(const uint64_t native_sum, const size_t len) {
+    uint16_t block_sum = ntohs(fold(native_sum));
+    if (_parity) {
+        // the block started at an odd offset, so each of its bytes is in the other half of a 16-bit word
+        block_sum = (block_sum >> 8) | (block_sum << 8);
+    }
+    _sum = fold(uint64_t(_sum) + block_sum);
+    _parity ^= (len & 1);
+}
+
+void InternetChecksum::add(std::string_view data) {
+    _add_native_sum(active_kernels().sum(nullptr, data.data(), data.size()), data.size());
+}
+
+//! \param[out] dst is where `data` is copied to
+//! \param[in] data is the bytes to copy and add to the checksum
+void InternetChecksum::copy_and_add(char *dst, std::string_view data) {
+    _add_native_sum(active_kernels().copy_and_sum(dst, data.data(), data.size()), data.size());
+}
+
+uint16_t InternetChecksum::value() const { return ~fold(_sum); }
+
+//! \param[in] cksum is the checksum before the change
+//! \param[in] old_word is the previous value of the 16-bit word
+//! \param[in] new_word is its new value
+//! \details Uses eqn. 3 of RFC 1624, HC' = ~(~HC + ~m + m'), which unlike eqn. 2 never produces
+//! a checksum of 0xffff (negative zero) that a recomputation would not. As the RFC notes, the result
+//! differs from a recomputation only if the data is all zeros, which no IP or TCP header is.
+uint16_t InternetChecksum::patch(const uint16_t cksum, const uint16_t old_word, const uint16_t new_word) {
+    return ~fold(uint64_t(uint16_t(~cksum)) + uint16_t(~old_word) + new_word);
+}
+
+InternetChecksum::Kernel InternetChecksum::kernel() { return active_kernels().kernel; }
+
+//! \param[in] kernel is the kernel to use for every later add() and copy_and_add()
+bool InternetChecksum::use_kernel(const Kernel kernel) {
+    if (not kernel_supported(kernel)) {
+        return false;
+    }
+    active_kernels() = kernels_for(kernel);
+    return true;
 }
 
 //! \param[in] data is a pointer to the bytes to show
@@ -9,6 +9,7 @@
 #include <ostream>
 #include <random>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <vector>
 
@@ -53,14 +54,36 @@ uint64_t timestamp_ms();
 
 //! The internet checksum algorithm
 class InternetChecksum {
+  public:
+    //! Summation kernels, one of which is selected at runtime according to CPU support
+    enum class Kernel { Scalar, SSE2, AVX2 };
+
   private:
     uint32_t _sum;
     bool _parity{};
 
+    //! Fold in the native-byte-order sum of `len` bytes, as computed by a kernel
+    void _add_native_sum(const uint64_t native_sum, const size_t len);
+
   public:
     InternetChecksum(const uint32_t initial_sum = 0);
     void add(std::string_view data);
+
+    //! Copy `data` to `dst` (which must have room for `data.size()` bytes) and add it, in one pass
+    void copy_and_add(char *dst, std::string_view data);
+
     uint16_t value() const;
+
+    //! \brief Update a checksum after one 16-bit word that it covers changes from `old_word` to `new_word`
+    //! \returns the new checksum, computed without reading the rest of the data again
+    static uint16_t patch(const uint16_t cksum, const uint16_t old_word, const uint16_t new_word);
+
+    //! \returns the kernel currently used by add() and copy_and_add()
+    static Kernel kernel();
+
+    //! \brief Use `kernel` from now on, if this CPU supports it (not thread-safe; meant for tests and benchmarks)
+    //! \returns `true` if the kernel was selected
+    static bool use_kernel(const Kernel kernel);
 };
 
 //! Hexdump the contents of a packet (or any other sequence of bytes)
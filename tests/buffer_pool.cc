@@ -0,0 +1,79 @@
+#include "buffer.hh"
+#include "test_should_be.hh"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        BufferPool &small = BufferPool::local(0);
+        BufferPool &large = BufferPool::local(1);
+        test_should_be(small.block_size(), size_t(2048));
+        test_should_be(large.block_size(), size_t(65536));
+
+        const char *first_data;
+        {
+            // the first allocation misses; the block goes back to the free list with its last copy
+            auto [buf, data] = Buffer::allocate(5);
+            memcpy(data, "hello", 5);
+            first_data = data;
+            test_should_be(buf.str() == "hello", true);
+            test_should_be(small.stats().misses, uint64_t(1));
+            test_should_be(small.stats().hits, uint64_t(0));
+
+            Buffer copy = buf;
+            buf.remove_prefix(5);
+            test_should_be(small.stats().free_blocks, size_t(0));
+            test_should_be(copy.str() == "hello", true);
+        }
+        test_should_be(small.stats().free_blocks, size_t(1));
+
+        {
+            // the next allocation of the same class reuses the block
+            auto [buf, data] = Buffer::allocate(2048);
+            test_should_be(data == first_data, true);
+            test_should_be(buf.size(), size_t(2048));
+            test_should_be(small.stats().hits, uint64_t(1));
+            test_should_be(small.stats().misses, uint64_t(1));
+            test_should_be(small.stats().free_blocks, size_t(0));
+        }
+
+        {
+            // sizes pick the smallest class that fits, and larger sizes come from the heap
+            auto [medium, medium_data] = Buffer::allocate(2049);
+            test_should_be(large.stats().misses, uint64_t(1));
+            test_should_be(medium.size(), size_t(2049));
+
+            auto [huge, huge_data] = Buffer::allocate(65537);
+            test_should_be(huge.size(), size_t(65537));
+            test_should_be(large.stats().misses, uint64_t(1));
+            test_should_be(small.stats().misses, uint64_t(1));
+        }
+        test_should_be(large.stats().free_blocks, size_t(1));
+
+        {
+            // slices share the block, moves transfer the reference
+            auto [buf, data] = Buffer::allocate(11);
+            memcpy(data, "hello world", 11);
+            Buffer slice = buf;
+            slice.remove_suffix(6);
+            Buffer moved = move(buf);
+            test_should_be(buf.size(), size_t(0));
+            test_should_be(slice.str() == "hello", true);
+            test_should_be(moved.str() == "hello world", true);
+            moved = slice;
+            test_should_be(moved.str() == "hello", true);
+            test_should_be(small.stats().free_blocks, size_t(0));
+        }
+        test_should_be(small.stats().free_blocks, size_t(1));
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
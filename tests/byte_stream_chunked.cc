@@ -0,0 +1,84 @@
+#include "byte_stream.hh"
+#include "test_should_be.hh"
+
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+static void check_string(const string &actual, const string &expected, const string &what) {
+    if (actual != expected) {
+        throw runtime_error(what + " was \"" + actual + "\", expected \"" + expected + "\"");
+    }
+}
+
+int main() {
+    try {
+        {
+            // reads that fit in one chunk share the written Buffer's storage
+            ByteStream stream{64, ByteStream::Storage::Chunked};
+            Buffer written{string("hello, world")};
+            test_should_be(stream.write(Buffer(written)), size_t(12));
+            test_should_be(stream.buffer_size(), size_t(12));
+
+            const Buffer first = stream.read_buffer(5);
+            check_string(string(first.str()), "hello", "first read_buffer()");
+            test_should_be(first.str().data() == written.str().data(), true);
+
+            const Buffer second = stream.read_buffer(100);
+            check_string(string(second.str()), ", world", "second read_buffer()");
+            test_should_be(second.str().data() == written.str().data() + 5, true);
+            test_should_be(stream.buffer_empty(), true);
+            test_should_be(stream.bytes_read(), size_t(12));
+        }
+
+        {
+            // writes beyond the capacity are trimmed, and reads spanning chunks are combined
+            ByteStream stream{8, ByteStream::Storage::Chunked};
+            test_should_be(stream.write(string("abc")), size_t(3));
+            test_should_be(stream.write(Buffer(string("defghijk"))), size_t(5));
+            test_should_be(stream.remaining_capacity(), size_t(0));
+            check_string(stream.peek_output(8), "abcdefgh", "peek_output()");
+
+            stream.pop_output(1);
+            const auto spans = stream.readable_spans();
+            check_string(string(spans[0]), "bc", "readable_spans()[0]");
+            check_string(string(spans[1]), "defgh", "readable_spans()[1]");
+
+            check_string(string(stream.read_buffer(4).str()), "bcde", "read_buffer() across chunks");
+            check_string(stream.read(10), "fgh", "read()");
+            test_should_be(stream.bytes_written(), size_t(8));
+        }
+
+        {
+            // a write that adds nothing (empty, or to a full stream) takes no block from the pool
+            ByteStream stream{4, ByteStream::Storage::Chunked};
+            test_should_be(stream.write(string_view("abcd")), size_t(4));
+            const auto before = BufferPool::local(0).stats();
+            test_should_be(stream.write(string_view("efgh")), size_t(0));
+            test_should_be(stream.write(string_view()), size_t(0));
+            const auto after = BufferPool::local(0).stats();
+            test_should_be(after.hits + after.misses, before.hits + before.misses);
+        }
+
+        {
+            // in-place writes need the ring buffer
+            ByteStream stream{8, ByteStream::Storage::Chunked};
+            bool threw = false;
+            try {
+                stream.writable_span();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include "byte_stream.hh"
+#include "test_should_be.hh"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static void check_contents(const ByteStream &stream, const string &expected) {
+    const auto spans = stream.readable_spans();
+    const string actual = string(spans[0]) + string(spans[1]);
+    if (actual != expected) {
+        throw runtime_error("readable_spans() held \"" + actual + "\", expected \"" + expected + "\"");
+    }
+    if (stream.peek_output(expected.size()) != expected) {
+        throw runtime_error("peek_output() disagrees with readable_spans()");
+    }
+}
+
+int main() {
+    try {
+        {
+            // capacity is not a power of two: writable_span must stop at the capacity limit
+            ByteStream stream{6};
+            auto [buf, len] = stream.writable_span();
+            test_should_be(len, size_t(6));
+            memcpy(buf, "abcdef", 6);
+            stream.commit(6);
+            test_should_be(stream.remaining_capacity(), size_t(0));
+            test_should_be(stream.writable_span().second, size_t(0));
+            check_contents(stream, "abcdef");
+        }
+
+        {
+            // data that wraps around the end of the ring buffer is exposed as two spans
+            ByteStream stream{8};
+            test_should_be(stream.write(string("012345")), size_t(6));
+            stream.consume(4);
+            test_should_be(stream.writable_span().second, size_t(2));
+            test_should_be(stream.write(string("6789ab")), size_t(6));
+            test_should_be(stream.buffer_size(), size_t(8));
+            const auto spans = stream.readable_spans();
+            test_should_be(spans[0].size(), size_t(4));
+            test_should_be(spans[1].size(), size_t(4));
+            check_contents(stream, "456789ab");
+
+            stream.consume(5);
+            check_contents(stream, "9ab");
+            test_should_be(stream.readable_spans()[1].size(), size_t(0));
+            test_should_be(stream.bytes_read(), size_t(9));
+            test_should_be(stream.bytes_written(), size_t(12));
+        }
+
+        {
+            // committing more than the free space is an error
+            ByteStream stream{4};
+            bool threw = false;
+            try {
+                stream.commit(5);
+            } catch (const out_of_range &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
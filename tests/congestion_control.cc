@@ -0,0 +1,113 @@
+#include "congestion_controller.hh"
+#include "link_simulator.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+static constexpr double LINK_RATE = 1000;      // bytes per ms (8 Mbit/s)
+static constexpr size_t QUEUE_LIMIT = 20000;   // half the bandwidth-delay product
+static constexpr uint64_t ONE_WAY_DELAY = 20;  // ms
+static constexpr size_t TRANSFER_SIZE = 2000000;
+static constexpr uint64_t TIME_LIMIT = 60000;  // ms
+
+//! Transfer TRANSFER_SIZE bytes with `algorithm` over a path that drops a share `loss` of the data segments
+static SimulatedTransfer transfer(const CongestionControl algorithm, const double loss, bool &done) {
+    SimulatedTransfer sim{{},
+                          TRANSFER_SIZE,
+                          SimulatedLink{LINK_RATE, QUEUE_LIMIT, ONE_WAY_DELAY, loss},
+                          SimulatedLink{LINK_RATE, QUEUE_LIMIT, ONE_WAY_DELAY}};
+    sim.config.congestion_control = algorithm;
+    sim.config.rt_timeout = 200;
+    // the largest window a TCP header can advertise (there is no window scaling): a little more than the
+    // 40 KB bandwidth-delay product and 20 KB queue hold together, so an uncontrolled sender overflows
+    sim.config.recv_capacity = 65535;
+    sim.config.send_capacity = 256000;
+    done = sim.run(TIME_LIMIT);
+    return sim;
+}
+
+//! An acknowledgment of `bytes_acked` at time `now`, `rtt` ms after the acknowledged segment was sent
+static AckSample ack(const uint64_t now, const size_t bytes_acked, const uint64_t delivered, const size_t rtt) {
+    return {now, bytes_acked, 0, rtt, delivered, delivered - bytes_acked, rtt, false, false};
+}
+
+int main() {
+    try {
+        {
+            // NewReno grows by up to two segments per acknowledgment in slow start, and halves on loss
+            auto reno = CongestionController::make(CongestionControl::NewReno, MSS);
+            test_should_be(reno->window(), 4380ul);
+            reno->on_ack(ack(10, MSS, MSS, 10));
+            test_should_be(reno->window(), 4380ul + MSS);
+            reno->on_loss(20, 20000);
+            test_should_be(reno->window(), 10000ul);
+            reno->on_ack(ack(30, MSS, 2 * MSS, 10));
+            test_should_be(reno->window(), 10000ul);
+            reno->on_rto(40, 10000);
+            test_should_be(reno->window(), MSS);
+            test_should_be(reno->pacing_rate().has_value(), false);
+
+            // CUBIC keeps 70% of the window on loss
+            auto cubic = CongestionController::make(CongestionControl::Cubic, MSS);
+            cubic->on_loss(0, 10 * MSS);
+            test_should_be(cubic->window(), 7 * MSS);
+
+            // acknowledgments that each grow the window by less than a byte still add up
+            for (size_t acked = 10; acked <= 7 * MSS; acked += 10) {
+                cubic->on_ack(ack(10, 10, acked, 10));
+            }
+            test_should_be(cubic->window() > 7 * MSS, true);
+
+            // BBR paces from its first RTT sample on
+            auto bbr = CongestionController::make(CongestionControl::BBR, MSS);
+            test_should_be(bbr->pacing_rate().has_value(), false);
+            bbr->on_ack(ack(40, 1, 1, 40));
+            test_should_be(bbr->pacing_rate().has_value(), true);
+
+            // with a tiny bandwidth-delay product, Startup grows the window only until ten segments are delivered
+            auto slow_bbr = CongestionController::make(CongestionControl::BBR, MSS);
+            for (size_t delivered = MSS; delivered <= 30 * MSS; delivered += MSS) {
+                slow_bbr->on_ack({delivered / MSS, MSS, 0, 40, delivered, 0, 4000, false, false});
+            }
+            test_should_be(slow_bbr->window(), 19 * MSS);
+
+            test_should_be(CongestionController::make(CongestionControl::None, MSS) == nullptr, true);
+        }
+
+        for (const double loss : {0.0, 0.005}) {
+            // without congestion control, the window overflows the bottleneck queue again and again
+            bool done = false;
+            const size_t uncontrolled_overflows = transfer(CongestionControl::None, loss, done).forward.overflows;
+            test_should_be(uncontrolled_overflows > 100, true);
+
+            for (const auto algorithm :
+                 {CongestionControl::NewReno, CongestionControl::Cubic, CongestionControl::BBR}) {
+                const auto sim = transfer(algorithm, loss, done);
+                test_should_be(done, true);
+                test_should_be(sim.forward.overflows * 10 < uncontrolled_overflows, true);
+                if (loss == 0) {
+                    test_should_be(sim.goodput() > LINK_RATE / 2, true);
+                }
+            }
+
+            // BBR does not take random loss for congestion, so it keeps more of the link than NewReno
+            if (loss > 0) {
+                const double bbr_goodput = transfer(CongestionControl::BBR, loss, done).goodput();
+                test_should_be(bbr_goodput > transfer(CongestionControl::NewReno, loss, done).goodput(), true);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
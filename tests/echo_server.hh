@@ -0,0 +1,61 @@
+#ifndef SPONGE_TESTS_ECHO_SERVER_HH
+#define SPONGE_TESTS_ECHO_SERVER_HH
+
+#include "tcp_engine.hh"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! \brief Echoes what each connection accepted from a TCPOverUDPEngine receives, and ends the
+//! connection's outbound stream once its inbound stream has ended and everything has been echoed
+class EchoServer {
+    std::vector<TCPOverUDPEngine::Stream> _streams{};  //!< Every connection accepted so far
+    std::vector<std::string> _unechoed{};              //!< Bytes read from each connection but not yet written back
+    std::vector<bool> _finished{};                     //!< Whether each connection's outbound stream has ended
+
+  public:
+    //! Accept the connections that `engine` has ready; \returns the ones just accepted
+    std::vector<TCPOverUDPEngine::Stream> accept_from(TCPOverUDPEngine &engine) {
+        std::vector<TCPOverUDPEngine::Stream> accepted;
+        while (auto stream = engine.accept()) {
+            accepted.push_back(stream.value());
+            _streams.push_back(stream.value());
+            _unechoed.emplace_back();
+            _finished.push_back(false);
+        }
+        return accepted;
+    }
+
+    //! Echo what each connection has received, as much as its outbound stream takes
+    void service() {
+        for (size_t i = 0; i < _streams.size(); i++) {
+            auto &stream = _streams[i];
+            if (not stream.valid()) {
+                continue;
+            }
+            _unechoed[i] += stream.read(stream.inbound_stream().buffer_size());
+            _unechoed[i].erase(0, stream.write(_unechoed[i]));
+            if (_unechoed[i].empty() and stream.inbound_stream().eof() and not _finished[i]) {
+                stream.end_input_stream();
+                _finished[i] = true;
+            }
+        }
+    }
+
+    //! Number of connections accepted so far
+    size_t accepted() const { return _streams.size(); }
+};
+
+//! `true` once none of `engines` holds a connection
+inline bool all_closed(const std::vector<std::unique_ptr<TCPOverUDPEngine>> &engines) {
+    for (const auto &engine : engines) {
+        if (engine->connection_count()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif  // SPONGE_TESTS_ECHO_SERVER_HH
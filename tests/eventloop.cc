@@ -0,0 +1,156 @@
+#include "eventloop.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+//! \returns the read and write ends of a new pipe
+static pair<FileDescriptor, FileDescriptor> make_pipe() {
+    int fds[2];
+    SystemCall("pipe", ::pipe(static_cast<int *>(fds)));
+    return {FileDescriptor(fds[0]), FileDescriptor(fds[1])};
+}
+
+static void check_backend(const EventLoop::Backend backend) {
+    {
+        // a readable fd runs its callback; an uninterested one is left alone
+        EventLoop loop{backend};
+        auto [read_end, write_end] = make_pipe();
+        auto [idle_read_end, idle_write_end] = make_pipe();
+        string received;
+        bool idle_called = false;
+        loop.add_rule(read_end, Direction::In, [&] { received += read_end.read(); });
+        loop.add_rule(
+            idle_read_end, Direction::In, [&] { idle_called = true; }, [] { return false; });
+        idle_write_end.write("ignored");
+
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+        write_end.write("hello");
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Success, true);
+        test_should_be(received == "hello", true);
+        test_should_be(idle_called, false);
+
+        // a hangup with nothing left to read cancels the rule
+        bool canceled = false;
+        loop.add_rule(
+            write_end, Direction::Out, [&] { write_end.write("!"); }, [] { return false; }, [&] { canceled = true; });
+        write_end.close();
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Success, true);
+        test_should_be(loop.wait_next_event(0) == EventLoop::Result::Exit, true);
+        test_should_be(canceled, true);
+    }
+
+    {
+        // both directions of one fd can be watched at once
+        EventLoop loop{backend};
+        auto [read_end, write_end] = make_pipe();
+        size_t writes = 0;
+        string received;
+        loop.add_rule(
+            write_end,
+            Direction::Out,
+            [&] {
+                write_end.write("x");
+                ++writes;
+            },
+            [&] { return writes < 3; });
+        loop.add_rule(read_end, Direction::In, [&] { received += read_end.read(); });
+        while (loop.wait_next_event(0) == EventLoop::Result::Success) {
+        }
+        test_should_be(received == "xxx", true);
+    }
+}
+
+int main() {
+    try {
+        check_backend(EventLoop::Backend::Poll);
+        check_backend(EventLoop::Backend::Epoll);
+
+        {
+            // with epoll, a group's interest is only re-evaluated after its own callbacks or when notified
+            EventLoop loop{EventLoop::Backend::Epoll};
+            auto [read_end, write_end] = make_pipe();
+            bool wanted = false;
+            size_t interest_calls = 0;
+            string received;
+            constexpr EventLoop::GroupT group = 1;
+            loop.add_rule(
+                read_end,
+                Direction::In,
+                [&] { received += read_end.read(); },
+                [&] {
+                    ++interest_calls;
+                    return wanted;
+                },
+                [] {},
+                group);
+            write_end.write("data");
+
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Exit, true);
+            test_should_be(interest_calls, size_t(1));
+
+            wanted = true;
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Exit, true);
+            test_should_be(interest_calls, size_t(1));
+
+            loop.interest_changed(group);
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Success, true);
+            test_should_be(received == "data", true);
+
+            // the callback ran, so the group is re-evaluated once (plus the busy-wait check)
+            const size_t calls_after_callback = interest_calls;
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+            test_should_be(interest_calls, calls_after_callback + 1);
+            test_should_be(loop.wait_next_event(0) == EventLoop::Result::Timeout, true);
+            test_should_be(interest_calls, calls_after_callback + 1);
+        }
+
+        {
+            // timers shorten the wait, fire once in deadline order, and can be canceled
+            EventLoop loop{EventLoop::Backend::Epoll};
+            string fired;
+            const uint64_t now = timestamp_ms();
+            loop.add_timer(now + 20, [&] { fired += "b"; });
+            loop.add_timer(now, [&] { fired += "a"; });
+            const auto canceled = loop.add_timer(now + 10, [&] { fired += "x"; });
+            loop.cancel_timer(canceled);
+
+            test_should_be(loop.wait_next_event(-1) == EventLoop::Result::Success, true);
+            test_should_be(fired == "a", true);
+            test_should_be(loop.wait_next_event(-1) == EventLoop::Result::Success, true);
+            test_should_be(fired == "ab", true);
+            test_should_be(timestamp_ms() >= now + 20, true);
+
+            // with no interested rules and no timers left, the loop has nothing to wait for
+            test_should_be(loop.wait_next_event(-1) == EventLoop::Result::Exit, true);
+        }
+
+        for (const auto backend : {EventLoop::Backend::Poll, EventLoop::Backend::Epoll}) {
+            // a timer whose deadline is past the end of the wheel's current 64 ms slot cascades to a
+            // lower level on the way; the wait goes on until the timer itself fires
+            EventLoop loop{backend};
+            for (size_t i = 0; i < 4; i++) {
+                while (timestamp_ms() % TimerWheel::SLOTS != TimerWheel::SLOTS - 4) {
+                }
+                const uint64_t deadline = timestamp_ms() + 20;
+                bool fired = false;
+                loop.add_timer(deadline, [&] { fired = true; });
+                test_should_be(loop.wait_next_event(-1) == EventLoop::Result::Success, true);
+                test_should_be(fired, true);
+                test_should_be(timestamp_ms() >= deadline, true);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
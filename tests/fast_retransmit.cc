@@ -0,0 +1,81 @@
+#include "sender_helpers.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+int main() {
+    try {
+        {
+            // five segments in flight, of which the second and third are lost
+            TCPSender sender{64000, 1000, WrappingInt32{0}, ByteStream::Storage::Ring, CongestionControl::NewReno};
+            sent(sender);
+            ack(sender, 1);  // the SYN
+            const auto window = sender.congestion_controller()->window();
+            sender.stream_in().write(string(window, 'x'));
+            test_should_be(sent(sender).size(), window / MSS + (window % MSS != 0));
+            ack(sender, 1 + MSS);
+
+            // two duplicates are not enough to tell a loss from reordering; the third is
+            ack(sender, 1 + MSS);
+            ack(sender, 1 + MSS);
+            test_should_be(sent(sender).empty(), true);
+            ack(sender, 1 + MSS);
+            test_should_be(sent(sender) == vector<uint64_t>{1 + MSS}, true);
+            test_should_be(sender.fast_retransmissions(), uint64_t{1});
+            test_should_be(sender.congestion_controller()->window() < window, true);
+
+            // the retransmission is acknowledged, but not everything that was in flight: the next hole is
+            // retransmitted at once, without waiting for three more duplicates
+            ack(sender, 1 + 2 * MSS);
+            test_should_be(sent(sender) == vector<uint64_t>{1 + 2 * MSS}, true);
+            test_should_be(sender.fast_retransmissions(), uint64_t{1});
+
+            // acknowledging the rest ends recovery, and retransmits nothing
+            ack(sender, sender.next_seqno_absolute());
+            test_should_be(sent(sender).empty(), true);
+            test_should_be(sender.bytes_in_flight(), 0ul);
+        }
+
+        {
+            // acknowledgments that change the window, close it, or come with data are not duplicates
+            TCPSender sender{64000, 1000, WrappingInt32{0}};
+            sent(sender);
+            ack(sender, 1);
+            sender.stream_in().write(string(4 * MSS, 'x'));
+            sent(sender);
+            ack(sender, 1 + MSS);
+            ack(sender, 1 + MSS, {}, 50000);
+            ack(sender, 1 + MSS, {}, 40000);
+            ack(sender, 1 + MSS, {}, 40000, true);
+            ack(sender, 1 + MSS, {}, 40000, true);
+            ack(sender, 1 + MSS, {}, 0);
+            test_should_be(sent(sender).empty(), true);
+            test_should_be(sender.fast_retransmissions(), uint64_t{0});
+
+            // a timeout resets the count, and duplicates of what was outstanding then start no fast recovery
+            ack(sender, 1 + MSS, {}, 40000);
+            ack(sender, 1 + MSS, {}, 40000);
+            sender.tick(1000);
+            test_should_be(sent(sender) == vector<uint64_t>{1 + MSS}, true);
+            for (size_t i = 0; i < 4; i++) {
+                ack(sender, 1 + MSS, {}, 40000);
+            }
+            test_should_be(sent(sender).empty(), true);
+            test_should_be(sender.fast_retransmissions(), uint64_t{0});
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
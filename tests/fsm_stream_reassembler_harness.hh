@@ -103,6 +103,26 @@ struct UnassembledBytes : public ReassemblerExpectation {
     }
 };
 
+struct InOrderPushes : public ReassemblerExpectation {
+    size_t _pushes;
+
+    InOrderPushes(size_t pushes) : _pushes(pushes) {}
+    std::string description() const {
+        std::ostringstream ss;
+        ss << "in-order pushes = " << _pushes;
+        return ss.str();
+    }
+
+    void execute(StreamReassembler &reassembler) const {
+        if (reassembler.in_order_pushes() != _pushes) {
+            std::ostringstream ss;
+            ss << "The reassembler was expected to have taken the in-order path `" << _pushes
+               << "` times, but it took it `" << reassembler.in_order_pushes() << "` times";
+            throw ReassemblerExpectationViolation(ss.str());
+        }
+    }
+};
+
 struct AtEof : public ReassemblerExpectation {
     AtEof() {}
     std::string description() const {
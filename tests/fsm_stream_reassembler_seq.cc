@@ -66,6 +66,24 @@ int main() {
             }
         }
 
+        {
+            ReassemblerTestHarness test{65000};
+
+            test.execute(SubmitSegment{"abcd", 0});
+            test.execute(SubmitSegment{"efgh", 4});
+            test.execute(InOrderPushes(2));
+
+            test.execute(SubmitSegment{"mnop", 12});
+            test.execute(SubmitSegment{"ijkl", 8});
+            test.execute(InOrderPushes(2));
+            test.execute(BytesAvailable("abcdefghijklmnop"));
+
+            test.execute(SubmitSegment{"qrst", 16}.with_eof(true));
+            test.execute(InOrderPushes(3));
+            test.execute(BytesAvailable("qrst"));
+            test.execute(AtEof{});
+        }
+
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
         return EXIT_FAILURE;
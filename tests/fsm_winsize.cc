@@ -11,6 +11,7 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -88,6 +89,19 @@ int main() {
             test_1.execute(ExpectBytesInFlight{0}, "test 1 failed: after acking, bytes still in flight?");
             test_err_if(!equal(d.cbegin(), d.cend(), d_out.cbegin()), "test 1 failed: data mismatch");
         }
+
+        // test 2: a receive capacity beyond what the 16-bit window field holds is advertised as its maximum
+        {
+            cfg.recv_capacity = 256000;
+            const WrappingInt32 seq_base(rd());
+            TCPTestHarness test_2(cfg);
+
+            test_2.execute(Listen{});
+            test_2.send_syn(seq_base);
+            test_2.execute(
+                ExpectOneSegment{}.with_ack(true).with_ackno(seq_base + 1).with_win(numeric_limits<uint16_t>::max()),
+                "test 2 failed: SYN/ACK window not clamped");
+        }
     } catch (const exception &e) {
         cerr << e.what() << endl;
         return err_num;
@@ -0,0 +1,167 @@
+#include "ipv4_datagram.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! The straightforward byte-at-a-time definition of the Internet checksum
+static uint16_t reference_checksum(const string &data, const uint32_t initial_sum) {
+    uint64_t sum = initial_sum;
+    for (size_t i = 0; i < data.size(); i++) {
+        sum += (i % 2 == 0) ? uint8_t(data[i]) << 8 : uint8_t(data[i]);
+    }
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return ~sum;
+}
+
+static void check_kernel(const InternetChecksum::Kernel kernel, mt19937 &rd) {
+    for (const size_t len : {0, 1, 2, 3, 15, 16, 17, 20, 31, 33, 63, 64, 65, 1452, 1500, 65535, 65536}) {
+        string data(len, 0);
+        for (auto &ch : data) {
+            ch = rd();
+        }
+        const uint32_t initial_sum = rd() % 0x40000;
+        const uint16_t expected = reference_checksum(data, initial_sum);
+
+        // add in one piece
+        InternetChecksum whole(initial_sum);
+        whole.add(data);
+        test_should_be(whole.value(), expected);
+
+        // add in pieces of random (often odd) length, copying as we go
+        InternetChecksum pieces(initial_sum);
+        string copy(len, 0);
+        size_t offset = 0;
+        while (offset < len) {
+            const size_t n = min(len - offset, size_t(rd() % 100));
+            pieces.copy_and_add(copy.data() + offset, string_view(data).substr(offset, n));
+            offset += n;
+        }
+        test_should_be(pieces.value(), expected);
+        if (copy != data) {
+            throw runtime_error("copy_and_add() did not copy its input (kernel " + to_string(int(kernel)) + ")");
+        }
+    }
+}
+
+//! Rewrite single 16-bit words and check that a patched checksum matches a recomputed one
+static void check_patch(mt19937 &rd) {
+    for (unsigned int trial = 0; trial < 1000; trial++) {
+        string data(2 * (2 + rd() % 32), 0);
+        for (auto &ch : data) {
+            ch = rd();
+        }
+        if (trial % 4 == 0) {  // exercise the one's-complement edge cases
+            data.assign(data.size(), trial % 8 == 0 ? char(0) : char(0xff));
+        }
+        data[0] |= 0x40;  // like the IPv4 version field; RFC 1624 excludes data that is all zeros
+        const uint16_t before = reference_checksum(data, 0);
+
+        const size_t word = 2 * (1 + rd() % (data.size() / 2 - 1));
+        const uint16_t old_word = (uint8_t(data[word]) << 8) | uint8_t(data[word + 1]);
+        const uint16_t new_word = trial % 16 == 1 ? 0 : rd();
+        data[word] = char(new_word >> 8);
+        data[word + 1] = char(new_word & 0xff);
+
+        test_should_be(InternetChecksum::patch(before, old_word, new_word), reference_checksum(data, 0));
+    }
+}
+
+//! A TCPSegment with a cached payload sum must serialize exactly like one without
+static void check_cached_payload_sum(mt19937 &rd) {
+    for (const size_t len : {0, 1, 2, 3, 1452}) {
+        string payload(len, 0);
+        for (auto &ch : payload) {
+            ch = rd();
+        }
+        const uint32_t pseudo_header_sum = rd() % 0x40000;
+
+        TCPSegment plain;
+        plain.payload() = Buffer(move(payload));
+        TCPSegment cached = plain;
+        cached.cache_payload_sum();
+
+        for (unsigned int rewrite = 0; rewrite < 3; rewrite++) {
+            plain.header().ackno = cached.header().ackno = WrappingInt32(rd());
+            plain.header().win = cached.header().win = rd();
+            test_should_be(
+                cached.serialize(pseudo_header_sum).concatenate() == plain.serialize(pseudo_header_sum).concatenate(),
+                true);
+        }
+
+        // replacing the payload invalidates the cached sum
+        plain.payload() = cached.payload() = Buffer(string("replacement"));
+        test_should_be(
+            cached.serialize(pseudo_header_sum).concatenate() == plain.serialize(pseudo_header_sum).concatenate(),
+            true);
+    }
+}
+
+//! A parsed IPv4 header keeps its checksum only for as long as it still describes the header
+static void check_ipv4_cksum_reuse(mt19937 &rd) {
+    IPv4Datagram original;
+    original.payload() = Buffer(string("payload"));
+    original.header().len = IPv4Header::LENGTH + original.payload().size();
+    original.header().src = rd();
+    original.header().dst = rd();
+    const string serialized = original.serialize().concatenate();
+
+    // parse `serialized`, let `change` rewrite the header, and return whether the result parses again
+    const auto rewritten_parses = [&](const auto &change) {
+        IPv4Datagram dgram;
+        test_should_be(dgram.parse(Buffer(string(serialized))) == ParseResult::NoError, true);
+        change(dgram.header());
+        NetParser p{Buffer(dgram.serialize().concatenate())};
+        IPv4Header reparsed;
+        return reparsed.parse(p) == ParseResult::NoError;
+    };
+
+    test_should_be(rewritten_parses([](IPv4Header &) {}), true);
+    test_should_be(rewritten_parses([](IPv4Header &header) { header.decrement_ttl(); }), true);
+    test_should_be(rewritten_parses([](IPv4Header &header) { header.ttl--; }), true);
+    test_should_be(rewritten_parses([&](IPv4Header &header) { header.src = rd(); }), true);
+    test_should_be(rewritten_parses([&](IPv4Header &header) {
+                       header.dst = rd();
+                       header.decrement_ttl();
+                   }),
+                   true);
+    test_should_be(rewritten_parses([](IPv4Header &header) {
+                       header.decrement_ttl();
+                       header.id++;
+                   }),
+                   true);
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const auto original = InternetChecksum::kernel();
+        for (const auto kernel :
+             {InternetChecksum::Kernel::Scalar, InternetChecksum::Kernel::SSE2, InternetChecksum::Kernel::AVX2}) {
+            if (InternetChecksum::use_kernel(kernel)) {
+                test_should_be(int(InternetChecksum::kernel()), int(kernel));
+                check_kernel(kernel, rd);
+            }
+        }
+        InternetChecksum::use_kernel(original);
+
+        check_patch(rd);
+        check_cached_payload_sum(rd);
+        check_ipv4_cksum_reuse(rd);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#ifndef SPONGE_TESTS_LINK_SIMULATOR_HH
+#define SPONGE_TESTS_LINK_SIMULATOR_HH
+
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+//! \brief One direction of a simulated path: a drop-tail queue drained at a fixed rate, then a fixed delay
+class SimulatedLink {
+    static constexpr size_t HEADER_SIZE = 40;  //!< Bytes of IPv4 and TCP header that each segment costs
+
+    double _rate;         //!< Bytes per ms the bottleneck drains
+    size_t _queue_limit;  //!< Bytes the bottleneck queue holds
+    uint64_t _delay;      //!< Propagation delay, in ms
+    double _loss;         //!< Probability that a segment is lost on the way, whatever the queue
+    std::mt19937 _rng;
+    double _busy_until = 0;  //!< Time at which the bottleneck finishes sending what it has queued
+    std::deque<std::pair<double, TCPSegment>> _in_flight{};  //!< Segments on the way, with their arrival times
+
+  public:
+    size_t overflows = 0;     //!< Segments dropped because the queue was full
+    size_t losses = 0;        //!< Segments lost at random
+    size_t max_queue = 0;     //!< Largest queue seen, in bytes
+    uint64_t bytes_sent = 0;  //!< Bytes (with headers) that crossed the bottleneck
+
+    SimulatedLink(const double rate, const size_t queue_limit, const uint64_t delay, const double loss = 0)
+        : _rate(rate), _queue_limit(queue_limit), _delay(delay), _loss(loss), _rng(1) {}
+
+    //! Put a segment on the link at time `now`
+    void send(const uint64_t now, const TCPSegment &seg) {
+        const size_t size = seg.payload().size() + HEADER_SIZE;
+        const double start = std::max<double>(now, _busy_until);
+        const size_t queued = static_cast<size_t>((start - now) * _rate);
+        if (queued + size > _queue_limit) {
+            overflows++;
+            return;
+        }
+        max_queue = std::max(max_queue, queued + size);
+        _busy_until = start + size / _rate;
+        bytes_sent += size;
+        if (std::bernoulli_distribution(_loss)(_rng)) {
+            losses++;
+            return;
+        }
+        _in_flight.emplace_back(_busy_until + _delay, seg);
+    }
+
+    //! Deliver every segment that has arrived by time `now` to `connection`
+    void deliver(const uint64_t now, TCPConnection &connection) {
+        while (not _in_flight.empty() and _in_flight.front().first <= now) {
+            connection.segment_received(_in_flight.front().second);
+            _in_flight.pop_front();
+        }
+    }
+};
+
+//! \brief A transfer of `size` bytes from one TCPConnection to another over a pair of SimulatedLinks
+struct SimulatedTransfer {
+    TCPConfig config{};
+    size_t size;
+    SimulatedLink forward;  //!< Carries data from the sender
+    SimulatedLink reverse;  //!< Carries acknowledgments back
+    uint64_t elapsed = 0;   //!< Time the transfer took, in ms
+
+    //! \brief Run the transfer, one millisecond at a time, for at most `time_limit` ms
+    //! \returns whether the receiver got all the data, in order and intact
+    bool run(const uint64_t time_limit) {
+        config.fixed_isn = WrappingInt32{0};
+        TCPConnection sender{config}, receiver{config};
+        std::string data(size, 0);
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<char>(i % 251);
+        }
+
+        sender.connect();
+        size_t written = 0, read = 0;
+        for (elapsed = 0; elapsed < time_limit and read < size; elapsed++) {
+            forward.deliver(elapsed, receiver);
+            reverse.deliver(elapsed, sender);
+
+            if (written < size) {
+                written += sender.write(data.substr(written, sender.remaining_outbound_capacity()));
+            }
+
+            ByteStream &inbound = receiver.inbound_stream();
+            const std::string piece = inbound.read(inbound.buffer_size());
+            if (data.compare(read, piece.size(), piece) != 0) {
+                return false;
+            }
+            read += piece.size();
+
+            sender.tick(1);
+            receiver.tick(1);
+            for (auto &[from, link] : {std::make_pair(&sender, &forward), std::make_pair(&receiver, &reverse)}) {
+                while (not from->segments_out().empty()) {
+                    link->send(elapsed, from->segments_out().front());
+                    from->segments_out().pop();
+                }
+            }
+        }
+        return read == size;
+    }
+
+    //! Goodput of the transfer, in bytes per ms
+    double goodput() const { return double(size) / std::max<uint64_t>(elapsed, 1); }
+};
+
+#endif  // SPONGE_TESTS_LINK_SIMULATOR_HH
@@ -0,0 +1,25 @@
+#ifndef SPONGE_TESTS_LOOPBACK_HELPERS_HH
+#define SPONGE_TESTS_LOOPBACK_HELPERS_HH
+
+#include "address.hh"
+#include "fd_adapter.hh"
+#include "socket.hh"
+
+#include <cstdint>
+#include <utility>
+
+//! \returns a UDP socket bound to an ephemeral port on the loopback interface
+inline UDPSocket loopback_socket() {
+    UDPSocket sock;
+    sock.bind(Address("127.0.0.1", 0));
+    return sock;
+}
+
+//! \returns an adapter for a UDP socket bound to an ephemeral port on the loopback interface, and the port
+inline std::pair<TCPOverUDPSocketAdapter, uint16_t> loopback_adapter() {
+    UDPSocket sock = loopback_socket();
+    const uint16_t port = sock.local_address().port();
+    return {TCPOverUDPSocketAdapter(std::move(sock)), port};
+}
+
+#endif  // SPONGE_TESTS_LOOPBACK_HELPERS_HH
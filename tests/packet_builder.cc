@@ -0,0 +1,124 @@
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "packet_builder.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static size_t allocations = 0;  //!< Number of calls to the global operator new
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+static string concatenate(const array<string_view, 2> &views) { return string(views[0]) + string(views[1]); }
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        for (const size_t len : {0, 1, 2, 3, 1452}) {
+            TCPSegment seg;
+            string payload(len, 0);
+            for (auto &ch : payload) {
+                ch = rd();
+            }
+            seg.payload() = Buffer(move(payload));
+            seg.header().sport = rd();
+            seg.header().dport = rd();
+            seg.header().seqno = WrappingInt32(rd());
+            seg.header().syn = len == 0;
+            if (len % 2) {
+                seg.cache_payload_sum();
+            }
+
+            IPv4Header ip_header;
+            ip_header.src = rd();
+            ip_header.dst = rd();
+            ip_header.id = rd();
+            ip_header.len = ip_header.hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+            ip_header.cksum = 0xdead;  // ignored
+
+            EthernetHeader eth_header{{2, 0, 0, 0, 0, 1}, {2, 0, 0, 0, 0, 2}, EthernetHeader::TYPE_IPv4};
+
+            PacketBuilder builder;
+            for (unsigned int rewrite = 0; rewrite < 3; rewrite++) {
+                seg.header().ack = true;
+                seg.header().ackno = WrappingInt32(rd());
+                seg.header().win = rd();
+
+                // the last rewrite adds SACK blocks, which lengthen the TCP header
+                if (rewrite == 2) {
+                    seg.header().sack_count = 2;
+                    seg.header().sack[0] = {WrappingInt32(rd()), WrappingInt32(rd())};
+                    seg.header().sack[1] = {WrappingInt32(rd()), WrappingInt32(rd())};
+                    seg.header().doff = (TCPHeader::LENGTH + seg.header().options_length()) / 4;
+                    ip_header.len = ip_header.hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+                }
+
+                // reference: serialize layer by layer
+                InternetDatagram dgram;
+                dgram.header() = ip_header;
+                dgram.payload() = seg.serialize(ip_header.pseudo_cksum());
+                EthernetFrame frame;
+                frame.header() = eth_header;
+                frame.payload() = dgram.serialize();
+                const string expected_frame = frame.serialize().concatenate();
+                const string expected_dgram = dgram.serialize().concatenate();
+
+                // building either packet allocates nothing (snapshot the count before test_should_be allocates)
+                const size_t allocations_before = allocations;
+                const auto dgram_views = builder.tcp_in_ipv4(ip_header, seg);
+                const size_t dgram_allocations = allocations - allocations_before;
+                test_should_be(dgram_allocations, size_t(0));
+                test_should_be(concatenate(dgram_views) == expected_dgram, true);
+
+                const size_t allocations_between = allocations;
+                const auto frame_views = builder.tcp_in_ipv4_in_ethernet(eth_header, ip_header, seg);
+                const size_t frame_allocations = allocations - allocations_between;
+                test_should_be(frame_allocations, size_t(0));
+                test_should_be(concatenate(frame_views) == expected_frame, true);
+                test_should_be(frame_views[1].data() == seg.payload().str().data(), true);
+
+                // the result parses back, with valid checksums
+                InternetDatagram parsed;
+                test_should_be(parsed.parse(string(expected_dgram)) == ParseResult::NoError, true);
+                TCPSegment parsed_seg;
+                test_should_be(parsed_seg.parse(parsed.payload().concatenate(), parsed.header().pseudo_cksum()) ==
+                                   ParseResult::NoError,
+                               true);
+                test_should_be(parsed_seg.header() == seg.header(), true);
+            }
+
+            // a TCP header longer than the datagram leaves room for is rejected
+            seg.header().doff++;
+            bool threw = false;
+            try {
+                PacketBuilder().tcp_in_ipv4(ip_header, seg);
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
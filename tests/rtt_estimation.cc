@@ -0,0 +1,100 @@
+#include "sender_helpers.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+//! Write `data` into the sender, let it send, and \returns the absolute seqno after what it sent
+static uint64_t send(TCPSender &sender, const string &data) {
+    sender.stream_in().write(data);
+    sender.fill_window();
+    while (not sender.segments_out().empty()) {
+        sender.segments_out().pop();
+    }
+    return sender.next_seqno_absolute();
+}
+
+int main() {
+    try {
+        const size_t initial_rto = 1000;
+        {
+            // with a fixed timeout, RTT is measured, but the timeout returns to its initial value on each ACK
+            TCPSender sender{64000, initial_rto, WrappingInt32{0}};
+            ack(sender, send(sender, ""));  // the SYN
+            test_should_be(sender.rtt_estimate().has_value(), true);
+            test_should_be(sender.rtt_estimate()->latest, 0ul);
+
+            const uint64_t end = send(sender, "hello");
+            sender.tick(300);
+            ack(sender, end);
+            test_should_be(sender.rtt_estimate()->latest, 300ul);
+            test_should_be(sender.rtt_estimate()->samples, uint64_t{2});
+            test_should_be(sender.retransmission_timeout(), initial_rto);
+        }
+
+        {
+            // an adaptive timeout follows SRTT + 4 * RTTVAR
+            TCPSender sender{64000, initial_rto, WrappingInt32{0}, ByteStream::Storage::Ring, CongestionControl::None,
+                             RTOBounds{100, 5000}};
+            test_should_be(sender.rtt_estimate().has_value(), false);
+            test_should_be(sender.retransmission_timeout(), initial_rto);
+
+            // first sample: SRTT = 100, RTTVAR = 50
+            uint64_t end = send(sender, "");
+            sender.tick(100);
+            ack(sender, end);
+            test_should_be(sender.rtt_estimate()->smoothed, 100.0);
+            test_should_be(sender.rtt_estimate()->variation, 50.0);
+            test_should_be(sender.retransmission_timeout(), 300ul);
+
+            // second sample: RTTVAR = 3/4 * 50 + 1/4 * 40 = 47.5, SRTT = 7/8 * 100 + 1/8 * 60 = 95
+            end = send(sender, "a");
+            sender.tick(60);
+            ack(sender, end);
+            test_should_be(sender.rtt_estimate()->variation, 47.5);
+            test_should_be(sender.rtt_estimate()->smoothed, 95.0);
+            test_should_be(sender.rtt_estimate()->minimum, 60ul);
+            test_should_be(sender.retransmission_timeout(), 285ul);
+
+            // the timeout backs off on expiry, and (Karn) acknowledging the retransmission neither samples
+            // the RTT nor undoes the backoff
+            end = send(sender, "b");
+            test_should_be(sender.time_until_retransmission().value(), 285ul);
+            sender.tick(285);
+            test_should_be(sender.retransmission_timeout(), 570ul);
+            sender.tick(10);
+            ack(sender, end);
+            test_should_be(sender.rtt_estimate()->samples, uint64_t{2});
+            test_should_be(sender.retransmission_timeout(), 570ul);
+
+            // a segment sent only once gives a sample again
+            end = send(sender, "c");
+            sender.tick(95);
+            ack(sender, end);
+            test_should_be(sender.rtt_estimate()->samples, uint64_t{3});
+            test_should_be(sender.retransmission_timeout() < 570, true);
+
+            // the timeout stays within its bounds
+            for (size_t i = 0; i < 20; i++) {
+                end = send(sender, "d");
+                ack(sender, end);
+            }
+            test_should_be(sender.retransmission_timeout(), 100ul);
+            end = send(sender, "e");
+            for (size_t i = 0; i < 10; i++) {
+                sender.tick(sender.time_until_retransmission().value());
+            }
+            test_should_be(sender.retransmission_timeout(), 5000ul);
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include "link_simulator.hh"
+#include "sender_helpers.hh"
+#include "tcp_connection.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+//! Serialize `seg` and parse it back
+static TCPSegment round_trip(const TCPSegment &seg) {
+    TCPSegment parsed;
+    test_should_be(parsed.parse(seg.serialize().concatenate()) == ParseResult::NoError, true);
+    return parsed;
+}
+
+//! A segment of `data` at absolute seqno `seqno` (with ISN 0)
+static TCPSegment data_segment(const uint64_t seqno, const string &data, const bool fin = false) {
+    TCPSegment seg;
+    seg.header().seqno = wrap(seqno, WrappingInt32{0});
+    seg.header().fin = fin;
+    seg.payload() = Buffer(string(data));
+    return seg;
+}
+
+//! The SACK blocks of `header`, as absolute seqnos (with ISN 0)
+static Ranges blocks(const TCPHeader &header) {
+    Ranges ret;
+    for (size_t i = 0; i < header.sack_count; i++) {
+        ret.emplace_back(unwrap(header.sack[i].left, WrappingInt32{0}, 0),
+                         unwrap(header.sack[i].right, WrappingInt32{0}, 0));
+    }
+    return ret;
+}
+
+//! Connect `client` to `server`; \returns the client's SYN and the server's SYN-ACK
+static pair<TCPSegment, TCPSegment> handshake(TCPConnection &client, TCPConnection &server) {
+    client.connect();
+    const TCPSegment syn = client.segments_out().front();
+    client.segments_out().pop();
+    server.segment_received(syn);
+    const TCPSegment syn_ack = server.segments_out().front();
+    server.segments_out().pop();
+    client.segment_received(syn_ack);
+    while (not client.segments_out().empty()) {
+        server.segment_received(client.segments_out().front());
+        client.segments_out().pop();
+    }
+    return {syn, syn_ack};
+}
+
+//! Transfer 1 MB over an 8 Mbit/s path with 40 ms of round trip that drops a share `loss` of the data segments
+static SimulatedTransfer transfer(const CongestionControl algorithm, const bool sack, const double loss) {
+    SimulatedTransfer sim{{}, 1000000, SimulatedLink{1000, 20000, 20, loss}, SimulatedLink{1000, 20000, 20}};
+    sim.config.congestion_control = algorithm;
+    sim.config.sack = sack;
+    sim.config.rt_timeout = 200;
+    sim.config.recv_capacity = 256000;
+    sim.config.send_capacity = 256000;
+    test_should_be(sim.run(120000), true);
+    return sim;
+}
+
+int main() {
+    try {
+        {
+            // the options survive serialization, and lengthen the header
+            TCPSegment syn;
+            syn.header().syn = true;
+            syn.header().sack_permitted = true;
+            test_should_be(syn.header().options_length(), 4ul);
+            syn.header().doff = (TCPHeader::LENGTH + syn.header().options_length()) / 4;
+            test_should_be(round_trip(syn).header().sack_permitted, true);
+            test_should_be(syn.serialize().size(), 24ul);
+
+            TCPSegment seg = data_segment(100, "payload");
+            seg.header().sack_count = TCPHeader::MAX_SACK_BLOCKS;
+            for (size_t i = 0; i < TCPHeader::MAX_SACK_BLOCKS; i++) {
+                seg.header().sack[i] = {WrappingInt32(1000 + 100 * i), WrappingInt32(1050 + 100 * i)};
+            }
+            test_should_be(seg.header().options_length(), 36ul);
+            seg.header().doff = (TCPHeader::LENGTH + seg.header().options_length()) / 4;
+            const TCPSegment parsed = round_trip(seg);
+            test_should_be(parsed.header() == seg.header(), true);
+            test_should_be(parsed.payload().copy() == "payload", true);
+
+            // options that don't fit in the header are an error
+            seg.header().doff = 5;
+            bool threw = false;
+            try {
+                seg.serialize();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+
+            // other options are skipped, and a malformed one ends the parsing of options
+            string header = TCPSegment().serialize().concatenate();
+            header += string{2, 4, 0x05, char(0xb4)};          // MSS
+            header += string{1, 3, 3, 7};                       // NOP, window scale
+            header += string{5, 10, 0, 0, 0, 10, 0, 0, 0, 20};  // SACK, one block
+            header += string{1, 1, 8, 0};                       // NOPs, then a zero-length option
+            header[12] = char(header.size() / 4 << 4);
+            TCPSegment options;
+            test_should_be(options.parse(string(header), 0, false) == ParseResult::NoError, true);
+            test_should_be(options.header().sack_permitted, false);
+            test_should_be((blocks(options.header()) == Ranges{{10, 20}}), true);
+        }
+
+        {
+            // the receiver reports what it holds beyond the ackno, the latest block first, merging neighbours
+            TCPReceiver receiver{4000};
+            TCPSegment syn;
+            syn.header().syn = true;
+            receiver.segment_received(syn);
+            TCPHeader header;
+            receiver.add_sack_blocks(header);
+            test_should_be(header.sack_count, uint8_t{0});
+
+            receiver.segment_received(data_segment(3, "cd"));
+            receiver.segment_received(data_segment(7, "gh"));
+            receiver.add_sack_blocks(header);
+            test_should_be((blocks(header) == Ranges{{7, 9}, {3, 5}}), true);
+
+            receiver.segment_received(data_segment(5, "ef"));
+            receiver.add_sack_blocks(header);
+            test_should_be((blocks(header) == Ranges{{3, 9}}), true);
+
+            // a block that ends the stream covers the FIN
+            receiver.segment_received(data_segment(9, "ij", true));
+            receiver.add_sack_blocks(header);
+            test_should_be((blocks(header) == Ranges{{3, 12}}), true);
+
+            receiver.segment_received(data_segment(1, "ab"));
+            receiver.add_sack_blocks(header);
+            test_should_be(header.sack_count, uint8_t{0});
+            test_should_be(receiver.ackno().value(), WrappingInt32{12});
+        }
+
+        for (const bool sack : {false, true}) {
+            // ten segments in flight; the second and the fifth are lost
+            TCPSender sender{64000, 1000, WrappingInt32{0}};
+            sent(sender);
+            ack(sender, 1);
+            sender.stream_in().write(string(10 * MSS, 'x'));
+            test_should_be(sent(sender).size(), 10ul);
+            const auto segment = [](const uint64_t i) { return 1 + i * MSS; };
+            ack(sender, segment(1));
+
+            // the receiver acknowledges the others as they arrive, and selectively if it can
+            const auto arrived = [&](const Ranges &sacked) {
+                ack(sender, segment(1), sack ? sacked : Ranges{});
+            };
+            arrived({{segment(2), segment(3)}});
+            arrived({{segment(2), segment(4)}});
+            test_should_be(sent(sender).empty(), true);
+            arrived({{segment(5), segment(6)}, {segment(2), segment(4)}});
+            test_should_be(sender.sacked_bytes(), sack ? 3 * MSS : 0);
+
+            // with SACK, the third duplicate retransmits both holes, and nothing the receiver holds;
+            // without it, only the first hole, and the second once the first is repaired, a round trip later
+            const auto retransmitted = sent(sender);
+            if (sack) {
+                test_should_be((retransmitted == vector<uint64_t>{segment(1), segment(4)}), true);
+            } else {
+                test_should_be((retransmitted == vector<uint64_t>{segment(1)}), true);
+            }
+            for (uint64_t i = 6; i < 10; i++) {
+                arrived({{segment(5), segment(i + 1)}, {segment(2), segment(4)}});
+            }
+            test_should_be(sent(sender).empty(), true);
+
+            ack(sender, segment(4), sack ? Ranges{{segment(5), segment(10)}}
+                                         : Ranges{});
+            test_should_be(sent(sender) == (sack ? vector<uint64_t>{} : vector<uint64_t>{segment(4)}), true);
+            ack(sender, segment(10));
+            test_should_be(sender.bytes_in_flight(), 0ul);
+            test_should_be(sender.sacked_bytes(), 0ul);
+            test_should_be(sender.fast_retransmissions(), uint64_t{1});
+        }
+
+        {
+            // SACK is used only if both ends offer it in their SYNs
+            TCPConfig with_sack, without_sack;
+            with_sack.sack = true;
+            {
+                TCPConnection client{with_sack}, server{without_sack};
+                const auto [syn, syn_ack] = handshake(client, server);
+                test_should_be(syn.header().sack_permitted, true);
+                test_should_be(syn.header().doff, uint8_t{6});
+                test_should_be(syn_ack.header().sack_permitted, false);
+
+                client.write(string(3 * MSS, 'x'));
+                server.segment_received(client.segments_out().back());
+                test_should_be(server.segments_out().back().header().sack_count, uint8_t{0});
+            }
+            {
+                TCPConnection client{with_sack}, server{with_sack};
+                const auto [syn, syn_ack] = handshake(client, server);
+                test_should_be(syn_ack.header().sack_permitted, true);
+
+                // the first of three segments is lost: the acknowledgment of the third SACKs it
+                client.write(string(3 * MSS, 'x'));
+                server.segment_received(client.segments_out().back());
+                const TCPHeader &header = server.segments_out().back().header();
+                const uint64_t isn = client.segments_out().front().header().seqno.raw_value() - 1;
+                test_should_be(header.sack_count, uint8_t{1});
+                test_should_be(header.sack[0].left, WrappingInt32(isn + 1 + 2 * MSS));
+                test_should_be(header.sack[0].right, WrappingInt32(isn + 1 + 3 * MSS));
+                test_should_be(header.doff, uint8_t{8});
+
+                // meanwhile, the server's data carries only the blocks that fit alongside the payload within
+                // the MTU: none beside a full-sized payload, and the one it holds beside half of one
+                server.write(string(MSS + MSS / 2, 'y'));
+                vector<uint8_t> sack_counts;
+                while (not server.segments_out().empty()) {
+                    const TCPSegment &seg = server.segments_out().front();
+                    if (seg.payload().size() > 0) {
+                        test_should_be(seg.serialize().size() <= TCPHeader::LENGTH + MSS, true);
+                        sack_counts.push_back(seg.header().sack_count);
+                    }
+                    server.segments_out().pop();
+                }
+                test_should_be((sack_counts == vector<uint8_t>{0, 1}), true);
+            }
+        }
+
+        {
+            // over a lossy path, SACK repairs several losses per round trip, instead of waiting out timeouts
+            for (const auto algorithm : {CongestionControl::None, CongestionControl::Cubic}) {
+                const auto plain = transfer(algorithm, false, 0.03);
+                const auto sack = transfer(algorithm, true, 0.03);
+                test_should_be(sack.elapsed < plain.elapsed, true);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
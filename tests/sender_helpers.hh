@@ -0,0 +1,41 @@
+#ifndef SPONGE_TESTS_SENDER_HELPERS_HH
+#define SPONGE_TESTS_SENDER_HELPERS_HH
+
+#include "tcp_header.hh"
+#include "tcp_sender.hh"
+#include "test_should_be.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//! Ranges of absolute seqnos, first and just past the last
+using Ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+//! Let the sender send what it can, and \returns the absolute seqnos (with ISN 0) of the segments it sent
+inline std::vector<uint64_t> sent(TCPSender &sender) {
+    sender.fill_window();
+    std::vector<uint64_t> seqnos;
+    while (not sender.segments_out().empty()) {
+        seqnos.push_back(unwrap(sender.segments_out().front().header().seqno, WrappingInt32{0}, 0));
+        sender.segments_out().pop();
+    }
+    return seqnos;
+}
+
+//! Acknowledge everything up to the absolute seqno `ackno` (with ISN 0), selectively acknowledging `sacked` too
+inline void ack(TCPSender &sender,
+                const uint64_t ackno,
+                const Ranges &sacked = {},
+                const uint16_t window_size = 60000,
+                const bool carries_data = false) {
+    TCPHeader header;
+    for (const auto &[left, right] : sacked) {
+        header.sack[header.sack_count++] = {wrap(left, WrappingInt32{0}), wrap(right, WrappingInt32{0})};
+    }
+    sender.sack_received(header);
+    test_should_be(sender.ack_received(wrap(ackno, WrappingInt32{0}), window_size, carries_data), true);
+}
+
+#endif  // SPONGE_TESTS_SENDER_HELPERS_HH
@@ -0,0 +1,131 @@
+#include "loopback_helpers.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+static constexpr uint64_t HANDSHAKE_DELAY_MS = 300;
+
+//! Receive the next segment sent to `peer`
+static TCPSegment receive(UDPSocket &peer) {
+    TCPSegment seg;
+    test_should_be(seg.parse(Buffer(peer.recv().payload), 0) == ParseResult::NoError, true);
+    return seg;
+}
+
+//! Connect `socket` to `peer`, which answers the SYN after `delay` ms; \returns the SYN
+static TCPSegment connect(TCPOverUDPSpongeSocket &socket,
+                          const TCPConfig &config,
+                          const FdAdapterConfig &adapter_config,
+                          UDPSocket &peer,
+                          const uint64_t delay) {
+    thread connecting([&] { socket.connect(config, adapter_config); });
+
+    const TCPSegment syn = receive(peer);
+    test_should_be(syn.header().syn, true);
+    this_thread::sleep_for(chrono::milliseconds(delay));
+
+    TCPSegment syn_ack;
+    syn_ack.header().syn = syn_ack.header().ack = true;
+    syn_ack.header().seqno = WrappingInt32{1000};
+    syn_ack.header().ackno = syn.header().seqno + 1;
+    syn_ack.header().win = 60000;
+    syn_ack.header().sport = syn.header().dport;
+    syn_ack.header().dport = syn.header().sport;
+    peer.sendto(adapter_config.source(), syn_ack.serialize());
+    connecting.join();
+    return syn;
+}
+
+int main() {
+    try {
+        {
+            // the peer (played by a bare UDP socket) answers the SYN after a delay: the socket must time the
+            // handshake from when the SYN left to when the SYN-ACK arrived, and set its timeout from that
+            UDPSocket peer = loopback_socket();
+            UDPSocket socket_udp = loopback_socket();
+            FdAdapterConfig adapter_config;
+            adapter_config.set_source(socket_udp.local_address());
+            adapter_config.set_destination(peer.local_address());
+            TCPOverUDPSpongeSocket socket{TCPOverUDPSocketAdapter(move(socket_udp))};
+
+            TCPConfig config;
+            config.adaptive_rto = RTOBounds{};
+            const TCPSegment syn = connect(socket, config, adapter_config, peer, HANDSHAKE_DELAY_MS);
+
+            // with SRTT = 300 and RTTVAR = 150, the first data segment is retransmitted after 900 ms;
+            // timing the handshake from the end of the wait would give 0 ms, and the 200 ms floor
+            socket.write("hello");
+            TCPSegment data = receive(peer);
+            while (data.payload().size() == 0) {
+                data = receive(peer);
+            }
+            const uint64_t sent = timestamp_ms();
+            TCPSegment retransmission = receive(peer);
+            while (retransmission.payload().size() == 0) {
+                retransmission = receive(peer);
+            }
+            test_should_be(retransmission.header().seqno, data.header().seqno);
+            test_should_be(timestamp_ms() - sent >= 3 * HANDSHAKE_DELAY_MS - 100, true);
+
+            TCPSegment rst;
+            rst.header().rst = true;
+            rst.header().seqno = WrappingInt32{1001};
+            rst.header().sport = syn.header().dport;
+            rst.header().dport = syn.header().sport;
+            peer.sendto(adapter_config.source(), rst.serialize());
+        }
+
+        {
+            // destroying a socket whose connection is still open wakes its idle TCP thread, rather than
+            // waiting for the thread's next timer
+            UDPSocket peer = loopback_socket();
+            UDPSocket socket_udp = loopback_socket();
+            FdAdapterConfig adapter_config;
+            adapter_config.set_source(socket_udp.local_address());
+            adapter_config.set_destination(peer.local_address());
+            auto socket = make_unique<TCPOverUDPSpongeSocket>(TCPOverUDPSocketAdapter(move(socket_udp)));
+            connect(*socket, {}, adapter_config, peer, 0);
+
+            this_thread::sleep_for(chrono::milliseconds(50));
+            const uint64_t start = timestamp_ms();
+            socket.reset();
+            test_should_be(timestamp_ms() - start < 500, true);
+        }
+
+        {
+            // a socket whose outbound stream keeps chunks (and has no free space to read into) sends what is written
+            UDPSocket peer = loopback_socket();
+            UDPSocket socket_udp = loopback_socket();
+            FdAdapterConfig adapter_config;
+            adapter_config.set_source(socket_udp.local_address());
+            adapter_config.set_destination(peer.local_address());
+            TCPOverUDPSpongeSocket socket{TCPOverUDPSocketAdapter(move(socket_udp))};
+
+            TCPConfig config;
+            config.send_storage = ByteStream::Storage::Chunked;
+            connect(socket, config, adapter_config, peer, 0);
+
+            socket.write("hello");
+            TCPSegment data = receive(peer);
+            while (data.payload().size() == 0) {
+                data = receive(peer);
+            }
+            test_should_be(data.payload().copy() == "hello", true);
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "echo_server.hh"
+#include "loopback_helpers.hh"
+#include "tcp_engine.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t CLIENTS = 16;
+static constexpr size_t REQUEST_SIZE = 100000;
+static constexpr uint64_t TIME_LIMIT_MS = 10000;
+
+int main() {
+    try {
+        TCPConfig config;
+        config.rt_timeout = 10;
+
+        // one server engine echoes what each of several clients sends
+        auto [server_adapter, server_port] = loopback_adapter();
+        TCPOverUDPEngine server{move(server_adapter)};
+        server.listen(config, server_port);
+
+        vector<unique_ptr<TCPOverUDPEngine>> clients;
+        vector<TCPOverUDPEngine::Stream> client_streams;
+        vector<string> requests, responses(CLIENTS);
+        for (size_t i = 0; i < CLIENTS; i++) {
+            auto [adapter, port] = loopback_adapter();
+            clients.push_back(make_unique<TCPOverUDPEngine>(move(adapter)));
+            const TCPFlow flow{0, Address("127.0.0.1").ipv4_numeric(), port, server_port};
+            client_streams.push_back(clients.back()->connect(config, flow));
+
+            string request(REQUEST_SIZE, 0);
+            for (auto &ch : request) {
+                ch = 'a' + i;
+            }
+            requests.push_back(move(request));
+        }
+        vector<size_t> request_offsets(CLIENTS);
+
+        EchoServer echo;
+
+        const uint64_t start = timestamp_ms();
+        auto step = [&] {
+            if (timestamp_ms() - start > TIME_LIMIT_MS) {
+                throw runtime_error("connections did not finish in time");
+            }
+
+            for (size_t i = 0; i < CLIENTS; i++) {
+                auto &stream = client_streams[i];
+                if (stream.valid()) {
+                    if (request_offsets[i] < REQUEST_SIZE) {
+                        request_offsets[i] += stream.write(requests[i].substr(request_offsets[i]));
+                        if (request_offsets[i] == REQUEST_SIZE) {
+                            stream.end_input_stream();
+                        }
+                    }
+                    responses[i] += stream.read(stream.inbound_stream().buffer_size());
+                }
+                clients[i]->wait_next_event(0);
+            }
+
+            echo.accept_from(server);
+            echo.service();
+            server.wait_next_event(0);
+        };
+
+        while (not all_closed(clients) or server.connection_count()) {
+            step();
+        }
+
+        test_should_be(echo.accepted(), CLIENTS);
+        for (size_t i = 0; i < CLIENTS; i++) {
+            test_should_be(responses[i] == requests[i], true);
+            test_should_be(client_streams[i].valid(), false);
+            test_should_be(client_streams[i].active(), false);
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -60,8 +60,8 @@ string TestFD::TestRFD::read() {
 void TestFdAdapter::config_segment(TCPSegment &seg) {
     const auto &cfg = config();
     auto &tcp_hdr = seg.header();
-    tcp_hdr.sport = cfg.source.port();
-    tcp_hdr.dport = cfg.destination.port();
+    tcp_hdr.sport = cfg.source().port();
+    tcp_hdr.dport = cfg.destination().port();
 }
 
 //! \param[in] seg is the TCPSegment to write
@@ -0,0 +1,145 @@
+#include "echo_server.hh"
+#include "loopback_helpers.hh"
+#include "tcp_engine.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t CLIENTS = 12;
+static constexpr size_t REQUEST_SIZE = 10000;
+static constexpr uint64_t TIME_LIMIT_MS = 10000;
+
+//! \returns the request sent by client `i`
+static string request_for(const size_t i) { return string(REQUEST_SIZE, static_cast<char>('a' + i)); }
+
+//! Echo the requests of CLIENTS engines, all connecting at once, through a server engine with a small backlog
+static TCPOverUDPEngine::ListenerStats echo_through_backlog(const size_t backlog, const bool syn_cookies) {
+    TCPConfig config;
+    config.rt_timeout = 10;
+
+    auto [server_adapter, server_port] = loopback_adapter();
+    TCPOverUDPEngine server{move(server_adapter)};
+    server.listen(config, server_port, backlog, syn_cookies);
+
+    vector<unique_ptr<TCPOverUDPEngine>> clients;
+    vector<TCPOverUDPEngine::Stream> client_streams;
+    vector<string> responses(CLIENTS);
+    for (size_t i = 0; i < CLIENTS; i++) {
+        auto [adapter, port] = loopback_adapter();
+        clients.push_back(make_unique<TCPOverUDPEngine>(move(adapter)));
+        const TCPFlow flow{0, Address("127.0.0.1").ipv4_numeric(), port, server_port};
+        client_streams.push_back(clients.back()->connect(config, flow));
+        test_should_be(client_streams.back().write(request_for(i)), REQUEST_SIZE);
+        client_streams.back().end_input_stream();
+    }
+
+    // let every SYN reach the server before it runs, so that they overflow the SYN queue together
+    for (auto &client : clients) {
+        client->wait_next_event(0);
+    }
+
+    EchoServer echo;
+
+    const uint64_t start = timestamp_ms();
+    while (not all_closed(clients) or server.connection_count()) {
+        if (timestamp_ms() - start > TIME_LIMIT_MS) {
+            throw runtime_error("connections did not finish in time");
+        }
+
+        server.wait_next_event(0);
+        echo.accept_from(server);
+        echo.service();
+
+        for (size_t i = 0; i < CLIENTS; i++) {
+            auto &stream = client_streams[i];
+            if (stream.valid()) {
+                responses[i] += stream.read(stream.inbound_stream().buffer_size());
+            }
+            clients[i]->wait_next_event(0);
+        }
+    }
+
+    test_should_be(echo.accepted(), CLIENTS);
+    test_should_be(server.accept_queue_size(), 0ul);
+    for (size_t i = 0; i < CLIENTS; i++) {
+        test_should_be(responses[i] == request_for(i), true);
+    }
+
+    return server.listener_stats();
+}
+
+//! Echo the requests of CLIENTS TCPSpongeSockets through one TCPSpongeListener
+static void echo_through_listener() {
+    TCPConfig config;
+    config.rt_timeout = 10;
+
+    auto [server_adapter, server_port] = loopback_adapter();
+    TCPOverUDPSpongeListener listener{move(server_adapter)};
+    FdAdapterConfig server_config;
+    server_config.set_source(Address("127.0.0.1", server_port));
+    listener.listen(config, server_config);
+
+    // connect every client and send its request before the owner accepts any connection
+    vector<unique_ptr<TCPOverUDPSpongeSocket>> clients;
+    for (size_t i = 0; i < CLIENTS; i++) {
+        auto [adapter, port] = loopback_adapter();
+        clients.push_back(make_unique<TCPOverUDPSpongeSocket>(move(adapter)));
+        FdAdapterConfig client_config;
+        client_config.set_source(Address("127.0.0.1", port));
+        client_config.set_destination(Address("127.0.0.1", server_port));
+        clients.back()->connect(config, client_config);
+        clients.back()->write(request_for(i));
+        clients.back()->shutdown(SHUT_WR);
+    }
+
+    for (size_t i = 0; i < CLIENTS; i++) {
+        LocalStreamSocket connection = listener.accept();
+        string request;
+        while (not connection.eof()) {
+            request += connection.read();
+        }
+        test_should_be(request.size(), REQUEST_SIZE);
+        connection.write(request);
+    }
+
+    for (size_t i = 0; i < CLIENTS; i++) {
+        string response;
+        while (not clients[i]->eof()) {
+            response += clients[i]->read();
+        }
+        test_should_be(response == request_for(i), true);
+        clients[i]->wait_until_closed();
+    }
+}
+
+int main() {
+    try {
+        // a SYN queue of one: the SYNs that overflow it are answered with cookies
+        const auto with_cookies = echo_through_backlog(1, true);
+        test_should_be(with_cookies.cookies_sent > 0, true);
+        test_should_be(with_cookies.cookies_accepted > 0, true);
+
+        // without cookies, the SYNs that overflow are dropped, and the clients get in by retransmitting
+        // (with a queue large enough that none of them runs out of retransmissions)
+        const auto without_cookies = echo_through_backlog(4, false);
+        test_should_be(without_cookies.syns_dropped > 0, true);
+        test_should_be(without_cookies.cookies_sent, 0ul);
+
+        echo_through_listener();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#include "echo_server.hh"
+#include "loopback_helpers.hh"
+#include "tcp_sharded_engine.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t SHARDS = 4;
+static constexpr size_t CLIENTS = 16;
+static constexpr size_t REQUEST_SIZE = 50000;
+static constexpr uint64_t TIME_LIMIT_MS = 10000;
+
+//! Joins a thread however the scope that started it exits, first setting `abort` unless it was joined already
+class JoinGuard {
+    thread &_thread;
+    atomic<bool> &_abort;
+
+  public:
+    JoinGuard(thread &thread_, atomic<bool> &abort) : _thread(thread_), _abort(abort) {}
+    JoinGuard(const JoinGuard &) = delete;
+    JoinGuard &operator=(const JoinGuard &) = delete;
+    ~JoinGuard() {
+        if (_thread.joinable()) {
+            _abort = true;
+            _thread.join();
+        }
+    }
+};
+
+int main() {
+    try {
+        TCPConfig config;
+        config.rt_timeout = 10;
+
+        // every shard has its own UDP socket on the same port
+        uint16_t server_port = 0;
+        TCPOverUDPShardedEngine server{SHARDS, [&](const size_t) {
+                                           UDPSocket sock;
+                                           sock.set_reuseport();
+                                           sock.bind(Address("127.0.0.1", server_port));
+                                           server_port = sock.local_address().port();
+                                           return TCPOverUDPSocketAdapter(move(sock));
+                                       }};
+        server.listen(config, server_port);
+
+        // each shard echoes its connections, and checks that they are its own; `aborted` stops the shards
+        // at once, without waiting for connections whose clients are no longer serviced
+        atomic<bool> clients_done{false}, aborted{false};
+        atomic<size_t> accepted{0}, misplaced{0};
+        thread server_thread([&] {
+            server.run([&](const size_t shard, TCPOverUDPEngine &engine) {
+                EchoServer echo;
+                while (not aborted and (not clients_done or engine.connection_count())) {
+                    engine.wait_next_event(5);
+                    for (const auto &stream : echo.accept_from(engine)) {
+                        accepted++;
+                        if (server.shard_of(stream.flow()) != shard) {
+                            misplaced++;
+                        }
+                    }
+                    echo.service();
+                }
+            });
+        });
+        const JoinGuard server_thread_guard{server_thread, aborted};
+
+        vector<unique_ptr<TCPOverUDPEngine>> clients;
+        vector<TCPOverUDPEngine::Stream> streams;
+        vector<string> requests, responses(CLIENTS);
+        vector<size_t> offsets(CLIENTS);
+        for (size_t i = 0; i < CLIENTS; i++) {
+            auto [adapter, port] = loopback_adapter();
+            clients.push_back(make_unique<TCPOverUDPEngine>(move(adapter)));
+            const TCPFlow flow{0, Address("127.0.0.1").ipv4_numeric(), port, server_port};
+            streams.push_back(clients.back()->connect(config, flow));
+            requests.emplace_back(REQUEST_SIZE, static_cast<char>('a' + i));
+        }
+
+        const uint64_t start = timestamp_ms();
+        while (not all_closed(clients)) {
+            if (timestamp_ms() - start > TIME_LIMIT_MS) {
+                throw runtime_error("connections did not finish in time");
+            }
+            for (size_t i = 0; i < CLIENTS; i++) {
+                auto &stream = streams[i];
+                if (stream.valid()) {
+                    if (offsets[i] < REQUEST_SIZE) {
+                        offsets[i] += stream.write(requests[i].substr(offsets[i]));
+                        if (offsets[i] == REQUEST_SIZE) {
+                            stream.end_input_stream();
+                        }
+                    }
+                    responses[i] += stream.read(stream.inbound_stream().buffer_size());
+                }
+                clients[i]->wait_next_event(0);
+            }
+            this_thread::yield();
+        }
+        clients_done = true;
+        server_thread.join();
+
+        for (size_t i = 0; i < CLIENTS; i++) {
+            test_should_be(responses[i] == requests[i], true);
+        }
+        test_should_be(accepted.load(), CLIENTS);
+        test_should_be(misplaced.load(), 0ul);
+
+        // the kernel spreads the flows by its own hash, so some had to be steered to their shard
+        test_should_be(server.segments_steered() > 0, true);
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
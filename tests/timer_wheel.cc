@@ -0,0 +1,117 @@
+#include "test_should_be.hh"
+#include "timer_wheel.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+int main() {
+    try {
+        {
+            // timers fire in deadline order, only once the wheel reaches them
+            TimerWheel wheel{1000};
+            vector<int> fired;
+            wheel.schedule(1005, [&] { fired.push_back(5); });
+            wheel.schedule(1001, [&] { fired.push_back(1); });
+            wheel.schedule(1300, [&] { fired.push_back(300); });  // needs to cascade
+            const auto canceled = wheel.schedule(1002, [&] { fired.push_back(2); });
+            wheel.cancel(canceled);
+            wheel.cancel(canceled);
+            test_should_be(wheel.size(), size_t(3));
+            test_should_be(wheel.next_deadline().value(), uint64_t(1001));
+
+            test_should_be(wheel.advance(1000), size_t(0));
+            test_should_be(wheel.advance(1004), size_t(1));
+            test_should_be(wheel.advance(1299), size_t(1));
+            test_should_be(fired == vector<int>({1, 5}), true);
+            test_should_be(wheel.next_deadline().value(), uint64_t(1300));
+            test_should_be(wheel.advance(5000), size_t(1));
+            test_should_be(fired == vector<int>({1, 5, 300}), true);
+            test_should_be(wheel.empty(), true);
+            test_should_be(wheel.next_deadline().has_value(), false);
+            test_should_be(wheel.now(), uint64_t(5000));
+        }
+
+        {
+            // a past deadline fires on the next advance, and callbacks can schedule and cancel
+            TimerWheel wheel{0};
+            vector<int> fired;
+            TimerWheel::IdT victim = 0;
+            wheel.schedule(10, [&] {
+                fired.push_back(10);
+                wheel.cancel(victim);
+                wheel.schedule(5, [&] { fired.push_back(5); });
+                wheel.schedule(20, [&] { fired.push_back(20); });
+            });
+            victim = wheel.schedule(15, [&] { fired.push_back(15); });
+            test_should_be(wheel.advance(100), size_t(3));
+            test_should_be(fired == vector<int>({10, 5, 20}), true);
+        }
+
+        {
+            // deadlines beyond the last level wait in the overflow list
+            const uint64_t far = uint64_t{1} << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS + 3);
+            TimerWheel wheel{7};
+            bool fired = false;
+            wheel.schedule(far, [&] { fired = true; });
+            test_should_be(wheel.advance(far - 1), size_t(0));
+            test_should_be(fired, false);
+            test_should_be(wheel.advance(far), size_t(1));
+            test_should_be(fired, true);
+        }
+
+        {
+            // many timers at random deadlines fire exactly when a sorted reference says they should
+            mt19937 rng{42};
+            TimerWheel wheel{12345};
+            multimap<uint64_t, TimerWheel::IdT> expected;
+            vector<pair<uint64_t, TimerWheel::IdT>> fired;
+            uint64_t now = 12345;
+            for (unsigned int round = 0; round < 2000; round++) {
+                for (unsigned int i = 0; i < 5; i++) {
+                    const uint64_t deadline = now + (rng() % 2 ? rng() % 100 : rng() % 1000000);
+                    const auto id = wheel.schedule(deadline, [&fired, &wheel, deadline] {
+                        fired.emplace_back(deadline, wheel.now());
+                    });
+                    expected.emplace(deadline, id);
+                }
+                if (rng() % 4 == 0 and not expected.empty()) {
+                    auto victim = expected.begin();
+                    advance(victim, rng() % expected.size());
+                    wheel.cancel(victim->second);
+                    expected.erase(victim);
+                }
+
+                now += rng() % 500;
+                fired.clear();
+                const size_t count = wheel.advance(now);
+                size_t due = 0;
+                while (not expected.empty() and expected.begin()->first <= now) {
+                    expected.erase(expected.begin());
+                    due++;
+                }
+                test_should_be(count, due);
+                test_should_be(fired.size(), due);
+                uint64_t last = 0;
+                for (const auto &[deadline, fired_at] : fired) {
+                    test_should_be(fired_at, deadline);
+                    test_should_be(deadline >= last, true);
+                    last = deadline;
+                }
+                test_should_be(wheel.size(), expected.size());
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include "test_should_be.hh"
+#include "toeplitz_hash.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! One example from the Microsoft RSS specification's "Verifying the RSS Hash Calculation"
+struct Example {
+    string source, destination;
+    uint16_t source_port, destination_port;
+    uint32_t ipv4_hash, tcp_hash;
+};
+
+//! \returns the bytes of `address` in network order
+static string address_bytes(const string &address) {
+    string ret;
+    size_t start = 0;
+    for (size_t i = 0; i < 4; i++) {
+        const size_t end = address.find('.', start);
+        ret.push_back(static_cast<char>(stoul(address.substr(start, end - start))));
+        start = end + 1;
+    }
+    return ret;
+}
+
+//! \returns the bytes of `port` in network order
+static string port_bytes(const uint16_t port) { return {static_cast<char>(port >> 8), static_cast<char>(port)}; }
+
+int main() {
+    try {
+        const vector<Example> examples = {
+            {"66.9.149.187", "161.142.100.80", 2794, 1766, 0x323e8fc2, 0x51ccc178},
+            {"199.92.111.2", "65.69.140.83", 14230, 4739, 0xd718262a, 0xc626b0ea},
+            {"24.19.198.95", "12.22.207.184", 12898, 38024, 0xd2d0a5de, 0x5c2b394a},
+            {"38.27.205.30", "209.142.163.6", 48228, 2217, 0x82989176, 0xafc7327f},
+            {"153.39.163.191", "202.188.127.2", 44251, 1303, 0x5d1809c5, 0x10e828a2},
+        };
+
+        const ToeplitzHash ipv4_hash(8);
+        const ToeplitzHash tcp_hash(12);
+        test_should_be(tcp_hash.input_size(), 12ul);
+        for (const auto &ex : examples) {
+            const string addresses = address_bytes(ex.source) + address_bytes(ex.destination);
+            test_should_be(ipv4_hash(addresses), ex.ipv4_hash);
+            test_should_be(tcp_hash(addresses + port_bytes(ex.source_port) + port_bytes(ex.destination_port)),
+                           ex.tcp_hash);
+        }
+
+        // a different key gives a different hash
+        ToeplitzHash::KeyT key = ToeplitzHash::DEFAULT_KEY;
+        key[0] ^= 1;
+        const string input = address_bytes("1.2.3.4") + address_bytes("5.6.7.8") + port_bytes(1) + port_bytes(2);
+        test_should_be(ToeplitzHash(12, key)(input) != tcp_hash(input), true);
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include "fd_adapter.hh"
+#include "loopback_helpers.hh"
+#include "socket.hh"
+#include "test_should_be.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main() {
+    try {
+        {
+            // one sendto_batch() call sends every datagram, and one recv_batch() call receives them
+            UDPSocket sender = loopback_socket(), receiver = loopback_socket();
+            vector<UDPSocket::outgoing_datagram> datagrams;
+            for (size_t i = 0; i < 10; i++) {
+                BufferList payload{string(i + 1, 'a' + i)};
+                payload.append(BufferList{string("!")});
+                datagrams.push_back({receiver.local_address(), payload});
+            }
+            datagrams.push_back({receiver.local_address(), BufferList{string(100, 'z')}});
+            test_should_be(sender.sendto_batch(datagrams.data(), datagrams.size()), datagrams.size());
+
+            vector<string> storage(datagrams.size() + 5, string(16, 0));
+            vector<UDPSocket::batch_slot> slots(storage.size());
+            for (size_t i = 0; i < slots.size(); i++) {
+                slots[i].buffer = storage[i].data();
+                slots[i].capacity = storage[i].size();
+            }
+            test_should_be(receiver.recv_batch(slots.data(), slots.size()), datagrams.size());
+            for (size_t i = 0; i < 10; i++) {
+                test_should_be(slots[i].length, i + 2);
+                test_should_be(storage[i].substr(0, i + 2) == string(i + 1, 'a' + i) + "!", true);
+                const Address source{slots[i].source_address, slots[i].source_address_len};
+                test_should_be(source == sender.local_address(), true);
+            }
+
+            // a datagram longer than its slot is truncated, and its full length is reported
+            test_should_be(slots[10].length, 100ul);
+            test_should_be(storage[10] == string(16, 'z'), true);
+        }
+
+        {
+            // the adapter queues written segments until flush(), and hands out a batch one segment at a time
+            UDPSocket sender_socket = loopback_socket(), receiver_socket = loopback_socket();
+            const Address receiver_address = receiver_socket.local_address();
+            const Address sender_address = sender_socket.local_address();
+            TCPOverUDPSocketAdapter sender{move(sender_socket)}, receiver{move(receiver_socket)};
+            static_cast<UDPSocket &>(receiver).set_blocking(false);
+
+            const TCPFlow flow{0, receiver_address.ipv4_numeric(), 1234, receiver_address.port()};
+            for (size_t i = 0; i < 5; i++) {
+                TCPSegment seg;
+                seg.header().seqno = WrappingInt32(i);
+                seg.payload() = Buffer(string(100, 'a' + i));
+                sender.write(seg, flow);
+            }
+
+            // nothing is sent before the flush
+            UDPSocket::batch_slot probe;
+            string probe_storage(16, 0);
+            probe.buffer = probe_storage.data();
+            probe.capacity = probe_storage.size();
+            test_should_be(static_cast<UDPSocket &>(receiver).recv_batch(&probe, 1), 0ul);
+
+            // and the adapter reads nothing, over and over, without running past its batch
+            for (size_t i = 0; i < 2 * TCPOverUDPSocketAdapter::BATCH_SIZE; i++) {
+                TCPFlow received_flow;
+                test_should_be(receiver.read(received_flow).has_value(), false);
+                test_should_be(receiver.pending_reads(), 0ul);
+            }
+
+            sender.flush();
+            for (size_t i = 0; i < 5; i++) {
+                TCPFlow received_flow;
+                const auto seg = receiver.read(received_flow);
+                test_should_be(seg.has_value(), true);
+                test_should_be(receiver.pending_reads(), 4 - i);
+                test_should_be(seg->header().seqno.raw_value(), uint32_t(i));
+                test_should_be(seg->payload().copy() == string(100, 'a' + i), true);
+                test_should_be(received_flow.remote_address, sender_address.ipv4_numeric());
+                test_should_be(received_flow.remote_port, sender_address.port());
+                test_should_be(received_flow.local_port, receiver_address.port());
+            }
+        }
+
+        {
+            // with GSO, the kernel cuts one payload into datagrams of the segment size
+            UDPSocket sender = loopback_socket(), receiver = loopback_socket();
+            bool gso = true;
+            try {
+                sender.set_gso_size(0);
+            } catch (const unix_error &) {
+                gso = false;
+            }
+            if (gso) {
+                UDPSocket::outgoing_datagram datagram{receiver.local_address(), BufferList{string(250, 'g')}, 100};
+                test_should_be(sender.sendto_batch(&datagram, 1), 1ul);
+
+                vector<string> storage(4, string(256, 0));
+                vector<UDPSocket::batch_slot> slots(storage.size());
+                for (size_t i = 0; i < slots.size(); i++) {
+                    slots[i].buffer = storage[i].data();
+                    slots[i].capacity = storage[i].size();
+                }
+                test_should_be(receiver.recv_batch(slots.data(), slots.size()), 3ul);
+                test_should_be(slots[0].length, 100ul);
+                test_should_be(slots[1].length, 100ul);
+                test_should_be(slots[2].length, 50ul);
+                test_should_be(slots[2].segment_size, 0ul);
+            }
+        }
+
+        for (const bool offload : {false, true}) {
+            // whether or not the kernel coalesces them, read() returns each segment that write() sent
+            UDPSocket sender_socket = loopback_socket(), receiver_socket = loopback_socket();
+            const Address receiver_address = receiver_socket.local_address();
+            TCPOverUDPSocketAdapter sender{move(sender_socket), offload}, receiver{move(receiver_socket), offload};
+            static_cast<UDPSocket &>(receiver).set_blocking(false);
+
+            const TCPFlow flow{0, receiver_address.ipv4_numeric(), 1234, receiver_address.port()};
+            const size_t count = 40;
+            for (size_t i = 0; i < count; i++) {
+                TCPSegment seg;
+                seg.header().seqno = WrappingInt32(i);
+                seg.payload() = Buffer(string(i + 1 < count ? 1000 : 10, 'a' + i % 26));
+                sender.write(seg, flow);
+            }
+            sender.flush();
+
+            for (size_t i = 0; i < count; i++) {
+                TCPFlow received_flow;
+                const auto seg = receiver.read(received_flow);
+                test_should_be(seg.has_value(), true);
+                test_should_be(seg->header().seqno.raw_value(), uint32_t(i));
+                test_should_be(seg->payload().copy() == string(i + 1 < count ? 1000 : 10, 'a' + i % 26), true);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}